@@ -4,4 +4,7 @@ call vcvars.bat
 set LIBRARIES=glfw3.lib opengl32.lib user32.lib gdi32.lib shell32.lib
 pushd .\build
 cl /MT /Zi /Od /EHsc -nologo ../code/main.cpp ../Include/glad/glad.c /I ..\Include /link /ENTRY:wmainCRTStartup /SUBSYSTEM:CONSOLE /LIBPATH:..\Libraries\ %LIBRARIES%
+cl /MT /O2 /EHsc -nologo ../code/bench.cpp ../Include/glad/glad.c /I ..\Include /link /SUBSYSTEM:CONSOLE
+cl /MT /O2 /EHsc -nologo ../code/thread_test.cpp ../Include/glad/glad.c /I ..\Include /link /SUBSYSTEM:CONSOLE
+cl /MT /O2 /EHsc -nologo ../code/epa_test.cpp ../Include/glad/glad.c /I ..\Include /link /SUBSYSTEM:CONSOLE
 popd
@@ -0,0 +1,73 @@
+#ifndef AABB_H_
+#define AABB_H_
+
+#include <float.h>
+#include <glm/glm.hpp>
+
+#include "shape.h"
+#include "gjk.h"
+
+// World space axis aligned box, what the broadphases sort and bin bodies by
+struct Aabb {
+  glm::vec3 min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+  Aabb() {}
+  Aabb(glm::vec3 boxMin, glm::vec3 boxMax) : min(boxMin), max(boxMax) {}
+
+  // touching boxes count as overlapping
+  bool overlaps(const Aabb &other) const {
+    return min.x <= other.max.x && other.min.x <= max.x
+        && min.y <= other.max.y && other.min.y <= max.y
+        && min.z <= other.max.z && other.min.z <= max.z;
+  }
+
+  bool contains(const Aabb &other) const {
+    return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+        && other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+  }
+
+  glm::vec3 centre() const {
+    return (min + max) * 0.5f;
+  }
+
+  float surface_area() const {
+    glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+};
+
+Aabb aabbUnion(const Aabb &a, const Aabb &b) {
+  return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+// Slab test, entry gets how far along the ray it enters the box (0 when it
+// starts inside). inverseDirection is 1 / direction per component, a zero
+// component's infinity works out.
+bool rayAabb(const Aabb &box, glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance, float *entry) {
+  float entryDistance = 0.0f;
+  float exitDistance = maxDistance;
+  for (int axis = 0; axis < 3; axis++) {
+    float t1 = (box.min[axis] - origin[axis]) * inverseDirection[axis];
+    float t2 = (box.max[axis] - origin[axis]) * inverseDirection[axis];
+    entryDistance = glm::max(entryDistance, glm::min(t1, t2));
+    exitDistance = glm::min(exitDistance, glm::max(t1, t2));
+  }
+  *entry = entryDistance;
+  return entryDistance <= exitDistance;
+}
+
+// Tight world box from the shape's support points along the 6 axis
+// directions, so it follows the shape's transform and margin like GJK does
+Aabb shapeAabb(const Shape &shape) {
+  Aabb box;
+  for (int axis = 0; axis < 3; axis++) {
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, 0.0f);
+    direction[axis] = 1.0f;
+    box.max[axis] = support(shape, direction)[axis];
+    box.min[axis] = support(shape, -direction)[axis];
+  }
+  return box;
+}
+
+#endif
@@ -0,0 +1,2197 @@
+// Headless benchmarks for the collision code. No window or GL context is
+// created, shapes only touch GL once they are drawn.
+//
+// Run every benchmark with `.\build\bench`, or a single one with
+// `.\build\bench <name>`.
+#include <glad/glad.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <string.h>
+#include <new>
+#include <memory>
+#include <algorithm>
+#include <stdlib.h>
+#include <float.h>
+#include <thread>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtx/string_cast.hpp>
+
+#include "cube.h"
+#include "tetrahedron.h"
+#include "sphere.h"
+#include "capsule.h"
+#include "cylinder.h"
+#include "cone.h"
+#include "box.h"
+#include "gjk.h"
+#include "epa.h"
+#include "pair_cache.h"
+#include "gjk_batch.h"
+#include "narrowphase.h"
+#include "manifold_cache.h"
+#include "sweep_and_prune.h"
+#include "dynamic_tree.h"
+#include "broadphases.h"
+#include "world.h"
+
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+struct BenchTimer {
+  chrono::high_resolution_clock::time_point start;
+
+  BenchTimer() : start(chrono::high_resolution_clock::now()) {}
+
+  double seconds() {
+    chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+    return elapsed.count();
+  }
+};
+
+// Every heap allocation the program makes goes through here
+long long benchAllocations = 0;
+
+void *operator new(size_t size) {
+  benchAllocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+// Keeps the optimizer from throwing away results we never look at
+volatile int benchSink;
+
+// Wraps a shape and counts every time it gets copied
+template <typename T>
+struct Counted : T {
+  static long long copies;
+
+  Counted(glm::vec3 pos) : T(pos) {}
+  Counted(const Counted &other) : T(other) {
+    copies++;
+  }
+};
+template <typename T> long long Counted<T>::copies = 0;
+
+// Uniformly spread, deterministic directions
+vector<glm::vec3> randomDirections(int count) {
+  vector<glm::vec3> directions;
+  srand(1234);
+  while ((int)directions.size() < count) {
+    glm::vec3 d = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 2.0f - 1.0f;
+    float length = glm::length(d);
+    if (length > 0.01f && length <= 1.0f) {
+      directions.push_back(d / length);
+    }
+  }
+  return directions;
+}
+
+// Triangle soup of a UV sphere, stands in for imported rocks/debris hulls.
+// Has (rings - 1) * segments + 2 unique vertices.
+vector<glm::vec3> sphereSoup(int rings, int segments, float radius) {
+  vector<glm::vec3> points;
+  for (int r = 0; r <= rings; r++) {
+    float theta = glm::pi<float>() * r / rings;
+    for (int s = 0; s < segments; s++) {
+      float phi = 2.0f * glm::pi<float>() * s / segments;
+      points.push_back(radius * glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+    }
+  }
+
+  vector<glm::vec3> soup;
+  for (int r = 0; r < rings; r++) {
+    for (int s = 0; s < segments; s++) {
+      glm::vec3 a = points[r * segments + s];
+      glm::vec3 b = points[r * segments + (s + 1) % segments];
+      glm::vec3 c = points[(r + 1) * segments + s];
+      glm::vec3 d = points[(r + 1) * segments + (s + 1) % segments];
+      if (r != 0) {
+        soup.push_back(a); soup.push_back(b); soup.push_back(c);
+      }
+      if (r != rings - 1) {
+        soup.push_back(b); soup.push_back(d); soup.push_back(c);
+      }
+    }
+  }
+  return soup;
+}
+
+// Tetrahedron/cube pairs scattered around each other, every frame the
+// tetrahedrons drift a little, like bodies moving a few millimetres a step
+struct StressScene {
+  vector<Tetrahedron> tetrahedrons;
+  vector<Cube> cubes;
+  vector<glm::vec3> velocities;
+
+  StressScene(int pairs) {
+    srand(42);
+    for (int i = 0; i < pairs; i++) {
+      glm::vec3 base = glm::vec3((float)(i % 100) * 4.0f, (float)(i / 100) * 4.0f, 0.0f);
+      glm::vec3 offset = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 2.4f - 1.2f;
+      tetrahedrons.push_back(Tetrahedron(base + offset));
+      tetrahedrons.back().update_orientation(glm::angleAxis((float)rand() / RAND_MAX * 6.28f,
+        glm::normalize(glm::vec3(rand(), rand(), rand()) + 1.0f)));
+      cubes.push_back(Cube(base));
+      velocities.push_back((glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX - 0.5f) * 0.01f);
+    }
+  }
+
+  void step() {
+    for (size_t i = 0; i < tetrahedrons.size(); i++) {
+      glm::vec3 offset = tetrahedrons[i].transform.position - cubes[i].transform.position;
+      // bounce back once they wander too far from their cube
+      for (int axis = 0; axis < 3; axis++) {
+        if (fabsf(offset[axis]) > 1.2f && offset[axis] * velocities[i][axis] > 0.0f) {
+          velocities[i][axis] = -velocities[i][axis];
+        }
+      }
+      tetrahedrons[i].update_pos(velocities[i]);
+    }
+  }
+};
+
+// Moves the tetrahedron back and forth through the cube so roughly half of the
+// queries hit
+glm::vec3 sweepStep(int i) {
+  return glm::vec3(((i / 400) % 2 == 0) ? 0.01f : -0.01f, 0.0f, 0.0f);
+}
+
+// ---------------------------------------------------------------------------
+// By-value GJK with a vector simplex, the way main.cpp used to call it.
+// Templated on the shape types so the Counted copies are not sliced away
+// before they can be counted, instantiating it with references gives the
+// vector simplex without the copies.
+// ---------------------------------------------------------------------------
+
+namespace by_value {
+
+enum EvolutionStage {
+  NO_INTERSECTION,
+  FOUND_INTERSECTION,
+  STILL_EVOLVING
+};
+
+// Swept every vertex of both shapes on every iteration
+glm::vec3 averagePoint(const Shape &shape) {
+  const vector<glm::vec3> &points = shape.geometry->hull.vertices;
+  glm::vec3 avg = glm::vec3(0.0f, 0.0f, 0.0f);
+  for (size_t i = 0; i < points.size(); i++) {
+    avg += shape.transform.to_world(points[i]);
+  }
+  return avg / (float)points.size();
+}
+
+template <typename S>
+glm::vec3 support(S shape, glm::vec3 direction) {
+  return ::support(shape, direction);
+}
+
+template <typename A, typename B>
+glm::vec3 getSupport(A shapeA, B shapeB, glm::vec3 direction) {
+  return support<A>(shapeA, direction) - support<B>(shapeB, -direction);
+}
+
+template <typename A, typename B>
+bool addSupport(vector<glm::vec3> &simplex, A shapeA, B shapeB, glm::vec3 direction) {
+  glm::vec3 new_point = getSupport<A, B>(shapeA, shapeB, direction);
+  if (find(simplex.begin(), simplex.end(), new_point) != simplex.end()) {
+    return false;
+  }
+  simplex.push_back(new_point);
+  return (dot(direction, new_point) >= 0.0f);
+}
+
+template <typename A, typename B>
+EvolutionStage evolveSimplex(vector<glm::vec3> &simplex, A shapeA, B shapeB,
+                             glm::vec3 &direction) {
+  glm::vec3 avgPointDifference = averagePoint(shapeB) - averagePoint(shapeA);
+
+  switch(simplex.size()) {
+    case 0:
+      direction = avgPointDifference;
+      break;
+    case 1:
+      direction = -avgPointDifference;
+      break;
+    case 2: {
+      glm::vec3 ab = simplex[1] - simplex[0];
+      direction = cross(cross(ab, -simplex[0]), ab);
+      break;
+    }
+    case 3:
+      direction = cross(simplex[2] - simplex[0], simplex[1] - simplex[0]);
+      if (dot(direction, -simplex[0]) < 0) {
+        direction = -direction;
+      }
+      break;
+    case 4: {
+      glm::vec3 da = simplex[3] - simplex[0];
+      glm::vec3 db = simplex[3] - simplex[1];
+      glm::vec3 dc = simplex[3] - simplex[2];
+      glm::vec3 d0 = -simplex[3];
+      glm::vec3 abd_norm = cross(da, db);
+      glm::vec3 bcd_norm = cross(db, dc);
+      glm::vec3 cad_norm = cross(dc, da);
+      if (dot(abd_norm, d0) > 0.0f) {
+        simplex.erase(simplex.begin() + 2);
+        direction = abd_norm;
+      }
+      else if (dot(bcd_norm, d0) > 0.0f) {
+        simplex.erase(simplex.begin() + 0);
+        direction = bcd_norm;
+      }
+      else if (dot(cad_norm, d0) > 0.0f) {
+        simplex.erase(simplex.begin() + 1);
+        direction = cad_norm;
+      }
+      else {
+        return FOUND_INTERSECTION;
+      }
+      break;
+    }
+  }
+
+  return addSupport<A, B>(simplex, shapeA, shapeB, direction) ? STILL_EVOLVING : NO_INTERSECTION;
+}
+
+template <typename A, typename B>
+bool gjk(A shapeA, B shapeB, vector<glm::vec3> &simplex) {
+  EvolutionStage evolveResult = STILL_EVOLVING;
+  glm::vec3 direction = glm::vec3(1.0f, 0.0f, 0.0f);
+  int loopIterations = 0;
+  while (evolveResult == STILL_EVOLVING && loopIterations != 15) {
+    evolveResult = evolveSimplex<A, B>(simplex, shapeA, shapeB, direction);
+    loopIterations++;
+  }
+  return evolveResult == FOUND_INTERSECTION;
+}
+
+}
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+// ---------------------------------------------------------------------------
+
+void benchGjkCopies() {
+  const int QUERIES = 200000;
+  Counted<Tetrahedron> tetrahedron(glm::vec3(-2.0f, 0.0f, 0.0f));
+  Counted<Cube> cube(glm::vec3(0.0f, 0.0f, 0.0f));
+
+  for (int pass = 0; pass < 2; pass++) {
+    bool byValue = (pass == 0);
+    Counted<Tetrahedron>::copies = 0;
+    Counted<Cube>::copies = 0;
+    int hits = 0;
+
+    BenchTimer timer;
+    for (int i = 0; i < QUERIES; i++) {
+      tetrahedron.update_pos(sweepStep(i));
+      if (byValue) {
+        vector<glm::vec3> simplex;
+        hits += by_value::gjk(tetrahedron, cube, simplex);
+      }
+      else {
+        Simplex simplex;
+        hits += gjk(tetrahedron, cube, simplex);
+      }
+    }
+    double elapsed = timer.seconds();
+    benchSink = hits;
+
+    long long copies = Counted<Tetrahedron>::copies + Counted<Cube>::copies;
+    cout << "  " << left << setw(16) << (byValue ? "by value" : "const reference")
+         << fixed << setprecision(0) << setw(12) << QUERIES / elapsed << " queries/s  "
+         << setprecision(2) << (double)copies / QUERIES << " shape copies/query  ("
+         << hits << " hits)" << endl;
+  }
+}
+
+// The support loop GJK used to run over a world space copy of every triangle
+// soup vertex
+glm::vec3 soupSupport(const vector<glm::vec3> &worldSoup, glm::vec3 direction) {
+  float furthestDistance = -FLT_MAX;
+  glm::vec3 furthestVertex = glm::vec3(0.0f, 0.0f, 0.0f);
+  for (size_t i = 0; i < worldSoup.size(); i++) {
+    float distance = dot(worldSoup[i], direction);
+    if (distance > furthestDistance) {
+      furthestDistance = distance;
+      furthestVertex = worldSoup[i];
+    }
+  }
+  return furthestVertex;
+}
+
+vector<glm::vec3> worldSoup(const float soupFloats[], int floatCount, const Transform &transform) {
+  vector<glm::vec3> soup;
+  for (int i = 0; i < floatCount; i += 3) {
+    soup.push_back(transform.to_world(glm::vec3(soupFloats[i], soupFloats[i+1], soupFloats[i+2])));
+  }
+  return soup;
+}
+
+// The soup as the old world space vertex copy, the soup in model space going
+// through the same transforms support() pays for, and the hull through support()
+void benchSupportHull() {
+  const int QUERIES = 4000000;
+  vector<glm::vec3> directions = randomDirections(1024);
+  Cube cube(glm::vec3(0.0f, 0.0f, 0.0f));
+  Tetrahedron tetrahedron(glm::vec3(-2.0f, 0.0f, 0.0f));
+  const Shape *shapes[] = {&cube, &tetrahedron};
+  vector<glm::vec3> soups[] = {
+    worldSoup(Cube::model_vertices_float, Cube::VERTICES_NUM_FLOAT, cube.transform),
+    worldSoup(Tetrahedron::model_vertices_floats, Tetrahedron::VERTICES_NUM_FLOAT, tetrahedron.transform)
+  };
+  vector<glm::vec3> modelSoups[] = {
+    worldSoup(Cube::model_vertices_float, Cube::VERTICES_NUM_FLOAT, Transform()),
+    worldSoup(Tetrahedron::model_vertices_floats, Tetrahedron::VERTICES_NUM_FLOAT, Transform())
+  };
+  const char *names[] = {"cube", "tetrahedron"};
+
+  for (int s = 0; s < 2; s++) {
+    const Shape &shape = *shapes[s];
+    const ConvexHull &hull = shape.geometry->hull;
+    cout << "  " << names[s] << ": " << soups[s].size() << " soup vertices -> "
+         << hull.vertices.size() << " vertices, " << hull.faces.size() << " faces, "
+         << hull.edges.size() << " edges" << endl;
+
+    double rates[3];
+    for (int pass = 0; pass < 3; pass++) {
+      glm::vec3 sum = glm::vec3(0.0f);
+      BenchTimer timer;
+      for (int i = 0; i < QUERIES; i++) {
+        glm::vec3 d = directions[i & 1023];
+        if (pass == 0) {
+          sum += soupSupport(soups[s], d);
+        }
+        else if (pass == 1) {
+          sum += shape.transform.to_world(
+            soupSupport(modelSoups[s], shape.transform.to_local_direction(d)));
+        }
+        else {
+          sum += support(shape, d);
+        }
+      }
+      rates[pass] = QUERIES / timer.seconds();
+      benchSink = (int)sum.x;
+    }
+    cout << "    world soup " << fixed << setprecision(0) << rates[0] << " supports/s, model soup "
+         << rates[1] << " supports/s, hull " << rates[2] << " supports/s ("
+         << setprecision(2) << rates[2] / rates[0] << "x world soup, "
+         << rates[2] / rates[1] << "x model soup)" << endl;
+  }
+}
+
+void benchSupportHillClimb() {
+  const int QUERIES = 1000000;
+  vector<glm::vec3> randomDirs = randomDirections(1024);
+  // directions that drift slowly, like consecutive GJK iterations/frames
+  vector<glm::vec3> coherentDirs;
+  for (int i = 0; i < 1024; i++) {
+    float t = i * 0.02f;
+    coherentDirs.push_back(glm::normalize(glm::vec3(cosf(t), sinf(1.3f * t), sinf(t) * 0.5f)));
+  }
+
+  cout << "  " << left << setw(10) << "vertices" << setw(12) << "linear ns"
+       << setw(16) << "climb cold ns" << setw(16) << "climb warm ns" << "mismatches" << endl;
+  int sizes[][2] = {{3, 4}, {4, 8}, {6, 12}, {8, 16}, {12, 24}, {16, 32}, {23, 45}};
+  for (int s = 0; s < 7; s++) {
+    vector<glm::vec3> soup = sphereSoup(sizes[s][0], sizes[s][1], 1.0f);
+    ConvexHull hull(&soup[0], (int)soup.size());
+
+    int mismatches = 0;
+    for (int i = 0; i < 1024; i++) {
+      glm::vec3 d = randomDirs[i];
+      float expected = dot(hull.vertices[hull.linear_support_index(d)], d);
+      float got = dot(hull.vertices[hull.hill_climb_support_index(d, i % hull.vertices.size())], d);
+      mismatches += (got < expected - 1e-5f);
+    }
+
+    double ns[3];
+    for (int pass = 0; pass < 3; pass++) {
+      const vector<glm::vec3> &dirs = (pass == 2) ? coherentDirs : randomDirs;
+      int hint = 0;
+      int sum = 0;
+      BenchTimer timer;
+      for (int i = 0; i < QUERIES; i++) {
+        glm::vec3 d = dirs[i & 1023];
+        if (pass == 0) {
+          sum += hull.linear_support_index(d);
+        }
+        else {
+          int index = hull.hill_climb_support_index(d, hint);
+          sum += index;
+          // the cold pass always starts from vertex 0
+          if (pass == 2) {
+            hint = index;
+          }
+        }
+      }
+      ns[pass] = timer.seconds() * 1e9 / QUERIES;
+      benchSink = sum;
+    }
+    cout << "  " << setw(10) << hull.vertices.size() << fixed << setprecision(1)
+         << setw(12) << ns[0] << setw(16) << ns[1] << setw(16) << ns[2] << mismatches << endl;
+  }
+  cout << "  (support_index switches to climbing at " << HILL_CLIMB_MIN_VERTICES << " vertices)" << endl;
+}
+
+void benchSupportSimd() {
+  const int QUERIES = 1000000;
+  vector<glm::vec3> directions = randomDirections(1024);
+  SupportPath best = detectSupportPath();
+  const SupportPath paths[] = {SUPPORT_SCALAR, SUPPORT_SSE, SUPPORT_AVX2};
+
+  cout << "  this CPU runs up to " << supportPathName(best) << endl;
+  cout << "  " << left << setw(10) << "vertices";
+  for (SupportPath path : paths) {
+    cout << setw(14) << (string(supportPathName(path)) + " ns");
+  }
+  cout << setw(10) << "speedup" << "mismatches" << endl;
+
+  int sizes[][2] = {{2, 6}, {3, 7}, {4, 10}, {5, 15}, {8, 18}, {15, 18}, {18, 30}, {32, 33}};
+  for (int s = 0; s < 8; s++) {
+    vector<glm::vec3> soup = sphereSoup(sizes[s][0], sizes[s][1], 1.0f);
+    ConvexHull hull(&soup[0], (int)soup.size());
+
+    int mismatches = 0;
+    for (int i = 0; i < 1024; i++) {
+      int expected = hull.linear_support_index(directions[i], SUPPORT_SCALAR);
+      for (SupportPath path : paths) {
+        if (path <= best) {
+          mismatches += (hull.linear_support_index(directions[i], path) != expected);
+        }
+      }
+    }
+
+    cout << "  " << setw(10) << hull.vertices.size() << fixed << setprecision(1);
+    double ns[3] = {0.0, 0.0, 0.0};
+    for (int p = 0; p < 3; p++) {
+      if (paths[p] > best) {
+        cout << setw(14) << "-";
+        continue;
+      }
+      int sum = 0;
+      BenchTimer timer;
+      for (int i = 0; i < QUERIES; i++) {
+        sum += hull.linear_support_index(directions[i & 1023], paths[p]);
+      }
+      ns[p] = timer.seconds() * 1e9 / QUERIES;
+      benchSink = sum;
+      cout << setw(14) << ns[p];
+    }
+    cout << setprecision(2) << setw(10) << ns[0] / ns[best] << mismatches << endl;
+  }
+}
+
+void benchGeometryMemory() {
+  // What every Cube used to carry: vtable pointer, vao/vbo, pos, three
+  // pointers, its own copy of the float soup and heap allocated model/world
+  // vertex arrays. On top of that each one had its own VBO on the GPU.
+  const size_t legacyCpuBytes = sizeof(void*) + 2 * sizeof(unsigned int) + sizeof(glm::vec3)
+    + 3 * sizeof(void*) + Cube::VERTICES_NUM_FLOAT * sizeof(float)
+    + 2 * Cube::VERTICES_NUM_VEC3 * sizeof(glm::vec3);
+  const size_t legacyGpuBytes = Cube::VERTICES_NUM_FLOAT * sizeof(float);
+
+  cout << "  " << left << setw(10) << "bodies" << setw(12) << "geometries" << setw(16)
+       << "registry bytes" << setw(16) << "bytes/body" << setw(22) << "before: bytes/body"
+       << "GPU buffers (before)" << endl;
+  int counts[] = {1, 100, 10000, 100000};
+  for (int c = 0; c < 4; c++) {
+    vector<Cube> cubes;
+    cubes.reserve(counts[c]);
+    for (int i = 0; i < counts[c]; i++) {
+      cubes.push_back(Cube(glm::vec3((float)i, 0.0f, 0.0f)));
+    }
+    size_t registryBytes = geometry_registry().memory_bytes();
+    double perBody = (double)(registryBytes + cubes.size() * sizeof(Cube)) / cubes.size();
+    cout << "  " << setw(10) << counts[c] << setw(12) << geometry_registry().size()
+         << setw(16) << registryBytes << fixed << setprecision(1) << setw(16) << perBody
+         << setw(22) << (double)(legacyCpuBytes + legacyGpuBytes)
+         << geometry_registry().size() << " (" << counts[c] << ")" << endl;
+  }
+  cout << "  sizeof(Cube) = " << sizeof(Cube) << " bytes, the shared geometry is released with the last body"
+       << " (" << geometry_registry().size() << " geometries left)" << endl;
+}
+
+void benchGjkAllocations() {
+  const int QUERIES = 200000;
+  Tetrahedron tetrahedron(glm::vec3(-2.0f, 0.0f, 0.0f));
+  Cube cube(glm::vec3(0.0f, 0.0f, 0.0f));
+
+  for (int pass = 0; pass < 2; pass++) {
+    bool vectorSimplex = (pass == 0);
+    int hits = 0;
+    long long allocationsBefore = benchAllocations;
+
+    BenchTimer timer;
+    for (int i = 0; i < QUERIES; i++) {
+      tetrahedron.update_pos(sweepStep(i));
+      if (vectorSimplex) {
+        vector<glm::vec3> simplex;
+        hits += by_value::gjk<const Shape &, const Shape &>(tetrahedron, cube, simplex);
+      }
+      else {
+        Simplex simplex;
+        hits += gjk(tetrahedron, cube, simplex);
+      }
+    }
+    double elapsed = timer.seconds();
+    benchSink = hits;
+
+    long long allocations = benchAllocations - allocationsBefore;
+    cout << "  " << left << setw(16) << (vectorSimplex ? "vector simplex" : "Simplex")
+         << fixed << setprecision(0) << setw(12) << QUERIES / elapsed << " queries/s  "
+         << setprecision(2) << (double)allocations / QUERIES << " heap allocations/query" << endl;
+    if (!vectorSimplex && allocations != 0) {
+      cout << "  FAIL: GJK with Simplex made " << allocations << " heap allocations" << endl;
+    }
+  }
+}
+
+void benchGjkStress() {
+  const int PAIRS = 2000;
+  const int FRAMES = 200;
+  const char *names[] = {"per-iteration average", "cached centroids", "+ separating axis"};
+
+  for (int pass = 0; pass < 3; pass++) {
+    StressScene scene(PAIRS);
+    vector<GjkCache> caches(PAIRS);
+    long long iterations = 0;
+    int hits = 0;
+
+    BenchTimer timer;
+    for (int frame = 0; frame < FRAMES; frame++) {
+      scene.step();
+      for (int i = 0; i < PAIRS; i++) {
+        if (pass == 0) {
+          vector<glm::vec3> simplex;
+          hits += by_value::gjk<const Shape &, const Shape &>(scene.tetrahedrons[i], scene.cubes[i], simplex);
+          continue;
+        }
+        Simplex simplex;
+        // simplex warm starts are measured by pair_cache
+        caches[i].simplex_size = 0;
+        if (pass == 1) {
+          caches[i].has_separating_axis = false;
+        }
+        hits += gjk(scene.tetrahedrons[i], scene.cubes[i], simplex, &caches[i]);
+        iterations += caches[i].iterations;
+      }
+    }
+    double elapsed = timer.seconds();
+    benchSink = hits;
+
+    cout << "  " << left << setw(24) << names[pass] << fixed << setprecision(2)
+         << setw(10) << elapsed * 1e3 / FRAMES << " ms/frame  ";
+    if (pass == 0) {
+      cout << "   -  iterations/query";
+    }
+    else {
+      cout << setw(5) << (double)iterations / ((double)PAIRS * FRAMES) << " iterations/query";
+    }
+    cout << "  (" << (double)hits / FRAMES << " of " << PAIRS << " pairs overlapping)" << endl;
+  }
+}
+
+void benchGjkDistance() {
+  // Unit cubes at known offsets, the exact distance is easy to work out
+  struct Case {
+    glm::vec3 offset;
+    float expected;
+  };
+  Case cases[] = {
+    {glm::vec3(1.5f, 0.0f, 0.0f), 0.5f},
+    {glm::vec3(1.001f, 0.3f, -0.2f), 0.001f},
+    {glm::vec3(0.0f, -3.0f, 0.0f), 2.0f},
+    {glm::vec3(1.3f, 1.4f, 0.0f), sqrtf(0.3f * 0.3f + 0.4f * 0.4f)},
+    {glm::vec3(1.1f, 1.2f, 1.3f), sqrtf(0.01f + 0.04f + 0.09f)},
+    {glm::vec3(0.9f, 0.0f, 0.0f), 0.0f},
+  };
+  Cube origin(glm::vec3(0.0f, 0.0f, 0.0f));
+  cout << "  " << left << setw(34) << "cube offset" << setw(12) << "expected" << setw(12)
+       << "distance" << setw(12) << "iterations" << "witness points" << endl;
+  for (const Case &c : cases) {
+    Cube other(c.offset);
+    Simplex simplex;
+    GjkDistanceResult result;
+    gjkDistance(origin, other, simplex, result);
+    cout << "  " << setw(34) << glm::to_string(c.offset).substr(4) << fixed << setprecision(5)
+         << setw(12) << c.expected << setw(12) << result.distance << setw(12) << result.iterations
+         << (result.overlapping ? string("overlapping")
+             : glm::to_string(result.point_a).substr(4) + " " + glm::to_string(result.point_b).substr(4))
+         << endl;
+  }
+
+  const int PAIRS = 2000;
+  const int FRAMES = 100;
+  StressScene scene(PAIRS);
+  vector<GjkCache> caches(PAIRS);
+  long long iterations = 0;
+  int disagreements = 0;
+  double distanceTime = 0.0;
+  double booleanTime = 0.0;
+  for (int frame = 0; frame < FRAMES; frame++) {
+    scene.step();
+    vector<bool> hits(PAIRS);
+    BenchTimer booleanTimer;
+    for (int i = 0; i < PAIRS; i++) {
+      Simplex simplex;
+      hits[i] = gjk(scene.tetrahedrons[i], scene.cubes[i], simplex);
+    }
+    booleanTime += booleanTimer.seconds();
+
+    BenchTimer distanceTimer;
+    for (int i = 0; i < PAIRS; i++) {
+      Simplex simplex;
+      GjkDistanceResult result;
+      bool overlapping = gjkDistance(scene.tetrahedrons[i], scene.cubes[i], simplex, result, &caches[i]);
+      iterations += result.iterations;
+      disagreements += (overlapping != hits[i]);
+    }
+    distanceTime += distanceTimer.seconds();
+  }
+  double queries = (double)PAIRS * FRAMES;
+  cout << "  stress scene: distance " << fixed << setprecision(0) << queries / distanceTime
+       << " queries/s (" << setprecision(2) << iterations / queries << " iterations/query), boolean "
+       << setprecision(0) << queries / booleanTime << " queries/s, " << disagreements
+       << " overlap disagreements" << endl;
+}
+
+void benchEpa() {
+  const int QUERIES = 100000;
+  float depths[] = {0.01f, 0.05f, 0.2f, 0.4f, 0.7f};
+  Cube cube(glm::vec3(0.0f, 0.0f, 0.0f));
+
+  cout << "  " << left << setw(16) << "pair" << setw(10) << "expected" << setw(10) << "depth"
+       << setw(34) << "normal" << setw(12) << "epa iters" << setw(14) << "us/query" << "allocations/query" << endl;
+  for (int pair = 0; pair < 2; pair++) {
+    bool boxBox = (pair == 0);
+    for (float expected : depths) {
+      // The other cube sits along +x, slightly off axis so x is the shallowest
+      // axis. The tetrahedron's tip points along +x into the cube's -x face.
+      Cube otherCube(glm::vec3(1.0f - expected, 0.1f, 0.05f));
+      Tetrahedron tetrahedron(glm::vec3(-1.0f + expected, 0.05f, 0.02f));
+      const Shape &shapeA = boxBox ? (const Shape &)cube : (const Shape &)tetrahedron;
+      const Shape &shapeB = boxBox ? (const Shape &)otherCube : (const Shape &)cube;
+
+      EpaResult result;
+      bool found = false;
+      long long allocationsBefore = benchAllocations;
+      BenchTimer timer;
+      for (int i = 0; i < QUERIES; i++) {
+        Simplex simplex;
+        found = gjk(shapeA, shapeB, simplex) && epa(shapeA, shapeB, simplex, result);
+      }
+      double elapsed = timer.seconds();
+      long long allocations = benchAllocations - allocationsBefore;
+
+      cout << "  " << setw(16) << (boxBox ? "box-box" : "tetra-box") << fixed << setprecision(3)
+           << setw(10) << expected;
+      if (found) {
+        cout << setw(10) << result.depth << setw(34) << glm::to_string(result.normal).substr(4)
+             << setw(12) << result.iterations;
+      }
+      else {
+        cout << setw(56) << "no overlap found";
+      }
+      cout << setw(14) << elapsed * 1e6 / QUERIES << setprecision(2) << (double)allocations / QUERIES << endl;
+    }
+  }
+}
+
+void benchPairCache() {
+  const int PAIRS = 2000;
+  const int FRAMES = 200;
+  const char *names[] = {"no cache", "separating axis only", "pair cache"};
+
+  for (int query = 0; query < 2; query++) {
+    cout << "  " << (query == 0 ? "boolean gjk" : "gjk distance") << endl;
+    for (int pass = 0; pass < 3; pass++) {
+      StressScene scene(PAIRS);
+      PairCache pairCache;
+      long long iterations = 0;
+      int hits = 0;
+
+      BenchTimer timer;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        scene.step();
+        pairCache.next_frame();
+        for (int i = 0; i < PAIRS; i++) {
+          const Shape &shapeA = scene.tetrahedrons[i];
+          const Shape &shapeB = scene.cubes[i];
+          Simplex simplex;
+          GjkDistanceResult result;
+          if (pass == 2) {
+            hits += query == 0 ? pairCache.gjk(shapeA, shapeB, simplex)
+                               : pairCache.gjkDistance(shapeA, shapeB, simplex, result);
+            continue;
+          }
+          GjkCache localCache;
+          GjkCache *cache = NULL;
+          if (pass == 1) {
+            cache = &pairCache.find(shapeA, shapeB);
+            cache->simplex_size = 0;
+          }
+          else {
+            cache = &localCache;
+          }
+          hits += query == 0 ? gjk(shapeA, shapeB, simplex, cache)
+                             : gjkDistance(shapeA, shapeB, simplex, result, cache);
+          iterations += cache->iterations;
+        }
+      }
+      double elapsed = timer.seconds();
+      benchSink = hits;
+
+      double queries = (double)PAIRS * FRAMES;
+      if (pass == 2) {
+        iterations = pairCache.iterations;
+      }
+      cout << "    " << left << setw(24) << names[pass] << fixed << setprecision(2)
+           << setw(10) << elapsed * 1e3 / FRAMES << " ms/frame  " << setw(5)
+           << iterations / queries << " iterations/query";
+      if (pass == 2) {
+        cout << "  " << setprecision(1) << pairCache.hit_rate() * 100.0f << "% simplex hits, "
+             << pairCache.size() << " cached pairs";
+      }
+      cout << "  (" << setprecision(2) << (double)hits / FRAMES << " of " << PAIRS
+           << " pairs overlapping)" << endl;
+    }
+  }
+}
+
+void benchGjkBatch() {
+  const int PAIRS = 10000;
+  const int REPEATS = 20;
+  // Random cubes and tetrahedrons scattered so that about half the pairs
+  // overlap, paired up at random
+  srand(7);
+  vector<Cube> cubes;
+  vector<Tetrahedron> tetrahedrons;
+  for (int i = 0; i < PAIRS; i++) {
+    glm::vec3 position = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 2.5f;
+    glm::quat orientation = glm::angleAxis((float)rand() / RAND_MAX * 6.28f,
+      glm::normalize(glm::vec3(rand(), rand(), rand()) + 1.0f));
+    cubes.push_back(Cube(position));
+    cubes.back().update_orientation(orientation);
+    tetrahedrons.push_back(Tetrahedron(glm::vec3(position.z, position.x, position.y)));
+    tetrahedrons.back().update_orientation(glm::conjugate(orientation));
+  }
+  vector<GjkPair> pairs(PAIRS);
+  for (int i = 0; i < PAIRS; i++) {
+    int kind = rand() % 3;
+    const Shape *cube = &cubes[rand() % PAIRS];
+    const Shape *tetrahedron = &tetrahedrons[rand() % PAIRS];
+    pairs[i].a = (kind == 0) ? cube : tetrahedron;
+    pairs[i].b = (kind == 2) ? tetrahedron : cube;
+    if (kind == 0) {
+      pairs[i].b = &cubes[rand() % PAIRS];
+    }
+  }
+
+  vector<GjkDistanceResult> scalarResults(PAIRS);
+  vector<GjkDistanceResult> batchResults(PAIRS);
+  // bool arrays, vector<bool> has no bool* to hand out
+  unique_ptr<bool[]> scalarOverlaps(new bool[PAIRS]);
+  unique_ptr<bool[]> batchOverlaps(new bool[PAIRS]);
+  int overlaps[4] = {0, 0, 0, 0};
+  // The passes take turns and each keeps its fastest repeat, so a noisy
+  // stretch of the run does not land on one side of the comparison
+  double seconds[4] = {1e30, 1e30, 1e30, 1e30};
+  for (int r = 0; r < REPEATS; r++) {
+    for (int pass = 0; pass < 4; pass++) {
+      BenchTimer timer;
+      if (pass == 0) {
+        overlaps[0] = 0;
+        for (int i = 0; i < PAIRS; i++) {
+          Simplex simplex;
+          overlaps[0] += gjkDistance(*pairs[i].a, *pairs[i].b, simplex, scalarResults[i]);
+        }
+      }
+      else if (pass == 1) {
+        overlaps[1] = gjkDistanceBatch(&pairs[0], PAIRS, &batchResults[0]);
+      }
+      else if (pass == 2) {
+        overlaps[2] = 0;
+        for (int i = 0; i < PAIRS; i++) {
+          Simplex simplex;
+          scalarOverlaps[i] = gjk(*pairs[i].a, *pairs[i].b, simplex);
+          overlaps[2] += scalarOverlaps[i];
+        }
+      }
+      else {
+        overlaps[3] = gjkBatch(&pairs[0], PAIRS, batchOverlaps.get());
+      }
+      seconds[pass] = min(seconds[pass], timer.seconds());
+    }
+  }
+
+  int mismatches[2] = {0, 0};
+  for (int i = 0; i < PAIRS; i++) {
+    mismatches[0] += (scalarResults[i].overlapping != batchResults[i].overlapping
+                      || fabsf(scalarResults[i].distance - batchResults[i].distance) > 1e-4f);
+    mismatches[1] += scalarOverlaps[i] != batchOverlaps[i];
+  }
+  double queries = (double)PAIRS;
+  const char *names[4] = {"gjkDistance", "gjkDistanceBatch", "gjk", "gjkBatch"};
+  cout << "  " << left << setw(18) << "query" << setw(14) << "pairs/s" << setw(13) << "overlapping"
+       << setw(10) << "speedup" << "disagree" << endl;
+  for (int pass = 0; pass < 4; pass++) {
+    bool batched = pass % 2 == 1;
+    cout << "  " << setw(18) << names[pass] << fixed << setprecision(0) << setw(14) << queries / seconds[pass]
+         << setw(13) << overlaps[pass] << setprecision(2) << setw(10)
+         << (batched ? seconds[pass - 1] / seconds[pass] : 1.0);
+    if (batched) {
+      cout << mismatches[pass / 2];
+    }
+    cout << endl;
+  }
+  cout << "  " << GJK_BATCH_LANES << " lanes, disagree counts pairs whose overlap (or distance, to 1e-4) "
+       << "differs from the scalar query's" << endl;
+}
+
+// A body whose hull is a triangle soup, for comparing against implicit shapes
+class SoupShape : public Shape {
+public:
+  SoupShape(const string &name, const vector<glm::vec3> &soup, glm::vec3 position) {
+    transform.position = position;
+    geometry = geometry_registry().acquire(name, &soup[0].x, (int)soup.size() * 3);
+  }
+};
+
+void benchImplicitShapes() {
+  // Known distances, worked out by hand from the shapes' dimensions
+  Sphere sphere(glm::vec3(0.0f, 0.0f, 0.0f), 0.5f);
+  Capsule capsule(glm::vec3(0.0f, 0.0f, 0.0f), 0.5f, 0.25f);
+  Cylinder cylinder(glm::vec3(0.0f, 0.0f, 0.0f), 0.5f, 0.5f);
+  Cone cone(glm::vec3(0.0f, 0.0f, 0.0f), 0.5f, 0.5f);
+  Box roundedBox(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.5f, 0.5f, 0.5f), 0.1f);
+  Sphere ball(glm::vec3(0.0f, 0.0f, 0.0f), 0.25f);
+  Cube cube(glm::vec3(0.0f, 0.0f, 0.0f));
+  struct Case {
+    const char *name;
+    const Shape *a;
+    Shape *b;
+    glm::vec3 offset;
+    float expected;
+  };
+  Case cases[] = {
+    {"sphere-sphere", &sphere, &ball, glm::vec3(1.0f, 0.0f, 0.0f), 0.25f},
+    {"sphere-cube", &sphere, &cube, glm::vec3(0.0f, 0.0f, 1.5f), 0.5f},
+    {"capsule-sphere tip", &capsule, &ball, glm::vec3(0.0f, 1.5f, 0.0f), 0.5f},
+    {"capsule-sphere side", &capsule, &ball, glm::vec3(1.0f, 0.2f, 0.0f), 0.5f},
+    {"cylinder-sphere side", &cylinder, &ball, glm::vec3(1.2f, 0.0f, 0.0f), 0.45f},
+    {"cylinder-cube cap", &cylinder, &cube, glm::vec3(0.2f, 1.5f, 0.0f), 0.5f},
+    {"cone-sphere tip", &cone, &ball, glm::vec3(0.0f, 1.5f, 0.0f), 0.75f},
+    {"cone-sphere base", &cone, &ball, glm::vec3(0.0f, -1.5f, 0.0f), 0.75f},
+    {"rounded box-cube", &roundedBox, &cube, glm::vec3(1.5f, 0.2f, 0.0f), 0.5f},
+    {"rounded box-sphere", &roundedBox, &ball, glm::vec3(1.0f, 1.0f, 0.0f), sqrtf(0.72f) - 0.35f},
+  };
+  cout << "  " << left << setw(22) << "pair" << setw(12) << "expected" << setw(12) << "distance"
+       << "iterations" << endl;
+  for (const Case &c : cases) {
+    c.b->transform.position = c.offset;
+    Simplex simplex;
+    GjkDistanceResult result;
+    gjkDistance(*c.a, *c.b, simplex, result);
+    cout << "  " << setw(22) << c.name << fixed << setprecision(5) << setw(12) << c.expected
+         << setw(12) << result.distance << result.iterations << endl;
+  }
+
+  for (float depth : {0.05f, 0.2f}) {
+    Sphere other(glm::vec3(0.75f - depth, 0.0f, 0.0f), 0.25f);
+    Simplex simplex;
+    EpaResult result;
+    bool found = gjk(sphere, other, simplex) && epa(sphere, other, simplex, result);
+    cout << "  epa sphere-sphere expected depth " << setprecision(3) << depth << ", got "
+         << (found ? result.depth : 0.0f) << " in " << result.iterations << " iterations" << endl;
+  }
+
+  // The same sphere pair as implicit spheres and as tessellated hulls, the
+  // way a rounded prop would have to be modelled without implicit shapes
+  const int QUERIES = 200000;
+  vector<glm::vec3> soup = sphereSoup(23, 45, 0.5f);
+  SoupShape hullA("bench sphere", soup, glm::vec3(0.0f, 0.0f, 0.0f));
+  SoupShape hullB("bench sphere", soup, glm::vec3(0.0f, 0.0f, 0.0f));
+  Sphere implicitA(glm::vec3(0.0f, 0.0f, 0.0f), 0.5f);
+  Sphere implicitB(glm::vec3(0.0f, 0.0f, 0.0f), 0.5f);
+  vector<glm::vec3> offsets = randomDirections(1024);
+  for (glm::vec3 &offset : offsets) {
+    offset *= 1.2f;
+  }
+  cout << "  " << setw(22) << "sphere pair" << setw(12) << "us/query" << "iterations/query" << endl;
+  for (int pass = 0; pass < 2; pass++) {
+    Shape &a = pass == 0 ? (Shape &)hullA : (Shape &)implicitA;
+    Shape &b = pass == 0 ? (Shape &)hullB : (Shape &)implicitB;
+    long long iterations = 0;
+    float sum = 0.0f;
+    BenchTimer timer;
+    for (int i = 0; i < QUERIES; i++) {
+      b.transform.position = offsets[i & 1023];
+      Simplex simplex;
+      GjkDistanceResult result;
+      gjkDistance(a, b, simplex, result);
+      iterations += result.iterations;
+      sum += result.distance;
+    }
+    double elapsed = timer.seconds();
+    benchSink = (int)sum;
+    string name = pass == 0 ? "hull, " + to_string(hullA.geometry->hull.vertices.size()) + " vertices" : "implicit";
+    cout << "  " << setw(22) << name << setprecision(3) << setw(12) << elapsed * 1e6 / QUERIES
+         << setprecision(2) << (double)iterations / QUERIES << endl;
+  }
+}
+
+// Holds shapes of every kind for benchmarks that mix them. Shapes are handed
+// out by pointer, so no more than capacity of each kind can be added.
+struct ShapeZoo {
+  vector<Sphere> spheres;
+  vector<Capsule> capsules;
+  vector<Box> boxes;
+  vector<Cylinder> cylinders;
+  vector<Cube> cubes;
+  vector<Tetrahedron> tetrahedrons;
+
+  ShapeZoo(int capacity) {
+    spheres.reserve(capacity);
+    capsules.reserve(capacity);
+    boxes.reserve(capacity);
+    cylinders.reserve(capacity);
+    cubes.reserve(capacity);
+    tetrahedrons.reserve(capacity);
+  }
+
+  Shape *add(ShapeType type, glm::vec3 position, glm::quat orientation) {
+    Shape *shape;
+    switch (type) {
+      case SHAPE_SPHERE:
+        spheres.push_back(Sphere(position, 0.5f));
+        shape = &spheres.back();
+        break;
+      case SHAPE_CAPSULE:
+        capsules.push_back(Capsule(position, 0.4f, 0.3f));
+        shape = &capsules.back();
+        break;
+      case SHAPE_BOX:
+        boxes.push_back(Box(position, glm::vec3(0.6f, 0.4f, 0.3f)));
+        shape = &boxes.back();
+        break;
+      case SHAPE_CYLINDER:
+        cylinders.push_back(Cylinder(position, 0.4f, 0.4f));
+        shape = &cylinders.back();
+        break;
+      case SHAPE_CUBE:
+        cubes.push_back(Cube(position));
+        shape = &cubes.back();
+        break;
+      default:
+        tetrahedrons.push_back(Tetrahedron(position));
+        shape = &tetrahedrons.back();
+        break;
+    }
+    shape->transform.orientation = orientation;
+    return shape;
+  }
+};
+
+glm::quat randomOrientation() {
+  return glm::angleAxis((float)rand() / RAND_MAX * 6.28f,
+                        glm::normalize(glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 2.0f - 1.0f + 0.001f));
+}
+
+void benchNarrowphase() {
+  const int PAIRS = 4000;
+  const int REPEATS = 20;
+  struct PairType {
+    const char *name;
+    ShapeType a;
+    ShapeType b;
+  };
+  PairType pairTypes[] = {
+    {"sphere-sphere", SHAPE_SPHERE, SHAPE_SPHERE},
+    {"sphere-capsule", SHAPE_SPHERE, SHAPE_CAPSULE},
+    {"capsule-sphere", SHAPE_CAPSULE, SHAPE_SPHERE},
+    {"capsule-capsule", SHAPE_CAPSULE, SHAPE_CAPSULE},
+    {"sphere-box", SHAPE_SPHERE, SHAPE_BOX},
+    {"box-sphere", SHAPE_BOX, SHAPE_SPHERE},
+    {"sphere-cube", SHAPE_SPHERE, SHAPE_CUBE},
+    {"box-box", SHAPE_BOX, SHAPE_BOX},
+    {"box-cube", SHAPE_BOX, SHAPE_CUBE},
+    {"cube-cube", SHAPE_CUBE, SHAPE_CUBE},
+    {"tetra-cube (gjk)", SHAPE_HULL, SHAPE_CUBE},
+    {"sphere-cylinder (gjk)", SHAPE_SPHERE, SHAPE_CYLINDER},
+  };
+
+  cout << "  " << left << setw(24) << "pair" << setw(12) << "gjk+epa ns" << setw(14) << "dispatch ns"
+       << setw(10) << "speedup" << setw(12) << "overlaps" << setw(14) << "disagree" << "max depth diff" << endl;
+  for (const PairType &pairType : pairTypes) {
+    // B lands somewhere within 1.5 of A, about half the pairs overlap
+    srand(11);
+    ShapeZoo zoo(2 * PAIRS);
+    vector<const Shape *> shapesA, shapesB;
+    vector<glm::vec3> offsets = randomDirections(PAIRS);
+    for (int i = 0; i < PAIRS; i++) {
+      glm::vec3 position = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 20.0f;
+      glm::vec3 offset = offsets[i] * (0.2f + 1.3f * rand() / RAND_MAX);
+      shapesA.push_back(zoo.add(pairType.a, position, randomOrientation()));
+      shapesB.push_back(zoo.add(pairType.b, position + offset, randomOrientation()));
+    }
+
+    vector<ContactManifold> manifolds[2];
+    vector<char> hits[2];
+    double seconds[2];
+    for (int pass = 0; pass < 2; pass++) {
+      manifolds[pass].resize(PAIRS);
+      hits[pass].resize(PAIRS);
+      BenchTimer timer;
+      for (int r = 0; r < REPEATS; r++) {
+        for (int i = 0; i < PAIRS; i++) {
+          hits[pass][i] = (pass == 0) ? collideGjkEpa(*shapesA[i], *shapesB[i], manifolds[pass][i])
+                                      : narrowphase(*shapesA[i], *shapesB[i], manifolds[pass][i]);
+        }
+      }
+      seconds[pass] = timer.seconds();
+    }
+
+    // EPA stops within a tolerance of curved surfaces and the box SAT takes a
+    // face axis over a slightly shallower edge axis, so depths are only
+    // compared, not required to match
+    int overlaps = 0;
+    int disagreements = 0;
+    float maxDepthDiff = 0.0f;
+    for (int i = 0; i < PAIRS; i++) {
+      overlaps += hits[1][i];
+      if (hits[0][i] != hits[1][i]) {
+        // grazing pairs EPA can't find a depth for
+        disagreements += !(hits[1][i] && manifolds[1][i].depth() < 1e-3f);
+      }
+      else if (hits[1][i]) {
+        maxDepthDiff = max(maxDepthDiff, fabsf(manifolds[0][i].depth() - manifolds[1][i].depth()));
+      }
+    }
+    double queries = (double)PAIRS * REPEATS;
+    cout << "  " << setw(24) << pairType.name << fixed << setprecision(1) << setw(12)
+         << seconds[0] * 1e9 / queries << setw(14) << seconds[1] * 1e9 / queries << setprecision(2)
+         << setw(10) << seconds[0] / seconds[1] << setw(12) << overlaps << setw(14) << disagreements
+         << setprecision(5) << maxDepthDiff << endl;
+  }
+}
+
+void benchBoxStack() {
+  const int STACKS = 100;
+  const int HEIGHT = 8;
+  const int FRAMES = 100;
+  // how far resting boxes sink into each other
+  const float PENETRATION = 0.005f;
+  const char *methods[] = {"gjk+epa", "sat manifold"};
+  // ShapeZoo's Box is 0.8 tall, Cube is 1
+  ShapeType types[] = {SHAPE_CUBE, SHAPE_BOX};
+  float halfHeights[] = {0.5f, 0.4f};
+
+  cout << "  " << left << setw(8) << "stack" << setw(16) << "method" << setw(10) << "ns/pair" << setw(13)
+       << "points/pair" << setw(8) << "missed" << setw(18) << "normal jitter deg" << setw(19)
+       << "centroid jitter mm" << "depth error mm" << endl;
+  for (int scene = 0; scene < 2; scene++) {
+    // Stacks of boxes, each twisted and shifted a little on the one below.
+    // Whole stacks are turned to random orientations, gravity doesn't come
+    // into it.
+    srand(21);
+    ShapeZoo zoo(STACKS * HEIGHT);
+    vector<Shape *> shapes;
+    vector<Transform> rest;
+    for (int s = 0; s < STACKS; s++) {
+      Transform stack;
+      stack.position = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 100.0f;
+      stack.orientation = randomOrientation();
+      for (int level = 0; level < HEIGHT; level++) {
+        glm::vec3 shift = glm::vec3(rand() - RAND_MAX / 2, 0, rand() - RAND_MAX / 2) / (float)RAND_MAX * 0.2f;
+        Transform box;
+        box.position = stack.to_world(glm::vec3(0.0f, level * (2.0f * halfHeights[scene] - PENETRATION), 0.0f) + shift);
+        box.orientation = stack.orientation * glm::angleAxis((float)rand() / RAND_MAX * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+        rest.push_back(box);
+        shapes.push_back(zoo.add(types[scene], box.position, box.orientation));
+      }
+    }
+
+    for (int method = 0; method < 2; method++) {
+      vector<ContactManifold> previous(STACKS * HEIGHT);
+      double seconds = 0.0;
+      long long points = 0;
+      long long pairs = 0;
+      int missed = 0;
+      double normalJitter = 0.0;
+      double centroidJitter = 0.0;
+      double depthError = 0.0;
+      long long compared = 0;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        // resting bodies never sit perfectly still, every box wobbles about
+        // its resting pose by up to half a millimetre and a tenth of a degree
+        srand(1000 + frame);
+        for (size_t i = 0; i < shapes.size(); i++) {
+          glm::vec3 wobble = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 0.001f - 0.0005f;
+          shapes[i]->transform.position = rest[i].position + wobble;
+          shapes[i]->transform.orientation = glm::angleAxis(0.00175f * rand() / RAND_MAX,
+            glm::normalize(glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX - 0.5f + 0.001f)) * rest[i].orientation;
+        }
+
+        vector<ContactManifold> manifolds(STACKS * HEIGHT);
+        BenchTimer timer;
+        for (int s = 0; s < STACKS; s++) {
+          for (int level = 0; level + 1 < HEIGHT; level++) {
+            int i = s * HEIGHT + level;
+            if (method == 0) {
+              collideGjkEpa(*shapes[i], *shapes[i + 1], manifolds[i]);
+            }
+            else {
+              narrowphase(*shapes[i], *shapes[i + 1], manifolds[i]);
+            }
+          }
+        }
+        seconds += timer.seconds();
+
+        for (int s = 0; s < STACKS; s++) {
+          for (int level = 0; level + 1 < HEIGHT; level++) {
+            int i = s * HEIGHT + level;
+            const ContactManifold &manifold = manifolds[i];
+            pairs++;
+            points += manifold.count;
+            if (manifold.count == 0) {
+              missed++;
+              continue;
+            }
+            depthError += fabsf(manifold.depth() - PENETRATION);
+            if (frame > 0 && previous[i].count > 0) {
+              glm::vec3 centroid = glm::vec3(0.0f, 0.0f, 0.0f);
+              glm::vec3 previousCentroid = glm::vec3(0.0f, 0.0f, 0.0f);
+              for (int p = 0; p < manifold.count; p++) {
+                centroid += manifold.points[p].point_b / (float)manifold.count;
+              }
+              for (int p = 0; p < previous[i].count; p++) {
+                previousCentroid += previous[i].points[p].point_b / (float)previous[i].count;
+              }
+              float cosine = glm::clamp(glm::dot(manifold.normal, previous[i].normal), -1.0f, 1.0f);
+              normalJitter += glm::degrees(acosf(cosine));
+              centroidJitter += glm::length(centroid - previousCentroid);
+              compared++;
+            }
+          }
+          for (int level = 0; level + 1 < HEIGHT; level++) {
+            previous[s * HEIGHT + level] = manifolds[s * HEIGHT + level];
+          }
+        }
+      }
+      cout << "  " << setw(8) << (scene == 0 ? "cubes" : "boxes") << setw(16) << methods[method] << fixed
+           << setprecision(1) << setw(10) << seconds * 1e9 / pairs << setprecision(2) << setw(13)
+           << (double)points / pairs << setw(8) << missed << setprecision(4) << setw(18)
+           << normalJitter / compared << setw(19) << centroidJitter * 1000.0 / compared
+           << depthError * 1000.0 / (pairs - missed) << endl;
+    }
+  }
+}
+
+void benchManifoldCache() {
+  const int STACKS = 100;
+  const int HEIGHT = 8;
+  const int FRAMES = 200;
+  const float PENETRATION = 0.005f;
+  const char *scenes[] = {"resting", "sliding"};
+
+  cout << "  " << left << setw(10) << "scene" << setw(16) << "method" << setw(10) << "ms/frame" << setw(11)
+       << "skipped %" << setw(12) << "point hit %" << setw(13) << "points/pair" << "dropped/frame" << endl;
+  for (int scene = 0; scene < 2; scene++) {
+    // The box_stack cube stacks. Resting boxes wobble about their pose like
+    // in box_stack, sliding ones also creep sideways by a millimetre per
+    // level every frame, so the narrowphase has to run again every few
+    // frames and the points slide along their faces.
+    srand(21);
+    ShapeZoo zoo(STACKS * HEIGHT);
+    vector<Shape *> shapes;
+    vector<Transform> rest;
+    vector<glm::vec3> slide;
+    for (int s = 0; s < STACKS; s++) {
+      Transform stack;
+      stack.position = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 100.0f;
+      stack.orientation = randomOrientation();
+      for (int level = 0; level < HEIGHT; level++) {
+        Transform box;
+        box.position = stack.to_world(glm::vec3(0.0f, level * (1.0f - PENETRATION), 0.0f));
+        box.orientation = stack.orientation * glm::angleAxis((float)rand() / RAND_MAX * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+        rest.push_back(box);
+        slide.push_back(stack.to_world_direction(glm::vec3(0.001f * level, 0.0f, 0.0f)));
+        shapes.push_back(zoo.add(SHAPE_CUBE, box.position, box.orientation));
+      }
+    }
+
+    for (int method = 0; method < 2; method++) {
+      ManifoldCache cache;
+      double seconds = 0.0;
+      long long points = 0;
+      long long pairs = 0;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        srand(1000 + frame);
+        // sliding boxes go back and forth over 20cm so they stay on the stack
+        float t = (float)((frame / 100) % 2 == 0 ? frame % 100 : 100 - frame % 100);
+        for (size_t i = 0; i < shapes.size(); i++) {
+          glm::vec3 wobble = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 0.001f - 0.0005f;
+          shapes[i]->transform.position = rest[i].position + wobble + (scene == 1 ? slide[i] * t : glm::vec3(0.0f));
+          shapes[i]->transform.orientation = glm::angleAxis(0.00175f * rand() / RAND_MAX,
+            glm::normalize(glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX - 0.5f + 0.001f)) * rest[i].orientation;
+        }
+
+        BenchTimer timer;
+        cache.next_frame();
+        for (int s = 0; s < STACKS; s++) {
+          for (int level = 0; level + 1 < HEIGHT; level++) {
+            int i = s * HEIGHT + level;
+            ContactManifold manifold;
+            if (method == 0) {
+              narrowphase(*shapes[i], *shapes[i + 1], manifold);
+            }
+            else {
+              cache.collide(*shapes[i], *shapes[i + 1], manifold);
+            }
+            points += manifold.count;
+            pairs++;
+          }
+        }
+        seconds += timer.seconds();
+      }
+      cout << "  " << setw(10) << scenes[scene] << setw(16) << (method == 0 ? "narrowphase" : "manifold cache")
+           << fixed << setprecision(3) << setw(10) << seconds * 1e3 / FRAMES << setprecision(1);
+      if (method == 0) {
+        cout << setw(11) << "-" << setw(12) << "-";
+      }
+      else {
+        cout << setw(11) << cache.skip_rate() * 100.0f << setw(12) << cache.hit_rate() * 100.0f;
+      }
+      cout << setprecision(2) << setw(13) << (double)points / pairs << (double)cache.dropped_points / FRAMES << endl;
+    }
+  }
+}
+
+// Spheres and cubes flying around a box about 2 units per body across,
+// bouncing off its walls, the cubes tumbling. Most bodies touch one or two
+// others at any time. With clustered set, half the bodies crowd into a few
+// small clumps instead, leaving the rest of the box sparse.
+struct BroadphaseScene {
+  vector<Sphere> spheres;
+  vector<Cube> cubes;
+  vector<Shape *> shapes;
+  vector<glm::vec3> velocities;
+  vector<Aabb> boxes;
+  glm::quat spin;
+  float size;
+
+  BroadphaseScene(int count, float spacing = 2.0f, bool clustered = false) : size(spacing * cbrtf((float)count)) {
+    srand(5);
+    spheres.reserve(count);
+    cubes.reserve(count);
+    for (int i = 0; i < count; i++) {
+      glm::vec3 position = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * size;
+      if (clustered && i % 4 < 2) {
+        // 8 clumps a fifth of the box across
+        glm::vec3 clump = glm::vec3((i / 4) % 2, (i / 8) % 2, (i / 16) % 2) * 0.6f + 0.1f;
+        position = (clump + glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 0.2f) * size;
+      }
+      if (i % 2 == 0) {
+        spheres.push_back(Sphere(position, 0.5f));
+        shapes.push_back(&spheres.back());
+      }
+      else {
+        cubes.push_back(Cube(position));
+        cubes.back().transform.orientation = randomOrientation();
+        shapes.push_back(&cubes.back());
+      }
+      // up to 2 units a second
+      velocities.push_back((glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 2.0f - 1.0f) * 1.15f);
+    }
+    spin = glm::angleAxis(0.02f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+    boxes.resize(count);
+    update_boxes();
+  }
+
+  void step(float dt) {
+    for (size_t i = 0; i < shapes.size(); i++) {
+      Transform &transform = shapes[i]->transform;
+      for (int axis = 0; axis < 3; axis++) {
+        if ((transform.position[axis] < 0.0f && velocities[i][axis] < 0.0f)
+            || (transform.position[axis] > size && velocities[i][axis] > 0.0f)) {
+          velocities[i][axis] = -velocities[i][axis];
+        }
+      }
+      transform.position += velocities[i] * dt;
+      if (shapes[i]->type == SHAPE_CUBE) {
+        transform.orientation = spin * transform.orientation;
+      }
+    }
+  }
+
+  void update_boxes() {
+    for (size_t i = 0; i < shapes.size(); i++) {
+      boxes[i] = shapeAabb(*shapes[i]);
+    }
+  }
+};
+
+void benchSweepAndPrune() {
+  const int counts[] = {1000, 10000, 100000};
+  const int FRAMES = 60;
+
+  cout << "  " << left << setw(10) << "bodies" << setw(12) << "aabb ms" << setw(14) << "rebuild ms"
+       << setw(16) << "incremental ms" << setw(14) << "swaps/frame" << setw(10) << "pairs" << setw(15)
+       << "events/frame" << "matches rebuild" << endl;
+  for (int count : counts) {
+    BroadphaseScene scene(count);
+    SweepAndPrune sap;
+    sap.update(scene.boxes);
+    // sorting and sweeping from scratch every frame, for comparison
+    SweepAndPrune fromScratch;
+
+    double aabbSeconds = 0.0;
+    double rebuildSeconds = 0.0;
+    double incrementalSeconds = 0.0;
+    long long swaps = 0;
+    long long events = 0;
+    long long pairs = 0;
+    for (int frame = 0; frame < FRAMES; frame++) {
+      scene.step(1.0f / 60.0f);
+      BenchTimer aabbTimer;
+      scene.update_boxes();
+      aabbSeconds += aabbTimer.seconds();
+
+      BenchTimer incrementalTimer;
+      sap.update(scene.boxes);
+      incrementalSeconds += incrementalTimer.seconds();
+      swaps += sap.swaps;
+      events += sap.added.size() + sap.removed.size();
+      pairs += sap.pair_count();
+
+      BenchTimer rebuildTimer;
+      fromScratch.rebuild(scene.boxes);
+      rebuildSeconds += rebuildTimer.seconds();
+    }
+
+    vector<BroadphasePair> incrementalPairs, rebuiltPairs;
+    sap.pairs(incrementalPairs);
+    fromScratch.pairs(rebuiltPairs);
+    cout << "  " << setw(10) << count << fixed << setprecision(3) << setw(12) << aabbSeconds * 1e3 / FRAMES
+         << setw(14) << rebuildSeconds * 1e3 / FRAMES << setw(16) << incrementalSeconds * 1e3 / FRAMES
+         << setprecision(0) << setw(14) << (double)swaps / FRAMES << setw(10) << (double)pairs / FRAMES
+         << setprecision(1) << setw(15) << (double)events / FRAMES
+         << (incrementalPairs == rebuiltPairs ? "yes" : "NO") << endl;
+  }
+}
+
+void benchDynamicTree() {
+  const int counts[] = {1000, 10000, 100000};
+  const int FRAMES = 30;
+  const int RAYS = 100000;
+
+  cout << "  " << left << setw(11) << "scene" << setw(9) << "bodies" << setw(10) << "build ms" << setw(11)
+       << "update ms" << setw(15) << "reinserts/frm" << setw(9) << "sap ms" << setw(13) << "matches sap"
+       << setw(13) << "queries/s" << setw(12) << "rays/s" << setw(8) << "height" << "area ratio" << endl;
+  for (int clustered = 0; clustered < 2; clustered++) {
+    for (int count : counts) {
+      BroadphaseScene scene(count, 2.0f, clustered != 0);
+      DynamicTree tree;
+      SweepAndPrune sap;
+      BenchTimer buildTimer;
+      tree.update(scene.boxes);
+      double buildSeconds = buildTimer.seconds();
+      sap.update(scene.boxes);
+
+      double treeSeconds = 0.0;
+      double sapSeconds = 0.0;
+      long long reinserted = 0;
+      bool matches = true;
+      vector<BroadphasePair> treePairs, sapPairs;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        scene.step(1.0f / 60.0f);
+        scene.update_boxes();
+        BenchTimer treeTimer;
+        tree.update(scene.boxes);
+        treeSeconds += treeTimer.seconds();
+        reinserted += tree.reinserted;
+        BenchTimer sapTimer;
+        sap.update(scene.boxes);
+        sapSeconds += sapTimer.seconds();
+        tree.pairs(treePairs);
+        sap.pairs(sapPairs);
+        matches = matches && treePairs == sapPairs;
+      }
+
+      // every body's box against the tree
+      long long found = 0;
+      BenchTimer queryTimer;
+      for (const Aabb &box : scene.boxes) {
+        tree.query(box, [&](int) { found++; });
+      }
+      double querySeconds = queryTimer.seconds();
+
+      // rays from random points in the box in random directions, nearest box
+      vector<glm::vec3> directions = randomDirections(RAYS);
+      srand(9);
+      long long hits = 0;
+      BenchTimer rayTimer;
+      for (int r = 0; r < RAYS; r++) {
+        glm::vec3 origin = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * scene.size;
+        glm::vec3 inverseDirection = 1.0f / directions[r];
+        int nearest = -1;
+        tree.raycast(origin, directions[r], scene.size, [&](int body, float maxDistance) {
+          float entry;
+          if (rayAabb(scene.boxes[body], origin, inverseDirection, maxDistance, &entry)) {
+            nearest = body;
+            return entry;
+          }
+          return maxDistance;
+        });
+        hits += (nearest != -1);
+      }
+      double raySeconds = rayTimer.seconds();
+      benchSink = (int)(found + hits);
+
+      cout << "  " << setw(11) << (clustered ? "clustered" : "uniform") << setw(9) << count << fixed
+           << setprecision(2) << setw(10) << buildSeconds * 1e3 << setw(11) << treeSeconds * 1e3 / FRAMES
+           << setprecision(0) << setw(15) << (double)reinserted / FRAMES << setprecision(2) << setw(9)
+           << sapSeconds * 1e3 / FRAMES << setw(13) << (matches ? "yes" : "NO") << setprecision(2)
+           << setw(13) << scientific << count / querySeconds << setw(12) << RAYS / raySeconds << fixed
+           << setw(8) << tree.height() << setprecision(1) << tree.area_ratio() << endl;
+    }
+  }
+}
+
+void benchSpatialGrid() {
+  const int FRAMES = 10;
+  int hardwareThreads = max(1, (int)thread::hardware_concurrency());
+
+  // every broadphase picked by type at runtime, on the same 100k body scene
+  {
+    const int COUNT = 100000;
+    ThreadPool pool(hardwareThreads);
+    cout << "  " << COUNT << " bodies, " << pool.size() << " threads" << endl;
+    cout << "  " << left << setw(8) << "type" << setw(12) << "ms/frame" << setw(10) << "pairs" << "matches sap"
+         << endl;
+    vector<BroadphasePair> reference;
+    for (int type = 0; type < BROADPHASE_TYPE_COUNT; type++) {
+      BroadphaseScene moving(COUNT);
+      Broadphase *broadphase = createBroadphase((BroadphaseType)type, pool);
+      broadphase->update(moving.boxes);
+      double seconds = 0.0;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        moving.step(1.0f / 60.0f);
+        moving.update_boxes();
+        BenchTimer timer;
+        broadphase->update(moving.boxes);
+        seconds += timer.seconds();
+      }
+      vector<BroadphasePair> found;
+      broadphase->pairs(found);
+      if (type == BROADPHASE_SAP) {
+        reference = found;
+      }
+      cout << "  " << setw(8) << broadphase->name() << fixed << setprecision(2) << setw(12)
+           << seconds * 1e3 / FRAMES << setw(10) << found.size() << (found == reference ? "yes" : "NO") << endl;
+      delete broadphase;
+    }
+  }
+
+  // a million small bodies through the grid, per thread count and cell size.
+  // The frames are moved once up front and replayed for every setting.
+  {
+    const int COUNT = 1000000;
+    const int GRID_FRAMES = 5;
+    vector<vector<Aabb>> frames;
+    {
+      BroadphaseScene scene(COUNT);
+      frames.push_back(scene.boxes);
+      for (int frame = 0; frame < GRID_FRAMES; frame++) {
+        scene.step(1.0f / 60.0f);
+        scene.update_boxes();
+        frames.push_back(scene.boxes);
+      }
+    }
+    const float cellSizes[] = {1.0f, 2.0f, 4.0f};
+    vector<int> threadCounts;
+    for (int threads = 1; threads <= max(16, hardwareThreads); threads *= 2) {
+      threadCounts.push_back(threads);
+    }
+    cout << endl << "  " << COUNT << " bodies, " << hardwareThreads << " hardware threads" << endl;
+    cout << "  " << setw(10) << "threads" << setw(11) << "cell size" << setw(12) << "ms/frame" << setw(14)
+         << "entries/body" << setw(10) << "pairs" << setw(14) << "events/frame" << "same pairs" << endl;
+    for (float cellSize : cellSizes) {
+      vector<BroadphasePair> reference;
+      for (int threads : threadCounts) {
+        ThreadPool pool(threads);
+        SpatialGrid grid(pool, cellSize);
+        grid.update(frames[0]);
+        double seconds = 0.0;
+        long long events = 0;
+        for (int frame = 1; frame <= GRID_FRAMES; frame++) {
+          BenchTimer timer;
+          grid.update(frames[frame]);
+          seconds += timer.seconds();
+          events += grid.added.size() + grid.removed.size();
+        }
+        vector<BroadphasePair> found;
+        grid.pairs(found);
+        if (reference.empty()) {
+          reference = found;
+        }
+        cout << "  " << setw(10) << threads << setprecision(1) << setw(11) << cellSize << setprecision(2)
+             << setw(12) << seconds * 1e3 / GRID_FRAMES << setw(14) << (double)grid.entry_count() / COUNT
+             << setw(10) << found.size() << setprecision(0) << setw(14) << (double)events / GRID_FRAMES
+             << (found == reference ? "yes" : "NO") << endl;
+      }
+    }
+  }
+}
+
+void benchContactSolver() {
+  const int STACKS = 25;
+  const int HEIGHT = 10;
+  const int FRAMES = 600;
+  const float DT = 1.0f / 60.0f;
+  // a stack counts as settled once no box moves faster than this
+  const float SETTLED_SPEED = 0.05f;
+  const int iterationCounts[] = {4, 10, 20, 40};
+  // warm starting and normal passes, one pass only warm started, cold
+  // stacks fall with any
+  const int modeWarm[] = {0, 1, 1};
+  const int modePasses[] = {CONTACT_NORMAL_PASSES, 1, CONTACT_NORMAL_PASSES};
+
+  cout << "  " << STACKS << " stacks of " << HEIGHT << " cubes, " << FRAMES << " steps of " << fixed
+       << setprecision(4) << DT << "s" << endl;
+  cout << "  " << left << setw(12) << "warm start" << setw(8) << "passes" << setw(12) << "iterations" << setw(14)
+       << "solver ms" << setw(12) << "step ms" << setw(13) << "settled at s" << setw(10) << "sag mm" << setw(10)
+       << "drift mm" << "fallen" << endl;
+  for (int mode = 0; mode < 3; mode++) {
+    int warm = modeWarm[mode];
+    for (int iterations : iterationCounts) {
+      // 5 by 5 stacks on a static ground slab, every cube shifted and turned
+      // a little on the one below and sunk into it by the slop, so the
+      // contacts are there from the first step
+      srand(20);
+      World world;
+      world.allow_sleep = false;
+      world.solver.iterations = iterations;
+      world.solver.normal_passes = modePasses[mode];
+      world.solver.warm_starting = warm == 1;
+      Box ground(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(20.0f, 0.5f, 20.0f));
+      world.add_body(&ground, 0.0f);
+      vector<Cube> cubes;
+      cubes.reserve(STACKS * HEIGHT);
+      vector<BodyHandle> tops;
+      vector<glm::vec3> topStart;
+      for (int s = 0; s < STACKS; s++) {
+        glm::vec3 base = glm::vec3((s % 5 - 2) * 3.0f, 0.0f, (s / 5 - 2) * 3.0f);
+        for (int level = 0; level < HEIGHT; level++) {
+          glm::vec3 shift = glm::vec3(rand() - RAND_MAX / 2, 0, rand() - RAND_MAX / 2) / (float)RAND_MAX * 0.04f;
+          float y = 0.5f - CONTACT_SLOP + level * (1.0f - CONTACT_SLOP);
+          cubes.push_back(Cube(base + glm::vec3(0.0f, y, 0.0f) + shift));
+          cubes.back().transform.orientation = glm::angleAxis(((float)rand() / RAND_MAX - 0.5f) * 0.1f,
+                                                              glm::vec3(0.0f, 1.0f, 0.0f));
+          BodyHandle body = world.add_body(&cubes.back(), 1.0f);
+          if (level == HEIGHT - 1) {
+            tops.push_back(body);
+            topStart.push_back(cubes.back().transform.position);
+          }
+        }
+      }
+
+      double solverSeconds = 0.0;
+      double stepSeconds = 0.0;
+      int lastMoving = -1;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        BenchTimer timer;
+        world.step(DT);
+        stepSeconds += timer.seconds();
+        solverSeconds += world.stats.solver_seconds;
+        float fastest = 0.0f;
+        for (glm::vec3 velocity : world.bodies.linear_velocities) {
+          fastest = max(fastest, glm::length(velocity));
+        }
+        if (fastest > SETTLED_SPEED) {
+          lastMoving = frame;
+        }
+      }
+
+      double sag = 0.0;
+      double drift = 0.0;
+      int fallen = 0;
+      for (int s = 0; s < STACKS; s++) {
+        glm::vec3 top = world.bodies.positions[world.bodies.index(tops[s])];
+        glm::vec3 moved = top - topStart[s];
+        if (top.y < topStart[s].y - 0.5f) {
+          fallen++;
+          continue;
+        }
+        sag -= moved.y;
+        drift += glm::length(glm::vec2(moved.x, moved.z));
+      }
+      int standing = max(STACKS - fallen, 1);
+      string settled = lastMoving == FRAMES - 1 ? "never" : to_string((lastMoving + 1) * DT).substr(0, 4);
+      cout << "  " << setw(12) << (warm ? "yes" : "no") << setw(8) << modePasses[mode] << setw(12) << iterations
+           << setprecision(3) << setw(14)
+           << solverSeconds * 1e3 / FRAMES << setw(12) << stepSeconds * 1e3 / FRAMES << setw(13) << settled
+           << setprecision(2) << setw(10) << sag * 1e3 / standing << setw(10) << drift * 1e3 / standing << fallen
+           << endl;
+    }
+  }
+
+  // Short straight stacks from a cold start, what warm_starting = false is
+  // expected to hold at 40 iterations, with one pass over the normals and
+  // with the default
+  cout << "  single straight stacks without warm starting, 40 iterations, 300 steps" << endl;
+  cout << "  " << left << setw(10) << "cubes" << setw(12) << "friction" << setw(8) << "passes" << setw(16)
+       << "fastest m/s" << setw(16) << "spin rad/s" << "top moved mm" << endl;
+  const int heights[] = {3, 3, 5, 5, 5, 5};
+  const float frictions[] = {0.5f, 0.5f, 0.5f, 0.5f, 0.0f, 0.0f};
+  const int passes[] = {1, CONTACT_NORMAL_PASSES, 1, CONTACT_NORMAL_PASSES, 1, CONTACT_NORMAL_PASSES};
+  for (int c = 0; c < 6; c++) {
+    World world;
+    world.allow_sleep = false;
+    world.solver.iterations = 40;
+    world.solver.normal_passes = passes[c];
+    world.solver.warm_starting = false;
+    Box ground(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(5.0f, 0.5f, 5.0f));
+    world.add_body(&ground, 0.0f);
+    vector<Cube> cubes;
+    cubes.reserve(heights[c]);
+    for (int level = 0; level < heights[c]; level++) {
+      cubes.push_back(Cube(glm::vec3(0.0f, 0.5f - CONTACT_SLOP + level * (1.0f - CONTACT_SLOP), 0.0f)));
+      world.add_body(&cubes.back(), 1.0f);
+    }
+    for (float &friction : world.bodies.frictions) {
+      friction = frictions[c];
+    }
+    glm::vec3 start = world.bodies.positions[heights[c]];
+    for (int frame = 0; frame < 300; frame++) {
+      world.step(DT);
+    }
+    float fastest = 0.0f;
+    float spin = 0.0f;
+    for (int i = 1; i <= heights[c]; i++) {
+      fastest = max(fastest, glm::length(world.bodies.linear_velocities[i]));
+      spin = max(spin, glm::length(world.bodies.angular_velocities[i]));
+    }
+    cout << "  " << setw(10) << heights[c] << setprecision(1) << setw(12) << frictions[c] << setw(8) << passes[c]
+         << setprecision(4) << setw(16) << fastest << setw(16) << spin << setprecision(2)
+         << glm::length(world.bodies.positions[heights[c]] - start) * 1e3 << endl;
+  }
+}
+
+void benchContactBatches() {
+  const int SIDE = 20;
+  const int LAYERS = 25;
+  const int FRAMES = 10;
+  const float DT = 1.0f / 60.0f;
+  SupportPath best = detectSupportPath();
+  const SupportPath paths[] = {SUPPORT_SCALAR, SUPPORT_SSE, SUPPORT_AVX2};
+
+  cout << "  " << SIDE * SIDE * LAYERS << " cubes in a " << SIDE << " x " << LAYERS << " x " << SIDE
+       << " pile, " << FRAMES << " steps, " << CONTACT_SOLVER_ITERATIONS << " iterations, this CPU runs up to "
+       << supportPathName(best) << endl;
+  cout << "  " << left << setw(10) << "path" << setw(14) << "constraints" << setw(11) << "batches" << setw(12)
+       << "batched %" << setw(16) << "us/iteration" << setw(10) << "speedup" << "fastest m/s" << endl;
+  double scalarSeconds = 0.0;
+  for (SupportPath path : paths) {
+    if (path > best) {
+      cout << "  " << setw(10) << supportPathName(path) << "-" << endl;
+      continue;
+    }
+    // cubes on a grid a slop closer than touching, so every cube pushes on
+    // up to 6 neighbours from the first step
+    World world;
+    world.solver.simd_path = path;
+    Box ground(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(SIDE + 5.0f, 0.5f, SIDE + 5.0f));
+    world.add_body(&ground, 0.0f);
+    vector<Cube> cubes;
+    cubes.reserve(SIDE * SIDE * LAYERS);
+    float step = 1.0f - CONTACT_SLOP;
+    for (int y = 0; y < LAYERS; y++) {
+      for (int z = 0; z < SIDE; z++) {
+        for (int x = 0; x < SIDE; x++) {
+          glm::vec3 position = glm::vec3((x - SIDE / 2) * step, 0.5f - CONTACT_SLOP + y * step, (z - SIDE / 2) * step);
+          cubes.push_back(Cube(position));
+          world.add_body(&cubes.back(), 1.0f);
+        }
+      }
+    }
+
+    double solverSeconds = 0.0;
+    double constraints = 0.0;
+    double batched = 0.0;
+    double batches = 0.0;
+    for (int frame = 0; frame < FRAMES; frame++) {
+      world.step(DT);
+      solverSeconds += world.stats.solver_seconds;
+      constraints += world.solver.constraints.size();
+      batches += world.solver.batches.size();
+      batched += world.solver.constraints.size() - world.solver.remainder.size();
+    }
+    float fastest = 0.0f;
+    for (glm::vec3 velocity : world.bodies.linear_velocities) {
+      fastest = max(fastest, glm::length(velocity));
+    }
+    if (path == SUPPORT_SCALAR) {
+      scalarSeconds = solverSeconds;
+      batched = 0.0;
+      batches = 0.0;
+    }
+    double perIteration = solverSeconds * 1e6 / FRAMES / CONTACT_SOLVER_ITERATIONS;
+    cout << "  " << setw(10) << supportPathName(path) << fixed << setprecision(0) << setw(14)
+         << constraints / FRAMES << setw(11) << batches / FRAMES << setprecision(1) << setw(12)
+         << batched * 100.0 / constraints << setw(16) << perIteration << setprecision(2) << setw(10)
+         << scalarSeconds / solverSeconds << setprecision(3) << fastest << endl;
+  }
+}
+
+void benchContactColors() {
+  const int SIDE = 20;
+  const int HEIGHT = 20;
+  const int FRAMES = 60;
+  const float DT = 1.0f / 60.0f;
+  const int threadCounts[] = {1, 2, 4, 8, 16};
+
+  cout << "  " << SIDE * SIDE << " stacks of " << HEIGHT << " cubes, grid broadphase, " << FRAMES << " steps, "
+       << supportPathName(activeSupportPath()) << " batches, " << thread::hardware_concurrency()
+       << " hardware threads" << endl;
+  cout << "  " << left << setw(15) << "deterministic" << setw(10) << "threads" << setw(10) << "colours" << setw(11)
+       << "overflow" << setw(12) << "solver ms" << setw(10) << "speedup" << "same as 1 thread" << endl;
+  for (int deterministic = 0; deterministic < 2; deterministic++) {
+    double oneThread = 0.0;
+    vector<glm::vec3> onePositions;
+    for (int threads : threadCounts) {
+      // stacks 2 apart, so only cubes of a stack touch and the stacks are
+      // independent of each other
+      World world(BROADPHASE_GRID, threads);
+      world.solver.deterministic = deterministic == 1;
+      world.solve_islands = false;
+      world.allow_sleep = false;
+      Box ground(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(SIDE * 2.0f, 0.5f, SIDE * 2.0f));
+      world.add_body(&ground, 0.0f);
+      vector<Cube> cubes;
+      cubes.reserve(SIDE * SIDE * HEIGHT);
+      srand(23);
+      for (int s = 0; s < SIDE * SIDE; s++) {
+        glm::vec3 base = glm::vec3((s % SIDE - SIDE / 2) * 2.0f, 0.0f, (s / SIDE - SIDE / 2) * 2.0f);
+        for (int level = 0; level < HEIGHT; level++) {
+          glm::vec3 shift = glm::vec3(rand() - RAND_MAX / 2, 0, rand() - RAND_MAX / 2) / (float)RAND_MAX * 0.02f;
+          float y = 0.5f - CONTACT_SLOP + level * (1.0f - CONTACT_SLOP);
+          cubes.push_back(Cube(base + glm::vec3(0.0f, y, 0.0f) + shift));
+          world.add_body(&cubes.back(), 1.0f);
+        }
+      }
+
+      double solverSeconds = 0.0;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        world.step(DT);
+        solverSeconds += world.stats.solver_seconds;
+      }
+      if (threads == 1) {
+        oneThread = solverSeconds;
+        onePositions = world.bodies.positions;
+      }
+      bool same = world.bodies.positions == onePositions;
+      int overflow = (int)world.solver.remainder.size() - world.solver.overflow_begin;
+      cout << "  " << setw(15) << (deterministic ? "yes" : "no") << setw(10) << threads << setw(10)
+           << world.solver.colors.size() << setw(11) << overflow << fixed << setprecision(3) << setw(12)
+           << solverSeconds * 1e3 / FRAMES << setprecision(2) << setw(10) << oneThread / solverSeconds
+           << (same ? "yes" : "no") << endl;
+    }
+  }
+}
+
+void benchIslands() {
+  const int SIDE = 20;
+  const int PILE = 12;
+  const int PILE_HEIGHT = 8;
+  const int FRAMES = 60;
+  const float DT = 1.0f / 60.0f;
+  const int threadCounts[] = {1, 2, 4, 8, 16};
+
+  cout << "  " << SIDE * SIDE << " stacks of 1 to 30 cubes, a " << PILE << "x" << PILE << "x" << PILE_HEIGHT
+       << " pile and cubes dropped onto the stacks, " << FRAMES << " steps, " << thread::hardware_concurrency()
+       << " hardware threads" << endl;
+  cout << "  " << left << setw(12) << "solve" << setw(10) << "threads" << setw(10) << "islands" << setw(10)
+       << "largest" << setw(12) << "island ms" << setw(10) << "resplit" << setw(12) << "solver ms" << "speedup"
+       << endl;
+  for (int byIsland = 1; byIsland >= 0; byIsland--) {
+    double oneThread = 0.0;
+    WorldStats last;
+    for (int threads : threadCounts) {
+      World world(BROADPHASE_GRID, threads);
+      world.solve_islands = byIsland == 1;
+      world.allow_sleep = false;
+      Box ground(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(SIDE * 2.0f + PILE * 2.0f, 0.5f, SIDE * 2.0f));
+      world.add_body(&ground, 0.0f);
+      vector<Cube> cubes;
+      cubes.reserve(SIDE * SIDE * 30 + PILE * PILE * PILE_HEIGHT + SIDE * SIDE);
+      srand(24);
+      for (int s = 0; s < SIDE * SIDE; s++) {
+        glm::vec3 base = glm::vec3((s % SIDE - SIDE / 2) * 2.0f, 0.0f, (s / SIDE - SIDE / 2) * 2.0f);
+        int height = 1 + rand() % 30;
+        for (int level = 0; level < height; level++) {
+          float y = 0.5f - CONTACT_SLOP + level * (1.0f - CONTACT_SLOP);
+          cubes.push_back(Cube(base + glm::vec3(0.0f, y, 0.0f)));
+          world.add_body(&cubes.back(), 1.0f);
+        }
+        // every fourth stack gets a cube dropped on it, which joins its
+        // island when it lands and may knock it apart
+        if (s % 4 == 0) {
+          float y = height + 2.0f + (rand() % 100) * 0.05f;
+          cubes.push_back(Cube(base + glm::vec3(0.3f, y, 0.0f)));
+          world.add_body(&cubes.back(), 1.0f);
+        }
+      }
+      // one island too big for a single task, next to the stacks
+      glm::vec3 corner = glm::vec3(SIDE + 1.0f, 0.0f, -PILE / 2.0f);
+      for (int level = 0; level < PILE_HEIGHT; level++) {
+        for (int x = 0; x < PILE; x++) {
+          for (int z = 0; z < PILE; z++) {
+            float y = 0.5f - CONTACT_SLOP + level * (1.0f - CONTACT_SLOP);
+            cubes.push_back(Cube(corner + glm::vec3(x * (1.0f - CONTACT_SLOP), y, z * (1.0f - CONTACT_SLOP))));
+            world.add_body(&cubes.back(), 1.0f);
+          }
+        }
+      }
+
+      double solverSeconds = 0.0;
+      double islandSeconds = 0.0;
+      int resplit = 0;
+      for (int frame = 0; frame < FRAMES; frame++) {
+        world.step(DT);
+        solverSeconds += world.stats.solver_seconds;
+        islandSeconds += world.stats.island_seconds;
+        resplit += world.stats.resplit_bodies;
+      }
+      if (threads == 1) {
+        oneThread = solverSeconds;
+      }
+      last = world.stats;
+      cout << "  " << setw(12) << (byIsland ? "by island" : "together") << setw(10) << threads << setw(10)
+           << world.stats.islands << setw(10) << world.stats.largest_island << fixed << setprecision(3) << setw(12)
+           << islandSeconds * 1e3 / FRAMES << setw(10) << resplit / FRAMES << setw(12) << solverSeconds * 1e3 / FRAMES
+           << setprecision(2) << oneThread / solverSeconds << endl;
+    }
+    if (byIsland) {
+      cout << "  islands by bodies:";
+      for (int bucket = 0; bucket < ISLAND_HISTOGRAM_BUCKETS; bucket++) {
+        if (last.island_histogram[bucket] > 0) {
+          cout << " " << (1 << bucket) << "+: " << last.island_histogram[bucket];
+        }
+      }
+      cout << endl;
+    }
+  }
+}
+
+void benchSleeping() {
+  const int SIDE = 20;
+  const int HEIGHT = 5;
+  const int DROPPED = 100;
+  const int WARMUP = 120;
+  const int FRAMES = 300;
+  const float DT = 1.0f / 60.0f;
+
+  cout << "  " << SIDE * SIDE << " resting stacks of " << HEIGHT << " cubes and " << DROPPED
+       << " cubes dropped again beside them whenever they fall asleep, " << FRAMES << " steps after " << WARMUP
+       << endl;
+  cout << "  " << left << setw(8) << "sleep" << setw(9) << "awake" << setw(12) << "step ms" << setw(14)
+       << "broadphase ms" << setw(15) << "narrowphase ms" << setw(12) << "island ms" << setw(12) << "solver ms"
+       << setw(15) << "integrate ms" << setw(10) << "speedup" << "tops moved" << endl;
+  double awakeStep = 0.0;
+  for (int sleep = 0; sleep < 2; sleep++) {
+    World world;
+    world.allow_sleep = sleep == 1;
+    Box ground(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(SIDE * 2.0f + 20.0f, 0.5f, SIDE * 2.0f));
+    world.add_body(&ground, 0.0f);
+    vector<Cube> cubes;
+    cubes.reserve(SIDE * SIDE * HEIGHT + DROPPED);
+    vector<BodyHandle> tops;
+    vector<glm::vec3> topStart;
+    for (int s = 0; s < SIDE * SIDE; s++) {
+      glm::vec3 base = glm::vec3((s % SIDE - SIDE / 2) * 2.0f, 0.0f, (s / SIDE - SIDE / 2) * 2.0f);
+      for (int level = 0; level < HEIGHT; level++) {
+        float y = 0.5f - CONTACT_SLOP + level * (1.0f - CONTACT_SLOP);
+        cubes.push_back(Cube(base + glm::vec3(0.0f, y, 0.0f)));
+        BodyHandle body = world.add_body(&cubes.back(), 1.0f);
+        if (level == HEIGHT - 1) {
+          tops.push_back(body);
+          topStart.push_back(cubes.back().transform.position);
+        }
+      }
+    }
+    // the dropped cubes land on a patch of ground of their own, so they
+    // never wake the stacks
+    srand(25);
+    vector<BodyHandle> dropped;
+    vector<Cube *> droppedCubes;
+    vector<glm::vec3> drops;
+    for (int i = 0; i < DROPPED; i++) {
+      glm::vec3 drop = glm::vec3(SIDE + 2.0f + (i % 10) * 1.5f, 2.0f + (rand() % 100) * 0.03f,
+                                 (i / 10 - 5) * 1.5f);
+      cubes.push_back(Cube(drop));
+      dropped.push_back(world.add_body(&cubes.back(), 1.0f));
+      droppedCubes.push_back(&cubes.back());
+      drops.push_back(drop);
+    }
+
+    double stepSeconds = 0.0;
+    double broadphaseSeconds = 0.0;
+    double narrowphaseSeconds = 0.0;
+    double islandSeconds = 0.0;
+    double solverSeconds = 0.0;
+    double integrateSeconds = 0.0;
+    long long awake = 0;
+    for (int frame = 0; frame < WARMUP + FRAMES; frame++) {
+      // a fallen asleep cube is put back up and woken
+      for (int i = 0; i < DROPPED; i++) {
+        if (world.is_sleeping(dropped[i])) {
+          int index = world.bodies.index(dropped[i]);
+          world.bodies.positions[index] = drops[i];
+          droppedCubes[i]->transform.position = drops[i];
+          world.wake_body(dropped[i]);
+        }
+      }
+      BenchTimer timer;
+      world.step(DT);
+      if (frame < WARMUP) {
+        continue;
+      }
+      stepSeconds += timer.seconds();
+      broadphaseSeconds += world.stats.broadphase_seconds;
+      narrowphaseSeconds += world.stats.narrowphase_seconds;
+      islandSeconds += world.stats.island_seconds;
+      solverSeconds += world.stats.solver_seconds;
+      integrateSeconds += world.stats.integrate_seconds;
+      awake += world.stats.awake_bodies;
+    }
+    int moved = 0;
+    for (int s = 0; s < SIDE * SIDE; s++) {
+      glm::vec3 top = world.bodies.positions[world.bodies.index(tops[s])];
+      if (glm::length(top - topStart[s]) > 0.01f) {
+        moved++;
+      }
+    }
+    if (sleep == 0) {
+      awakeStep = stepSeconds;
+    }
+    cout << "  " << setw(8) << (sleep ? "yes" : "no") << setw(9) << awake / FRAMES << fixed << setprecision(3)
+         << setw(12) << stepSeconds * 1e3 / FRAMES << setw(14) << broadphaseSeconds * 1e3 / FRAMES << setw(15)
+         << narrowphaseSeconds * 1e3 / FRAMES << setw(12) << islandSeconds * 1e3 / FRAMES << setw(12)
+         << solverSeconds * 1e3 / FRAMES << setw(15) << integrateSeconds * 1e3 / FRAMES << setprecision(2)
+         << setw(10) << awakeStep / stepSeconds << moved << endl;
+  }
+}
+
+// A body laid out the way RigidBodyStorage replaced: one object per body
+// with its fields side by side, and the pose in the shape it points to
+struct ObjectBody {
+  Shape *shape;
+  glm::vec3 linear_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 angular_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 push_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 turn_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+  float inverse_mass;
+  glm::vec3 local_inverse_inertia;
+  glm::mat3 inverse_inertia = glm::mat3(0.0f);
+  float friction = 0.5f;
+
+  ObjectBody(Shape *bodyShape, float mass)
+      : shape(bodyShape), inverse_mass(1.0f / mass), local_inverse_inertia(1.0f / shapeInertia(*bodyShape, mass)) {}
+
+  bool is_static() const {
+    return inverse_mass == 0.0f;
+  }
+
+  void update_inertia() {
+    glm::mat3 rotation = glm::mat3_cast(shape->transform.orientation);
+    inverse_inertia = rotation * glm::mat3(local_inverse_inertia.x, 0.0f, 0.0f,
+                                           0.0f, local_inverse_inertia.y, 0.0f,
+                                           0.0f, 0.0f, local_inverse_inertia.z) * glm::transpose(rotation);
+  }
+
+  void integrate_velocity(glm::vec3 gravity, float dt) {
+    if (!is_static()) {
+      linear_velocity += gravity * dt;
+    }
+  }
+
+  void integrate_position(float dt) {
+    if (is_static()) {
+      return;
+    }
+    Transform &transform = shape->transform;
+    transform.position += (linear_velocity + push_velocity) * dt;
+    glm::vec3 turn = angular_velocity + turn_velocity;
+    glm::quat spin = glm::quat(0.0f, turn.x, turn.y, turn.z);
+    transform.orientation = glm::normalize(transform.orientation + 0.5f * dt * (spin * transform.orientation));
+    push_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+    turn_velocity = glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+};
+
+void benchIntegration() {
+  const int BODIES = 100000;
+  const int FRAMES = 50;
+  const float DT = 1.0f / 60.0f;
+  const glm::vec3 GRAVITY = glm::vec3(0.0f, -9.81f, 0.0f);
+
+  // the broadphase scene's spheres and cubes, every 20th body static
+  BroadphaseScene scene(BODIES);
+  vector<ObjectBody> objects;
+  objects.reserve(BODIES);
+  RigidBodyStorage storage;
+  srand(21);
+  for (int i = 0; i < BODIES; i++) {
+    float mass = i % 20 == 0 ? 0.0f : 1.0f;
+    glm::vec3 velocity = mass > 0.0f ? scene.velocities[i] : glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 spin = mass > 0.0f ? glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 2.0f - 1.0f
+                                 : glm::vec3(0.0f, 0.0f, 0.0f);
+    objects.push_back(ObjectBody(scene.shapes[i], 1.0f));
+    objects.back().inverse_mass = mass > 0.0f ? 1.0f : 0.0f;
+    objects.back().linear_velocity = velocity;
+    objects.back().angular_velocity = spin;
+    int index = storage.index(storage.add(scene.shapes[i], mass));
+    storage.linear_velocities[index] = velocity;
+    storage.angular_velocities[index] = spin;
+  }
+  vector<Transform> start(BODIES);
+  for (int i = 0; i < BODIES; i++) {
+    start[i] = scene.shapes[i]->transform;
+  }
+
+  // velocity, inertia, position, and for the storage copying the poses out
+  double seconds[2][4] = {{0.0}};
+  for (int frame = 0; frame < FRAMES; frame++) {
+    BenchTimer velocityTimer;
+    for (ObjectBody &body : objects) {
+      body.integrate_velocity(GRAVITY, DT);
+    }
+    seconds[0][0] += velocityTimer.seconds();
+    BenchTimer inertiaTimer;
+    for (ObjectBody &body : objects) {
+      if (!body.is_static()) {
+        body.update_inertia();
+      }
+    }
+    seconds[0][1] += inertiaTimer.seconds();
+    BenchTimer positionTimer;
+    for (ObjectBody &body : objects) {
+      body.integrate_position(DT);
+    }
+    seconds[0][2] += positionTimer.seconds();
+  }
+  vector<Transform> objectEnd(BODIES);
+  for (int i = 0; i < BODIES; i++) {
+    objectEnd[i] = scene.shapes[i]->transform;
+    scene.shapes[i]->transform = start[i];
+  }
+
+  for (int frame = 0; frame < FRAMES; frame++) {
+    BenchTimer velocityTimer;
+    storage.integrate_velocities(GRAVITY, DT);
+    seconds[1][0] += velocityTimer.seconds();
+    BenchTimer inertiaTimer;
+    storage.update_inertia();
+    seconds[1][1] += inertiaTimer.seconds();
+    BenchTimer positionTimer;
+    storage.integrate_positions(DT);
+    seconds[1][2] += positionTimer.seconds();
+    BenchTimer writeTimer;
+    storage.write_transforms();
+    seconds[1][3] += writeTimer.seconds();
+  }
+
+  float worst = 0.0f;
+  for (int i = 0; i < BODIES; i++) {
+    worst = max(worst, glm::length(objectEnd[i].position - storage.positions[i]));
+  }
+  double steps = (double)BODIES * FRAMES;
+  cout << "  " << BODIES << " bodies, " << FRAMES << " steps, ns per body" << endl;
+  cout << "  " << left << setw(10) << "layout" << setw(12) << "velocity" << setw(12) << "inertia" << setw(12)
+       << "position" << setw(12) << "to shapes" << "total" << endl;
+  const char *names[] = {"objects", "arrays"};
+  for (int layout = 0; layout < 2; layout++) {
+    double total = seconds[layout][0] + seconds[layout][1] + seconds[layout][2] + seconds[layout][3];
+    cout << "  " << setw(10) << names[layout] << fixed << setprecision(2);
+    for (int phase = 0; phase < 4; phase++) {
+      cout << setw(12) << seconds[layout][phase] * 1e9 / steps;
+    }
+    cout << total * 1e9 / steps << endl;
+  }
+  cout << "  positions agree to " << scientific << setprecision(1) << worst << fixed << " m" << endl;
+}
+
+struct Benchmark {
+  const char *name;
+  const char *description;
+  void (*run)();
+};
+
+Benchmark benchmarks[] = {
+  {"gjk_copies", "GJK tetrahedron vs cube, shapes passed by value vs const reference", benchGjkCopies},
+  {"support_hull", "Support queries over the world and model space triangle soup vs the welded convex hull", benchSupportHull},
+  {"support_hill_climb", "Per-query support cost against hull size, linear scan vs hill climbing", benchSupportHillClimb},
+  {"support_simd", "Linear support scan over 8 to 1024 vertex hulls, scalar vs SSE vs AVX2 over SoA vertex blocks", benchSupportSimd},
+  {"geometry_memory", "Memory per body with shared, reference counted geometry", benchGeometryMemory},
+  {"gjk_allocations", "Heap allocations per GJK query, vector simplex vs fixed capacity Simplex", benchGjkAllocations},
+  {"gjk_stress", "Per-frame GJK over drifting tetrahedron/cube pairs, per-iteration averages vs cached centroids and separating axes", benchGjkStress},
+  {"gjk_distance", "GJK distance accuracy on known cube offsets and throughput on the stress scene", benchGjkDistance},
+  {"epa", "GJK + EPA penetration depth for box-box and tetra-box overlaps at varying depths", benchEpa},
+  {"pair_cache", "Per-frame GJK on the stress scene warm started from each pair's cached simplex", benchPairCache},
+  {"gjk_batch", "GJK distance and overlap over 10k random box/tetra pairs, scalar loop vs batched lanes", benchGjkBatch},
+  {"implicit_shapes", "Distances to implicit sphere, capsule, cylinder, cone and rounded box shapes, and an implicit sphere pair vs a tessellated one", benchImplicitShapes},
+  {"narrowphase", "Per pair type cost of the dispatched narrowphase kernels vs GJK + EPA for every pair", benchNarrowphase},
+  {"box_stack", "Resting box stacks under arbitrary rotation, box-box SAT manifolds vs GJK + EPA: speed and frame to frame stability", benchBoxStack},
+  {"manifold_cache", "Resting and sliding box stacks through persistent manifolds: narrowphase skip rate and feature id hit rate", benchManifoldCache},
+  {"sweep_and_prune", "Sweep and prune over 1k to 100k moving bodies, insertion sorted end points vs sorting from scratch", benchSweepAndPrune},
+  {"dynamic_tree", "Dynamic AABB tree over uniform and clustered moving bodies: update, query and raycast throughput against sweep and prune", benchDynamicTree},
+  {"spatial_grid", "Every broadphase picked at runtime on 100k bodies, then the parallel hashed grid on 1M bodies per thread count and cell size", benchSpatialGrid},
+  {"contact_solver", "Cube stacks on the ground through the sequential impulse solver, with and without warm starting: solve time and how fast the stacks settle", benchContactSolver},
+  {"contact_batches", "A 10k cube pile through the contact solver one constraint at a time vs in SSE and AVX2 batches", benchContactBatches},
+  {"contact_colors", "Large cube stacks through the coloured contact solver on 1 to 16 threads, with and without deterministic ordering", benchContactColors},
+  {"islands", "Many independent stacks and one large pile solved island by island vs all together, on 1 to 16 threads", benchIslands},
+  {"sleeping", "Resting stacks next to a few cubes dropped over and over, with and without islands falling asleep", benchSleeping},
+  {"integration", "Integrating 100k bodies stored as objects pointing at their shapes vs as one array per field", benchIntegration},
+};
+
+int main(int argc, char *argv[]) {
+  bool ranAny = false;
+  for (const Benchmark &benchmark : benchmarks) {
+    if (argc > 1 && strcmp(argv[1], benchmark.name) != 0) {
+      continue;
+    }
+    cout << benchmark.name << ": " << benchmark.description << endl;
+    benchmark.run();
+    cout << endl;
+    ranAny = true;
+  }
+
+  if (!ranAny) {
+    cout << "Unknown benchmark '" << argv[1] << "', available benchmarks are:" << endl;
+    for (const Benchmark &benchmark : benchmarks) {
+      cout << "  " << benchmark.name << endl;
+    }
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BOX_H_
+#define BOX_H_
+
+#include "shape.h"
+
+// Box centred on its origin. A non zero rounding becomes the margin, which
+// makes it a rounded box with the same outer half extents.
+class Box : public Shape {
+public:
+  // of the core, the margin is on top of these
+  glm::vec3 half_extents;
+
+  Box(glm::vec3 boxPos, glm::vec3 boxHalfExtents, float rounding = 0.0f)
+      : half_extents(boxHalfExtents - glm::vec3(rounding)) {
+    type = SHAPE_BOX;
+    transform.position = boxPos;
+    margin = rounding;
+  }
+
+  glm::vec3 local_centroid() const override {
+    return glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+
+  // The corner in direction's octant
+  glm::vec3 local_support(glm::vec3 direction, int *index) const override {
+    *index = -1;
+    return glm::vec3(direction.x >= 0.0f ? half_extents.x : -half_extents.x,
+                     direction.y >= 0.0f ? half_extents.y : -half_extents.y,
+                     direction.z >= 0.0f ? half_extents.z : -half_extents.z);
+  }
+};
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef BOX_BOX_H_
+#define BOX_BOX_H_
+
+#include <float.h>
+#include <math.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "box.h"
+#include "cube.h"
+#include "contact.h"
+
+// Face axes win over edge axes (and A's faces over B's) unless the other
+// axis overlaps less by this much, so a resting contact doesn't flip between
+// axes from one frame to the next
+#define SAT_RELATIVE_TOLERANCE 0.95f
+#define SAT_ABSOLUTE_TOLERANCE 0.001f
+// edges closer to parallel than this (sine of the angle between them) don't
+// give an axis
+#define SAT_PARALLEL_TOLERANCE 1e-3f
+// clipping a quad against 4 planes leaves at most 8 points
+#define BOX_CLIP_MAX_POINTS 8
+
+// A box the way the SAT wants it, everything in world space. Sharp Boxes and
+// Cubes both turn into one.
+struct OrientedBox {
+  glm::vec3 centre;
+  glm::vec3 axes[3];
+  glm::vec3 half_extents;
+
+  OrientedBox(const Transform &transform, glm::vec3 boxHalfExtents)
+      : centre(transform.position), half_extents(boxHalfExtents) {
+    glm::mat3 rotation = glm::mat3_cast(transform.orientation);
+    for (int i = 0; i < 3; i++) {
+      axes[i] = rotation[i];
+    }
+  }
+
+  glm::vec3 to_local(glm::vec3 point) const {
+    glm::vec3 d = point - centre;
+    return glm::vec3(glm::dot(d, axes[0]), glm::dot(d, axes[1]), glm::dot(d, axes[2]));
+  }
+
+  glm::vec3 to_world(glm::vec3 local) const {
+    return centre + axes[0] * local.x + axes[1] * local.y + axes[2] * local.z;
+  }
+};
+
+OrientedBox orientedBox(const Box &box) {
+  return OrientedBox(box.transform, box.half_extents);
+}
+
+// Cube's model space vertices are at +-0.5
+OrientedBox orientedBox(const Cube &cube) {
+  return OrientedBox(cube.transform, glm::vec3(0.5f, 0.5f, 0.5f));
+}
+
+// Sutherland-Hodgman step, keeps the part of the polygon where
+// dot(normal, p) <= offset. Every point carries a feature id: kept points
+// keep theirs, a point made on the clip plane gets one from the edge it cut
+// and the plane.
+int boxClipPolygon(const glm::vec3 in[], const unsigned int inIds[], int count, glm::vec3 normal, float offset,
+                   unsigned int plane, glm::vec3 out[], unsigned int outIds[]) {
+  int outCount = 0;
+  glm::vec3 p = in[count - 1];
+  unsigned int idP = inIds[count - 1];
+  float distanceP = glm::dot(normal, p) - offset;
+  for (int i = 0; i < count; i++) {
+    glm::vec3 q = in[i];
+    float distanceQ = glm::dot(normal, q) - offset;
+    if ((distanceP <= 0.0f) != (distanceQ <= 0.0f)) {
+      outIds[outCount] = contactFeatureId(contactFeatureId(idP, inIds[i]), plane);
+      out[outCount++] = p + (q - p) * (distanceP / (distanceP - distanceQ));
+    }
+    if (distanceQ <= 0.0f) {
+      outIds[outCount] = inIds[i];
+      out[outCount++] = q;
+    }
+    p = q;
+    idP = inIds[i];
+    distanceP = distanceQ;
+  }
+  return outCount;
+}
+
+// Face contact: the incident box's face most against the reference face's
+// normal is clipped to the reference face's sides, every clipped point below
+// the reference face is a contact point. normal points from the reference
+// box towards the incident one.
+void boxFaceContacts(const OrientedBox &reference, int axis, glm::vec3 normal,
+                     const OrientedBox &incident, bool referenceIsA, ContactManifold &manifold) {
+  int incidentAxis = 0;
+  float mostAgainst = 0.0f;
+  for (int i = 0; i < 3; i++) {
+    float d = fabsf(glm::dot(incident.axes[i], normal));
+    if (d > mostAgainst) {
+      mostAgainst = d;
+      incidentAxis = i;
+    }
+  }
+  float side = (glm::dot(incident.axes[incidentAxis], normal) > 0.0f) ? -1.0f : 1.0f;
+  glm::vec3 faceCentre = incident.centre
+                         + incident.axes[incidentAxis] * (side * incident.half_extents[incidentAxis]);
+  int i1 = (incidentAxis + 1) % 3;
+  int i2 = (incidentAxis + 2) % 3;
+  glm::vec3 u = incident.axes[i1] * incident.half_extents[i1];
+  glm::vec3 v = incident.axes[i2] * incident.half_extents[i2];
+
+  glm::vec3 polygon[BOX_CLIP_MAX_POINTS] = {
+    faceCentre + u + v, faceCentre - u + v, faceCentre - u - v, faceCentre + u - v
+  };
+  unsigned int polygonIds[BOX_CLIP_MAX_POINTS] = {1, 2, 3, 4};
+  glm::vec3 clipped[BOX_CLIP_MAX_POINTS];
+  unsigned int clippedIds[BOX_CLIP_MAX_POINTS];
+  int count = 4;
+  for (int k = 1; k <= 2 && count > 0; k++) {
+    int r = (axis + k) % 3;
+    glm::vec3 sideNormal = reference.axes[r];
+    float centreOffset = glm::dot(sideNormal, reference.centre);
+    count = boxClipPolygon(polygon, polygonIds, count, sideNormal, centreOffset + reference.half_extents[r],
+                           2 * k, clipped, clippedIds);
+    count = boxClipPolygon(clipped, clippedIds, count, -sideNormal, -centreOffset + reference.half_extents[r],
+                           2 * k + 1, polygon, polygonIds);
+  }
+
+  // which reference face met which incident face, the clip ids say where on
+  // them each point is
+  unsigned int faces = 1 + (referenceIsA ? 0 : 1) + 2 * axis + 6 * incidentAxis + (side > 0.0f ? 18 : 0);
+
+  ContactPoint candidates[BOX_CLIP_MAX_POINTS];
+  int candidateCount = 0;
+  float faceOffset = glm::dot(normal, reference.centre) + reference.half_extents[axis];
+  for (int i = 0; i < count; i++) {
+    float separation = glm::dot(normal, polygon[i]) - faceOffset;
+    if (separation < 0.0f) {
+      glm::vec3 onReference = polygon[i] - normal * separation;
+      ContactPoint &contact = candidates[candidateCount++];
+      contact.point_a = referenceIsA ? onReference : polygon[i];
+      contact.point_b = referenceIsA ? polygon[i] : onReference;
+      contact.depth = -separation;
+      contact.id = contactFeatureId(faces, polygonIds[i]);
+    }
+  }
+
+  int kept[CONTACT_MAX_POINTS];
+  int keptCount = reduceContactPoints(candidates, candidateCount, manifold.normal, kept);
+  for (int i = 0; i < keptCount; i++) {
+    const ContactPoint &contact = candidates[kept[i]];
+    manifold.add_point(contact.point_a, contact.point_b, contact.depth, contact.id);
+  }
+}
+
+// Separating axis test over the 3 face normals of each box and the 9 edge
+// cross products (Ericson's Real-Time Collision Detection 4.4.1, with the
+// overlap along each axis kept), then a manifold of up to 4 points from
+// clipping for a face axis, or the closest points of the two edges for an
+// edge axis.
+bool boxBoxManifold(const OrientedBox &boxA, const OrientedBox &boxB, ContactManifold &manifold) {
+  manifold.clear();
+  const glm::vec3 &a = boxA.half_extents;
+  const glm::vec3 &b = boxB.half_extents;
+
+  // B's axes in A's frame
+  float R[3][3];
+  float absR[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      R[i][j] = glm::dot(boxA.axes[i], boxB.axes[j]);
+      absR[i][j] = fabsf(R[i][j]);
+    }
+  }
+  glm::vec3 t = boxA.to_local(boxB.centre);
+
+  float faceA = FLT_MAX;
+  int faceAAxis = 0;
+  for (int i = 0; i < 3; i++) {
+    float overlap = a[i] + b[0] * absR[i][0] + b[1] * absR[i][1] + b[2] * absR[i][2] - fabsf(t[i]);
+    if (overlap <= 0.0f) {
+      return false;
+    }
+    if (overlap < faceA) {
+      faceA = overlap;
+      faceAAxis = i;
+    }
+  }
+
+  float faceB = FLT_MAX;
+  int faceBAxis = 0;
+  for (int j = 0; j < 3; j++) {
+    float distance = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+    float overlap = a[0] * absR[0][j] + a[1] * absR[1][j] + a[2] * absR[2][j] + b[j] - fabsf(distance);
+    if (overlap <= 0.0f) {
+      return false;
+    }
+    if (overlap < faceB) {
+      faceB = overlap;
+      faceBAxis = j;
+    }
+  }
+
+  float edge = FLT_MAX;
+  int edgeA = 0;
+  int edgeB = 0;
+  for (int i = 0; i < 3; i++) {
+    int i1 = (i + 1) % 3;
+    int i2 = (i + 2) % 3;
+    for (int j = 0; j < 3; j++) {
+      float length = sqrtf(glm::max(1.0f - R[i][j] * R[i][j], 0.0f));
+      if (length < SAT_PARALLEL_TOLERANCE) {
+        continue;
+      }
+      int j1 = (j + 1) % 3;
+      int j2 = (j + 2) % 3;
+      float ra = a[i1] * absR[i2][j] + a[i2] * absR[i1][j];
+      float rb = b[j1] * absR[i][j2] + b[j2] * absR[i][j1];
+      float distance = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+      float overlap = (ra + rb - fabsf(distance)) / length;
+      if (overlap <= 0.0f) {
+        return false;
+      }
+      if (overlap < edge) {
+        edge = overlap;
+        edgeA = i;
+        edgeB = j;
+      }
+    }
+  }
+
+  glm::vec3 d = boxB.centre - boxA.centre;
+  float best = faceA;
+  bool referenceIsA = true;
+  if (faceB < SAT_RELATIVE_TOLERANCE * best - SAT_ABSOLUTE_TOLERANCE) {
+    best = faceB;
+    referenceIsA = false;
+  }
+  if (edge < SAT_RELATIVE_TOLERANCE * best - SAT_ABSOLUTE_TOLERANCE) {
+    glm::vec3 normal = glm::normalize(glm::cross(boxA.axes[edgeA], boxB.axes[edgeB]));
+    if (glm::dot(normal, d) < 0.0f) {
+      normal = -normal;
+    }
+    manifold.normal = normal;
+
+    // the edge of each box furthest into the other, then the closest points
+    // of the two lines through them clamped to the edges
+    glm::vec3 middleA = boxA.centre;
+    glm::vec3 middleB = boxB.centre;
+    for (int k = 0; k < 3; k++) {
+      if (k != edgeA) {
+        middleA += boxA.axes[k] * (glm::dot(boxA.axes[k], normal) > 0.0f ? a[k] : -a[k]);
+      }
+      if (k != edgeB) {
+        middleB += boxB.axes[k] * (glm::dot(boxB.axes[k], normal) > 0.0f ? -b[k] : b[k]);
+      }
+    }
+    glm::vec3 directionA = boxA.axes[edgeA];
+    glm::vec3 directionB = boxB.axes[edgeB];
+    glm::vec3 r = middleA - middleB;
+    float e = glm::dot(directionA, directionB);
+    float f = glm::dot(directionB, r);
+    float s = (e * f - glm::dot(directionA, r)) / (1.0f - e * e);
+    s = glm::clamp(s, -a[edgeA], a[edgeA]);
+    glm::vec3 pointA = middleA + directionA * s;
+    manifold.add_point(pointA, pointA - normal * edge, edge, contactFeatureId(64 + 3 * edgeA + edgeB, 0));
+    return true;
+  }
+
+  const OrientedBox &reference = referenceIsA ? boxA : boxB;
+  const OrientedBox &incident = referenceIsA ? boxB : boxA;
+  int axis = referenceIsA ? faceAAxis : faceBAxis;
+  glm::vec3 normal = reference.axes[axis];
+  if (glm::dot(normal, incident.centre - reference.centre) < 0.0f) {
+    normal = -normal;
+  }
+  manifold.normal = referenceIsA ? normal : -normal;
+  boxFaceContacts(reference, axis, normal, incident, referenceIsA, manifold);
+
+  if (manifold.count == 0) {
+    // clipping lost every point to rounding, fall back to the deepest corner
+    glm::vec3 corner = incident.centre;
+    for (int k = 0; k < 3; k++) {
+      corner += incident.axes[k] * (glm::dot(incident.axes[k], normal) > 0.0f ? -incident.half_extents[k]
+                                                                               : incident.half_extents[k]);
+    }
+    glm::vec3 onReference = corner + normal * best;
+    manifold.add_point(referenceIsA ? onReference : corner, referenceIsA ? corner : onReference, best);
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef BROADPHASE_H_
+#define BROADPHASE_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "aabb.h"
+
+// Two bodies whose boxes overlap, by their index in the boxes handed to
+// Broadphase::update(). a is always the lower index.
+struct BroadphasePair {
+  int a;
+  int b;
+
+  bool operator<(const BroadphasePair &other) const {
+    return (a != other.a) ? a < other.a : b < other.b;
+  }
+
+  bool operator==(const BroadphasePair &other) const {
+    return a == other.a && b == other.b;
+  }
+};
+
+BroadphasePair broadphasePair(int a, int b) {
+  BroadphasePair pair;
+  pair.a = (a < b) ? a : b;
+  pair.b = (a < b) ? b : a;
+  return pair;
+}
+
+unsigned long long broadphasePairKey(int a, int b) {
+  BroadphasePair pair = broadphasePair(a, b);
+  return ((unsigned long long)pair.a << 32) | (unsigned int)pair.b;
+}
+
+// Finds the pairs of bodies whose boxes overlap. Bodies are the indices of
+// the boxes handed to update() once per step, every step has to hand over the
+// same bodies in the same order (a different count starts over).
+class Broadphase {
+public:
+  // pairs that started and stopped overlapping in the last update()
+  std::vector<BroadphasePair> added;
+  std::vector<BroadphasePair> removed;
+
+  virtual ~Broadphase() {}
+
+  virtual const char *name() const = 0;
+
+  virtual void update(const std::vector<Aabb> &boxes) = 0;
+
+  // update() for a step where only the bodies in moving (ascending) can have
+  // new boxes, every other box is the one the last update had. Sleeping and
+  // static bodies stay out of it so a broadphase that can freeze them only
+  // works on the rest. The count changing still starts over. By default it
+  // goes over every box like update().
+  virtual void update_moving(const std::vector<Aabb> &boxes, const std::vector<int> & /*moving*/) {
+    update(boxes);
+  }
+
+  // every pair overlapping as of the last update()
+  virtual void pairs(std::vector<BroadphasePair> &out) const = 0;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef BROADPHASES_H_
+#define BROADPHASES_H_
+
+#include <string.h>
+
+#include "broadphase.h"
+#include "sweep_and_prune.h"
+#include "dynamic_tree.h"
+#include "spatial_grid.h"
+
+// Which broadphase a scene runs, picked at runtime
+enum BroadphaseType {
+  BROADPHASE_SAP,
+  BROADPHASE_TREE,
+  BROADPHASE_GRID,
+  BROADPHASE_TYPE_COUNT
+};
+
+const char *broadphaseTypeName(BroadphaseType type) {
+  switch (type) {
+    case BROADPHASE_TREE:
+      return "tree";
+    case BROADPHASE_GRID:
+      return "grid";
+    default:
+      return "sap";
+  }
+}
+
+// The type with that name, sap when there is none
+BroadphaseType broadphaseTypeFromName(const char *name) {
+  for (int type = 0; type < BROADPHASE_TYPE_COUNT; type++) {
+    if (strcmp(name, broadphaseTypeName((BroadphaseType)type)) == 0) {
+      return (BroadphaseType)type;
+    }
+  }
+  return BROADPHASE_SAP;
+}
+
+// The caller owns the broadphase. Only the grid uses the thread pool, it has
+// to outlive the grid.
+Broadphase *createBroadphase(BroadphaseType type, ThreadPool &pool, float cellSize = GRID_DEFAULT_CELL_SIZE) {
+  switch (type) {
+    case BROADPHASE_TREE:
+      return new DynamicTree();
+    case BROADPHASE_GRID:
+      return new SpatialGrid(pool, cellSize);
+    default:
+      return new SweepAndPrune();
+  }
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef CAPSULE_H_
+#define CAPSULE_H_
+
+#include "shape.h"
+
+// A segment along the model space y axis from -half_height to half_height,
+// swept by a sphere of radius (the margin)
+class Capsule : public Shape {
+public:
+  float half_height;
+
+  Capsule(glm::vec3 capsulePos, float capsuleHalfHeight, float capsuleRadius)
+      : half_height(capsuleHalfHeight) {
+    type = SHAPE_CAPSULE;
+    transform.position = capsulePos;
+    margin = capsuleRadius;
+  }
+
+  float radius() const {
+    return margin;
+  }
+
+  glm::vec3 local_centroid() const override {
+    return glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+
+  glm::vec3 local_support(glm::vec3 direction, int *index) const override {
+    *index = -1;
+    return glm::vec3(0.0f, direction.y >= 0.0f ? half_height : -half_height, 0.0f);
+  }
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef CONE_H_
+#define CONE_H_
+
+#include <math.h>
+#include "shape.h"
+
+// Cone around the model space y axis, tip at half_height, base of radius at
+// -half_height
+class Cone : public Shape {
+public:
+  float half_height;
+  float radius;
+
+  Cone(glm::vec3 conePos, float coneHalfHeight, float coneRadius)
+      : half_height(coneHalfHeight), radius(coneRadius) {
+    type = SHAPE_CONE;
+    transform.position = conePos;
+    sin_angle = radius / sqrtf(radius * radius + 4.0f * half_height * half_height);
+  }
+
+  // a quarter of the way up from the base
+  glm::vec3 local_centroid() const override {
+    return glm::vec3(0.0f, -0.5f * half_height, 0.0f);
+  }
+
+  // The tip when direction is within the tip's normal cone, the base rim
+  // point towards direction otherwise (van den Bergen)
+  glm::vec3 local_support(glm::vec3 direction, int *index) const override {
+    *index = -1;
+    if (direction.y > glm::length(direction) * sin_angle) {
+      return glm::vec3(0.0f, half_height, 0.0f);
+    }
+    float sigma = sqrtf(direction.x * direction.x + direction.z * direction.z);
+    if (sigma <= 0.0f) {
+      return glm::vec3(0.0f, -half_height, 0.0f);
+    }
+    float scale = radius / sigma;
+    return glm::vec3(direction.x * scale, -half_height, direction.z * scale);
+  }
+
+private:
+  // sine of the half angle at the tip
+  float sin_angle;
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef CONTACT_H_
+#define CONTACT_H_
+
+#include <float.h>
+#include <math.h>
+#include <utility>
+#include <glm/glm.hpp>
+
+// A manifold never holds more points than this, 4 well spread points are
+// enough to rest a face on another
+#define CONTACT_MAX_POINTS 4
+
+// point_a is on (or in) shape A, point_b on shape B, and
+// point_a - point_b == normal * depth for the manifold's normal.
+//
+// id names the pair of features (which face was clipped by which side, which
+// two edges) the point came from, so the same point can be recognised next
+// frame. 0 is a point without one, those are only matched by distance.
+struct ContactPoint {
+  glm::vec3 point_a;
+  glm::vec3 point_b;
+  float depth;
+  unsigned int id;
+};
+
+// Folds feature b into id a (boost's hash_combine)
+unsigned int contactFeatureId(unsigned int a, unsigned int b) {
+  return a ^ (b + 0x9e3779b9u + (a << 6) + (a >> 2));
+}
+
+// Where an overlapping pair touches. Every point shares one normal, which
+// points from A towards B like EpaResult's: moving B along it by a point's
+// depth (or A against it) separates the shapes there.
+struct ContactManifold {
+  glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+  ContactPoint points[CONTACT_MAX_POINTS];
+  int count = 0;
+
+  void clear() {
+    count = 0;
+  }
+
+  void add_point(glm::vec3 point_a, glm::vec3 point_b, float depth, unsigned int id = 0) {
+    if (count == CONTACT_MAX_POINTS) {
+      return;
+    }
+    points[count].point_a = point_a;
+    points[count].point_b = point_b;
+    points[count].depth = depth;
+    points[count].id = id;
+    count++;
+  }
+
+  int deepest() const {
+    int deepest = 0;
+    for (int i = 1; i < count; i++) {
+      if (points[i].depth > points[deepest].depth) {
+        deepest = i;
+      }
+    }
+    return deepest;
+  }
+
+  float depth() const {
+    return (count > 0) ? points[deepest()].depth : 0.0f;
+  }
+
+  // the same manifold seen from B
+  void flip() {
+    normal = -normal;
+    for (int i = 0; i < count; i++) {
+      std::swap(points[i].point_a, points[i].point_b);
+    }
+  }
+};
+
+// Twice the area of triangle abc seen along normal, positive when it winds
+// counterclockwise around normal
+float contactTriangleArea(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 normal) {
+  return glm::dot(glm::cross(b - a, c - a), normal);
+}
+
+// Picks up to 4 of the candidates, keeping the deepest and spreading the
+// rest to cover as much area as possible: the deepest point, the one
+// furthest from it, the one making the biggest triangle with those two,
+// then the one furthest outside that triangle. Writes the indices of the
+// picked candidates to kept and returns how many there are.
+int reduceContactPoints(const ContactPoint candidates[], int count, glm::vec3 normal,
+                        int kept[CONTACT_MAX_POINTS]) {
+  if (count <= CONTACT_MAX_POINTS) {
+    for (int i = 0; i < count; i++) {
+      kept[i] = i;
+    }
+    return count;
+  }
+
+  int first = 0;
+  for (int i = 1; i < count; i++) {
+    if (candidates[i].depth > candidates[first].depth) {
+      first = i;
+    }
+  }
+  glm::vec3 a = candidates[first].point_b;
+
+  int second = -1;
+  float bestDistance = -1.0f;
+  for (int i = 0; i < count; i++) {
+    glm::vec3 d = candidates[i].point_b - a;
+    if (i != first && glm::dot(d, d) > bestDistance) {
+      bestDistance = glm::dot(d, d);
+      second = i;
+    }
+  }
+  glm::vec3 b = candidates[second].point_b;
+
+  int third = -1;
+  float bestArea = 0.0f;
+  for (int i = 0; i < count; i++) {
+    float area = contactTriangleArea(a, b, candidates[i].point_b, normal);
+    if (i != first && i != second && fabsf(area) > fabsf(bestArea)) {
+      bestArea = area;
+      third = i;
+    }
+  }
+  kept[0] = first;
+  kept[1] = second;
+  if (third == -1) {
+    // everything is on one line
+    return 2;
+  }
+  kept[2] = third;
+
+  // wind the triangle counterclockwise, then a point outside it makes a
+  // clockwise (negative) triangle with the edge it is outside of
+  glm::vec3 c = candidates[third].point_b;
+  if (bestArea < 0.0f) {
+    std::swap(b, c);
+  }
+  int fourth = -1;
+  float mostOutside = 0.0f;
+  for (int i = 0; i < count; i++) {
+    if (i == first || i == second || i == third) {
+      continue;
+    }
+    glm::vec3 p = candidates[i].point_b;
+    float outside = glm::min(contactTriangleArea(a, b, p, normal),
+                             glm::min(contactTriangleArea(b, c, p, normal), contactTriangleArea(c, a, p, normal)));
+    if (outside < mostOutside) {
+      mostOutside = outside;
+      fourth = i;
+    }
+  }
+  if (fourth == -1) {
+    return 3;
+  }
+  kept[3] = fourth;
+  return 4;
+}
+
+#endif
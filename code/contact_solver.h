@@ -0,0 +1,1210 @@
+#ifndef CONTACT_SOLVER_H_
+#define CONTACT_SOLVER_H_
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "contact.h"
+#include "manifold_cache.h"
+#include "rigid_body_storage.h"
+#include "simd_support.h"
+#include "thread_pool.h"
+
+#define CONTACT_SOLVER_ITERATIONS 10
+// Default ContactSolver::normal_passes. In a resting stack no corner impulse
+// is clamped and the bias is 0 (the cubes sit at the slop), what is left
+// after an iteration is Gauss-Seidel working through a face contact's 4
+// corners, 4 constraints on 3 degrees of freedom (push apart, tilt either
+// way). One pass in corner order leaves part of the tilt, always leaning the
+// same way, and through the friction at the manifold's centre that tilt is
+// a slide as well. A cold stack of 3 cubes walks 0.45 m in 5 s at 10
+// iterations of one pass, 9 mm at 100 and 4 mm at 10 iterations of 3 passes.
+// Passes only revisit one constraint's two bodies, already loaded, so they
+// are cheaper than iterations: warm started 10 high stacks settle at 10
+// iterations of 3 passes and still drift at 40 iterations of one.
+#define CONTACT_NORMAL_PASSES 3
+// Share of the penetration beyond the slop pushed out per step
+#define CONTACT_BAUMGARTE 0.2f
+// Penetration left alone, so resting contacts stay touching instead of being
+// pushed apart and falling back every step
+#define CONTACT_SLOP 0.005f
+
+// Two unit vectors perpendicular to normal and to each other, picked the
+// way Bullet's btPlaneSpace1 does. The basis only jumps where |normal.z|
+// crosses 1/sqrt(2), away from the y up normals of anything resting on the
+// ground, so warm started friction impulses stay on the same axes from step
+// to step.
+void contactTangents(glm::vec3 normal, glm::vec3 *tangent0, glm::vec3 *tangent1) {
+  if (fabsf(normal.z) > 0.7071f) {
+    float scale = 1.0f / sqrtf(normal.y * normal.y + normal.z * normal.z);
+    *tangent0 = glm::vec3(0.0f, -normal.z * scale, normal.y * scale);
+  }
+  else {
+    float scale = 1.0f / sqrtf(normal.x * normal.x + normal.y * normal.y);
+    *tangent0 = glm::vec3(-normal.y * scale, normal.x * scale, 0.0f);
+  }
+  *tangent1 = glm::cross(normal, *tangent0);
+}
+
+// One contact point ready to solve. r_a and r_b run from each body's centre
+// of mass to the point, normal_mass is the inverse of how much the relative
+// normal velocity there changes per unit impulse.
+struct ContactConstraintPoint {
+  glm::vec3 r_a;
+  glm::vec3 r_b;
+  float normal_mass;
+  // Normal speed the point may close at, negative for a cached point that
+  // has come apart: the gap may close that fast.
+  float bias;
+  // push speed the penetration asks for
+  float push_bias;
+  float normal_impulse;
+  // accumulated like the normal impulse but never warm started
+  float push_impulse;
+};
+
+// Everything the iterations need for one manifold, with the points inline so
+// a constraint is one contiguous block. Friction acts at the centre of the
+// points: two tangent directions and a twist about the normal.
+struct ContactConstraint {
+  int body_a;
+  int body_b;
+  glm::vec3 normal;
+  glm::vec3 tangents[2];
+  glm::vec3 centre_a;
+  glm::vec3 centre_b;
+  float tangent_mass[2];
+  float twist_mass;
+  float friction;
+  // mean distance of the points from the centre, what the normal impulses
+  // can resist a twist with
+  float twist_radius;
+  float tangent_impulse[2];
+  float twist_impulse;
+  int count;
+  ContactConstraintPoint points[CONTACT_MAX_POINTS];
+  // where the impulses go back to for the next step's warm start
+  PersistentManifold *manifold;
+};
+
+// Lanes in a batch, enough for AVX2. The SSE path fills 4 of them.
+#define CONTACT_BATCH_LANES 8
+// Batches being filled at once while constraints are grouped on one
+// thread, one bit each in a body's mask
+#define CONTACT_BATCH_OPEN 32
+// Colours the constraints are split into, one bit each in a body's mask.
+// Constraints that find every colour taken are solved after the rest, on
+// one thread.
+#define CONTACT_COLORS 32
+// Work a thread takes at once: this many batches, or this many constraints
+// solved one at a time
+#define CONTACT_CHUNK_BATCHES 8
+#define CONTACT_CHUNK_CONSTRAINTS 32
+
+// Constraints that share no moving body, laid out component by component so
+// one SIMD instruction works on every lane. Static bodies can be shared:
+// nothing changes their velocities, so every lane writes back what it read.
+// Points past a lane's count have no mass and make no impulse.
+struct ContactBatch {
+  // the constraint each lane came from
+  int constraint[CONTACT_BATCH_LANES];
+  int body_a[CONTACT_BATCH_LANES];
+  int body_b[CONTACT_BATCH_LANES];
+  // most points any lane has
+  int max_count;
+  float inverse_mass_a[CONTACT_BATCH_LANES];
+  float inverse_mass_b[CONTACT_BATCH_LANES];
+  // world inverse inertia, xx xy xz yy yz zz
+  float inertia_a[6][CONTACT_BATCH_LANES];
+  float inertia_b[6][CONTACT_BATCH_LANES];
+  float normal[3][CONTACT_BATCH_LANES];
+  float tangents[2][3][CONTACT_BATCH_LANES];
+  float centre_a[3][CONTACT_BATCH_LANES];
+  float centre_b[3][CONTACT_BATCH_LANES];
+  float tangent_mass[2][CONTACT_BATCH_LANES];
+  float twist_mass[CONTACT_BATCH_LANES];
+  float friction[CONTACT_BATCH_LANES];
+  float twist_radius[CONTACT_BATCH_LANES];
+  float tangent_impulse[2][CONTACT_BATCH_LANES];
+  float twist_impulse[CONTACT_BATCH_LANES];
+  float r_a[CONTACT_MAX_POINTS][3][CONTACT_BATCH_LANES];
+  float r_b[CONTACT_MAX_POINTS][3][CONTACT_BATCH_LANES];
+  float normal_mass[CONTACT_MAX_POINTS][CONTACT_BATCH_LANES];
+  float bias[CONTACT_MAX_POINTS][CONTACT_BATCH_LANES];
+  float push_bias[CONTACT_MAX_POINTS][CONTACT_BATCH_LANES];
+  float normal_impulse[CONTACT_MAX_POINTS][CONTACT_BATCH_LANES];
+  float push_impulse[CONTACT_MAX_POINTS][CONTACT_BATCH_LANES];
+};
+
+// A batch's body velocities, gathered from the storage before the batch is
+// solved and scattered back after
+struct ContactBatchVelocities {
+  float linear_a[3][CONTACT_BATCH_LANES];
+  float angular_a[3][CONTACT_BATCH_LANES];
+  float push_a[3][CONTACT_BATCH_LANES];
+  float turn_a[3][CONTACT_BATCH_LANES];
+  float linear_b[3][CONTACT_BATCH_LANES];
+  float angular_b[3][CONTACT_BATCH_LANES];
+  float push_b[3][CONTACT_BATCH_LANES];
+  float turn_b[3][CONTACT_BATCH_LANES];
+};
+
+#if SIMD_SUPPORT_X86
+SseVec3 sseLoad3(const float v[3][CONTACT_BATCH_LANES]) {
+  return SseVec3{_mm_loadu_ps(v[0]), _mm_loadu_ps(v[1]), _mm_loadu_ps(v[2])};
+}
+
+void sseStore3(float v[3][CONTACT_BATCH_LANES], SseVec3 a) {
+  _mm_storeu_ps(v[0], a.x);
+  _mm_storeu_ps(v[1], a.y);
+  _mm_storeu_ps(v[2], a.z);
+}
+
+// symmetric matrix m (xx xy xz yy yz zz) times v
+SseVec3 sseSymmetric3(const __m128 m[6], SseVec3 v) {
+  return SseVec3{_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], v.x), _mm_mul_ps(m[1], v.y)), _mm_mul_ps(m[2], v.z)),
+                 _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[1], v.x), _mm_mul_ps(m[3], v.y)), _mm_mul_ps(m[4], v.z)),
+                 _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[2], v.x), _mm_mul_ps(m[4], v.y)), _mm_mul_ps(m[5], v.z))};
+}
+
+// One pass over a 4 lane batch, the same steps as
+// ContactSolver::solve_constraint() on every lane at once
+SIMD_NOINLINE
+void sseSolveContactBatch(ContactBatch &batch, ContactBatchVelocities &velocities, int normalPasses) {
+  SseVec3 linearA = sseLoad3(velocities.linear_a);
+  SseVec3 angularA = sseLoad3(velocities.angular_a);
+  SseVec3 linearB = sseLoad3(velocities.linear_b);
+  SseVec3 angularB = sseLoad3(velocities.angular_b);
+  __m128 massA = _mm_loadu_ps(batch.inverse_mass_a);
+  __m128 massB = _mm_loadu_ps(batch.inverse_mass_b);
+  __m128 inertiaA[6];
+  __m128 inertiaB[6];
+  for (int i = 0; i < 6; i++) {
+    inertiaA[i] = _mm_loadu_ps(batch.inertia_a[i]);
+    inertiaB[i] = _mm_loadu_ps(batch.inertia_b[i]);
+  }
+  SseVec3 normal = sseLoad3(batch.normal);
+  __m128 zero = _mm_setzero_ps();
+
+  __m128 normalSum = zero;
+  for (int i = 0; i < batch.max_count; i++) {
+    normalSum = _mm_add_ps(normalSum, _mm_loadu_ps(batch.normal_impulse[i]));
+  }
+  __m128 limit = _mm_mul_ps(_mm_loadu_ps(batch.friction), normalSum);
+  __m128 negativeLimit = _mm_sub_ps(zero, limit);
+  SseVec3 centreA = sseLoad3(batch.centre_a);
+  SseVec3 centreB = sseLoad3(batch.centre_b);
+  for (int t = 0; t < 2; t++) {
+    SseVec3 tangent = sseLoad3(batch.tangents[t]);
+    SseVec3 relative = sseSub3(sseAdd3(linearB, sseCross3(angularB, centreB)),
+                               sseAdd3(linearA, sseCross3(angularA, centreA)));
+    __m128 speed = sseDot3(relative, tangent);
+    __m128 old = _mm_loadu_ps(batch.tangent_impulse[t]);
+    __m128 total = _mm_sub_ps(old, _mm_mul_ps(_mm_loadu_ps(batch.tangent_mass[t]), speed));
+    total = _mm_max_ps(_mm_min_ps(total, limit), negativeLimit);
+    _mm_storeu_ps(batch.tangent_impulse[t], total);
+    SseVec3 impulse = sseScale3(tangent, _mm_sub_ps(total, old));
+    linearA = sseSub3(linearA, sseScale3(impulse, massA));
+    angularA = sseSub3(angularA, sseSymmetric3(inertiaA, sseCross3(centreA, impulse)));
+    linearB = sseAdd3(linearB, sseScale3(impulse, massB));
+    angularB = sseAdd3(angularB, sseSymmetric3(inertiaB, sseCross3(centreB, impulse)));
+  }
+  {
+    __m128 twistLimit = _mm_mul_ps(limit, _mm_loadu_ps(batch.twist_radius));
+    __m128 spin = sseDot3(sseSub3(angularB, angularA), normal);
+    __m128 old = _mm_loadu_ps(batch.twist_impulse);
+    __m128 total = _mm_sub_ps(old, _mm_mul_ps(_mm_loadu_ps(batch.twist_mass), spin));
+    total = _mm_max_ps(_mm_min_ps(total, twistLimit), _mm_sub_ps(zero, twistLimit));
+    _mm_storeu_ps(batch.twist_impulse, total);
+    SseVec3 impulse = sseScale3(normal, _mm_sub_ps(total, old));
+    angularA = sseSub3(angularA, sseSymmetric3(inertiaA, impulse));
+    angularB = sseAdd3(angularB, sseSymmetric3(inertiaB, impulse));
+  }
+
+  for (int pass = 0; pass < normalPasses; pass++) {
+    for (int i = 0; i < batch.max_count; i++) {
+      SseVec3 rA = sseLoad3(batch.r_a[i]);
+      SseVec3 rB = sseLoad3(batch.r_b[i]);
+      SseVec3 relative = sseSub3(sseAdd3(linearB, sseCross3(angularB, rB)),
+                                 sseAdd3(linearA, sseCross3(angularA, rA)));
+      __m128 speed = sseDot3(relative, normal);
+      __m128 old = _mm_loadu_ps(batch.normal_impulse[i]);
+      __m128 total = _mm_add_ps(old, _mm_mul_ps(_mm_loadu_ps(batch.normal_mass[i]),
+                                                _mm_sub_ps(_mm_loadu_ps(batch.bias[i]), speed)));
+      total = _mm_max_ps(total, zero);
+      _mm_storeu_ps(batch.normal_impulse[i], total);
+      SseVec3 impulse = sseScale3(normal, _mm_sub_ps(total, old));
+      linearA = sseSub3(linearA, sseScale3(impulse, massA));
+      angularA = sseSub3(angularA, sseSymmetric3(inertiaA, sseCross3(rA, impulse)));
+      linearB = sseAdd3(linearB, sseScale3(impulse, massB));
+      angularB = sseAdd3(angularB, sseSymmetric3(inertiaB, sseCross3(rB, impulse)));
+    }
+  }
+  sseStore3(velocities.linear_a, linearA);
+  sseStore3(velocities.angular_a, angularA);
+  sseStore3(velocities.linear_b, linearB);
+  sseStore3(velocities.angular_b, angularB);
+
+  SseVec3 pushA = sseLoad3(velocities.push_a);
+  SseVec3 turnA = sseLoad3(velocities.turn_a);
+  SseVec3 pushB = sseLoad3(velocities.push_b);
+  SseVec3 turnB = sseLoad3(velocities.turn_b);
+  for (int i = 0; i < batch.max_count; i++) {
+    SseVec3 rA = sseLoad3(batch.r_a[i]);
+    SseVec3 rB = sseLoad3(batch.r_b[i]);
+    SseVec3 relative = sseSub3(sseAdd3(pushB, sseCross3(turnB, rB)), sseAdd3(pushA, sseCross3(turnA, rA)));
+    __m128 speed = sseDot3(relative, normal);
+    __m128 old = _mm_loadu_ps(batch.push_impulse[i]);
+    __m128 bias = _mm_loadu_ps(batch.push_bias[i]);
+    __m128 total = _mm_add_ps(old, _mm_mul_ps(_mm_loadu_ps(batch.normal_mass[i]), _mm_sub_ps(bias, speed)));
+    // points with nothing to push out and no push yet are left alone, as
+    // the scalar path skips them
+    __m128 active = _mm_or_ps(_mm_cmpneq_ps(bias, zero), _mm_cmpneq_ps(old, zero));
+    total = _mm_and_ps(_mm_max_ps(total, zero), active);
+    _mm_storeu_ps(batch.push_impulse[i], total);
+    SseVec3 impulse = sseScale3(normal, _mm_sub_ps(total, old));
+    pushA = sseSub3(pushA, sseScale3(impulse, massA));
+    turnA = sseSub3(turnA, sseSymmetric3(inertiaA, sseCross3(rA, impulse)));
+    pushB = sseAdd3(pushB, sseScale3(impulse, massB));
+    turnB = sseAdd3(turnB, sseSymmetric3(inertiaB, sseCross3(rB, impulse)));
+  }
+  sseStore3(velocities.push_a, pushA);
+  sseStore3(velocities.turn_a, turnA);
+  sseStore3(velocities.push_b, pushB);
+  sseStore3(velocities.turn_b, turnB);
+}
+
+struct Avx2Vec3 {
+  __m256 x;
+  __m256 y;
+  __m256 z;
+};
+
+SIMD_TARGET_AVX2 Avx2Vec3 avx2Load3(const float v[3][CONTACT_BATCH_LANES]) {
+  return Avx2Vec3{_mm256_loadu_ps(v[0]), _mm256_loadu_ps(v[1]), _mm256_loadu_ps(v[2])};
+}
+
+SIMD_TARGET_AVX2 void avx2Store3(float v[3][CONTACT_BATCH_LANES], Avx2Vec3 a) {
+  _mm256_storeu_ps(v[0], a.x);
+  _mm256_storeu_ps(v[1], a.y);
+  _mm256_storeu_ps(v[2], a.z);
+}
+
+SIMD_TARGET_AVX2 Avx2Vec3 avx2Add3(Avx2Vec3 a, Avx2Vec3 b) {
+  return Avx2Vec3{_mm256_add_ps(a.x, b.x), _mm256_add_ps(a.y, b.y), _mm256_add_ps(a.z, b.z)};
+}
+
+SIMD_TARGET_AVX2 Avx2Vec3 avx2Sub3(Avx2Vec3 a, Avx2Vec3 b) {
+  return Avx2Vec3{_mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z)};
+}
+
+SIMD_TARGET_AVX2 Avx2Vec3 avx2Scale3(Avx2Vec3 a, __m256 s) {
+  return Avx2Vec3{_mm256_mul_ps(a.x, s), _mm256_mul_ps(a.y, s), _mm256_mul_ps(a.z, s)};
+}
+
+SIMD_TARGET_AVX2 __m256 avx2Dot3(Avx2Vec3 a, Avx2Vec3 b) {
+  return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y)), _mm256_mul_ps(a.z, b.z));
+}
+
+SIMD_TARGET_AVX2 Avx2Vec3 avx2Cross3(Avx2Vec3 a, Avx2Vec3 b) {
+  return Avx2Vec3{_mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(a.z, b.y)),
+                  _mm256_sub_ps(_mm256_mul_ps(a.z, b.x), _mm256_mul_ps(a.x, b.z)),
+                  _mm256_sub_ps(_mm256_mul_ps(a.x, b.y), _mm256_mul_ps(a.y, b.x))};
+}
+
+SIMD_TARGET_AVX2 Avx2Vec3 avx2Symmetric3(const __m256 m[6], Avx2Vec3 v) {
+  __m256 x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], v.x), _mm256_mul_ps(m[1], v.y)), _mm256_mul_ps(m[2], v.z));
+  __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[1], v.x), _mm256_mul_ps(m[3], v.y)), _mm256_mul_ps(m[4], v.z));
+  __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[2], v.x), _mm256_mul_ps(m[4], v.y)), _mm256_mul_ps(m[5], v.z));
+  return Avx2Vec3{x, y, z};
+}
+
+// The same on an 8 lane batch
+SIMD_NOINLINE SIMD_TARGET_AVX2
+void avx2SolveContactBatch(ContactBatch &batch, ContactBatchVelocities &velocities, int normalPasses) {
+  Avx2Vec3 linearA = avx2Load3(velocities.linear_a);
+  Avx2Vec3 angularA = avx2Load3(velocities.angular_a);
+  Avx2Vec3 linearB = avx2Load3(velocities.linear_b);
+  Avx2Vec3 angularB = avx2Load3(velocities.angular_b);
+  __m256 massA = _mm256_loadu_ps(batch.inverse_mass_a);
+  __m256 massB = _mm256_loadu_ps(batch.inverse_mass_b);
+  __m256 inertiaA[6];
+  __m256 inertiaB[6];
+  for (int i = 0; i < 6; i++) {
+    inertiaA[i] = _mm256_loadu_ps(batch.inertia_a[i]);
+    inertiaB[i] = _mm256_loadu_ps(batch.inertia_b[i]);
+  }
+  Avx2Vec3 normal = avx2Load3(batch.normal);
+  __m256 zero = _mm256_setzero_ps();
+
+  __m256 normalSum = zero;
+  for (int i = 0; i < batch.max_count; i++) {
+    normalSum = _mm256_add_ps(normalSum, _mm256_loadu_ps(batch.normal_impulse[i]));
+  }
+  __m256 limit = _mm256_mul_ps(_mm256_loadu_ps(batch.friction), normalSum);
+  __m256 negativeLimit = _mm256_sub_ps(zero, limit);
+  Avx2Vec3 centreA = avx2Load3(batch.centre_a);
+  Avx2Vec3 centreB = avx2Load3(batch.centre_b);
+  for (int t = 0; t < 2; t++) {
+    Avx2Vec3 tangent = avx2Load3(batch.tangents[t]);
+    Avx2Vec3 relative = avx2Sub3(avx2Add3(linearB, avx2Cross3(angularB, centreB)),
+                                 avx2Add3(linearA, avx2Cross3(angularA, centreA)));
+    __m256 speed = avx2Dot3(relative, tangent);
+    __m256 old = _mm256_loadu_ps(batch.tangent_impulse[t]);
+    __m256 total = _mm256_sub_ps(old, _mm256_mul_ps(_mm256_loadu_ps(batch.tangent_mass[t]), speed));
+    total = _mm256_max_ps(_mm256_min_ps(total, limit), negativeLimit);
+    _mm256_storeu_ps(batch.tangent_impulse[t], total);
+    Avx2Vec3 impulse = avx2Scale3(tangent, _mm256_sub_ps(total, old));
+    linearA = avx2Sub3(linearA, avx2Scale3(impulse, massA));
+    angularA = avx2Sub3(angularA, avx2Symmetric3(inertiaA, avx2Cross3(centreA, impulse)));
+    linearB = avx2Add3(linearB, avx2Scale3(impulse, massB));
+    angularB = avx2Add3(angularB, avx2Symmetric3(inertiaB, avx2Cross3(centreB, impulse)));
+  }
+  {
+    __m256 twistLimit = _mm256_mul_ps(limit, _mm256_loadu_ps(batch.twist_radius));
+    __m256 spin = avx2Dot3(avx2Sub3(angularB, angularA), normal);
+    __m256 old = _mm256_loadu_ps(batch.twist_impulse);
+    __m256 total = _mm256_sub_ps(old, _mm256_mul_ps(_mm256_loadu_ps(batch.twist_mass), spin));
+    total = _mm256_max_ps(_mm256_min_ps(total, twistLimit), _mm256_sub_ps(zero, twistLimit));
+    _mm256_storeu_ps(batch.twist_impulse, total);
+    Avx2Vec3 impulse = avx2Scale3(normal, _mm256_sub_ps(total, old));
+    angularA = avx2Sub3(angularA, avx2Symmetric3(inertiaA, impulse));
+    angularB = avx2Add3(angularB, avx2Symmetric3(inertiaB, impulse));
+  }
+
+  for (int pass = 0; pass < normalPasses; pass++) {
+    for (int i = 0; i < batch.max_count; i++) {
+      Avx2Vec3 rA = avx2Load3(batch.r_a[i]);
+      Avx2Vec3 rB = avx2Load3(batch.r_b[i]);
+      Avx2Vec3 relative = avx2Sub3(avx2Add3(linearB, avx2Cross3(angularB, rB)),
+                                   avx2Add3(linearA, avx2Cross3(angularA, rA)));
+      __m256 speed = avx2Dot3(relative, normal);
+      __m256 old = _mm256_loadu_ps(batch.normal_impulse[i]);
+      __m256 total = _mm256_add_ps(old, _mm256_mul_ps(_mm256_loadu_ps(batch.normal_mass[i]),
+                                                      _mm256_sub_ps(_mm256_loadu_ps(batch.bias[i]), speed)));
+      total = _mm256_max_ps(total, zero);
+      _mm256_storeu_ps(batch.normal_impulse[i], total);
+      Avx2Vec3 impulse = avx2Scale3(normal, _mm256_sub_ps(total, old));
+      linearA = avx2Sub3(linearA, avx2Scale3(impulse, massA));
+      angularA = avx2Sub3(angularA, avx2Symmetric3(inertiaA, avx2Cross3(rA, impulse)));
+      linearB = avx2Add3(linearB, avx2Scale3(impulse, massB));
+      angularB = avx2Add3(angularB, avx2Symmetric3(inertiaB, avx2Cross3(rB, impulse)));
+    }
+  }
+  avx2Store3(velocities.linear_a, linearA);
+  avx2Store3(velocities.angular_a, angularA);
+  avx2Store3(velocities.linear_b, linearB);
+  avx2Store3(velocities.angular_b, angularB);
+
+  Avx2Vec3 pushA = avx2Load3(velocities.push_a);
+  Avx2Vec3 turnA = avx2Load3(velocities.turn_a);
+  Avx2Vec3 pushB = avx2Load3(velocities.push_b);
+  Avx2Vec3 turnB = avx2Load3(velocities.turn_b);
+  for (int i = 0; i < batch.max_count; i++) {
+    Avx2Vec3 rA = avx2Load3(batch.r_a[i]);
+    Avx2Vec3 rB = avx2Load3(batch.r_b[i]);
+    Avx2Vec3 relative = avx2Sub3(avx2Add3(pushB, avx2Cross3(turnB, rB)), avx2Add3(pushA, avx2Cross3(turnA, rA)));
+    __m256 speed = avx2Dot3(relative, normal);
+    __m256 old = _mm256_loadu_ps(batch.push_impulse[i]);
+    __m256 bias = _mm256_loadu_ps(batch.push_bias[i]);
+    __m256 total = _mm256_add_ps(old, _mm256_mul_ps(_mm256_loadu_ps(batch.normal_mass[i]), _mm256_sub_ps(bias, speed)));
+    __m256 active = _mm256_or_ps(_mm256_cmp_ps(bias, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(old, zero, _CMP_NEQ_UQ));
+    total = _mm256_and_ps(_mm256_max_ps(total, zero), active);
+    _mm256_storeu_ps(batch.push_impulse[i], total);
+    Avx2Vec3 impulse = avx2Scale3(normal, _mm256_sub_ps(total, old));
+    pushA = avx2Sub3(pushA, avx2Scale3(impulse, massA));
+    turnA = avx2Sub3(turnA, avx2Symmetric3(inertiaA, avx2Cross3(rA, impulse)));
+    pushB = avx2Add3(pushB, avx2Scale3(impulse, massB));
+    turnB = avx2Add3(turnB, avx2Symmetric3(inertiaB, avx2Cross3(rB, impulse)));
+  }
+  avx2Store3(velocities.push_a, pushA);
+  avx2Store3(velocities.turn_a, turnA);
+  avx2Store3(velocities.push_b, pushB);
+  avx2Store3(velocities.turn_b, turnB);
+}
+#endif
+
+// A colour's constraints as they're solved: full batches, then whatever
+// didn't fill one, as ranges of ContactSolver::batches and remainder
+struct ContactColor {
+  int batch_begin;
+  int batch_end;
+  int single_begin;
+  int single_end;
+};
+
+// Sequential impulses (Catto, "Iterative Dynamics with Temporal Coherence").
+// Every iteration walks the constraints in order and applies, per
+// constraint, the friction impulses and then per point the normal impulse
+// that would fix that point's relative velocity on its own, going over the
+// points normal_passes times. Impulses are
+// accumulated and the total is what gets clamped: a normal impulse never
+// pulls, friction stays inside friction * the normal impulses, so an
+// iteration can take back part of what an earlier one overshot.
+//
+// Friction is solved once per manifold at the centre of its points (as
+// Bepu does) instead of at every point. Per point friction lets opposite
+// corners pull against each other with impulses that cancel out, and warm
+// starting keeps them around until the points shift and they stop
+// cancelling, which twists stacks over.
+//
+// The totals are kept in the persistent manifold and applied up front next
+// step (warm starting), so a resting stack starts every step from last
+// step's answer instead of from nothing.
+//
+// Penetration is pushed out with split impulses (as in Bullet): a second
+// set of impulses on the bodies' push and turn velocities, which move them
+// once and are then forgotten. Folding it into the real velocities
+// (Baumgarte) leaves every body the push went through moving apart, and a
+// stack bounces on its own corrections until it falls.
+//
+// With SSE or AVX2 the constraints are grouped into batches of 4 or 8
+// that share no moving body, and each iteration solves a batch's lanes side
+// by side. Constraints left out of full batches are solved one at a time.
+//
+// On more than one thread the constraints are coloured instead: no two
+// constraints of a colour share a moving body, so a colour's constraints
+// can be solved in any order, on any thread (and batched), and come out the
+// same. Colours are solved one after the other with a barrier between
+// them. On one thread batches are filled first fit in constraint order
+// rather than by colour: each colour spans the whole scene, and going
+// through it colour by colour keeps missing the cache.
+//
+// Batching and colouring change the order constraints are solved in, so
+// the answer differs a little from the plain sequential path's.
+//
+// The colouring follows the order constraints were added in, which is the
+// broadphase's pair order, and the grid's depends on the thread count. In
+// deterministic mode the constraints are sorted by body first, so a step
+// comes out bit for bit the same on any number of threads.
+class ContactSolver {
+public:
+  int iterations = CONTACT_SOLVER_ITERATIONS;
+  // passes over each manifold's normal points within an iteration, see
+  // CONTACT_NORMAL_PASSES. iterations still counts sweeps over every
+  // constraint.
+  int normal_passes = CONTACT_NORMAL_PASSES;
+  // false starts every step from nothing, which takes about 40 iterations
+  // to hold a stack of 5 cubes and doesn't hold tall ones at all
+  bool warm_starting = true;
+  float baumgarte = CONTACT_BAUMGARTE;
+  float slop = CONTACT_SLOP;
+  // SUPPORT_SCALAR solves every constraint one at a time
+  SupportPath simd_path = activeSupportPath();
+  // not owned, null solves on the calling thread
+  ThreadPool *pool = nullptr;
+  bool deterministic = false;
+  std::vector<ContactConstraint> constraints;
+  // As of the last solve(): the colours (none on one thread), the batches
+  // and the constraints solved one at a time, colour by colour if coloured,
+  // and then from overflow_begin on the ones no colour was left for
+  std::vector<ContactColor> colors;
+  std::vector<ContactBatch> batches;
+  std::vector<int> remainder;
+  int overflow_begin = 0;
+
+  void clear() {
+    constraints.clear();
+  }
+
+  // Packs the manifold between bodies a and b. Their world inverse inertia
+  // has to be up to date.
+  void add(const RigidBodyStorage &bodies, int a, int b, PersistentManifold &manifold, float dt) {
+    constraints.push_back(ContactConstraint());
+    ContactConstraint &constraint = constraints.back();
+    constraint.body_a = a;
+    constraint.body_b = b;
+    constraint.normal = manifold.normal;
+    contactTangents(manifold.normal, &constraint.tangents[0], &constraint.tangents[1]);
+    constraint.friction = sqrtf(bodies.frictions[a] * bodies.frictions[b]);
+    constraint.count = manifold.count;
+    constraint.manifold = &manifold;
+
+    glm::vec3 positionA = bodies.positions[a];
+    glm::vec3 positionB = bodies.positions[b];
+    const glm::mat3 &inertiaA = bodies.inverse_inertias[a];
+    const glm::mat3 &inertiaB = bodies.inverse_inertias[b];
+    float massSum = bodies.inverse_masses[a] + bodies.inverse_masses[b];
+    glm::vec3 centre = glm::vec3(0.0f, 0.0f, 0.0f);
+    for (int i = 0; i < manifold.count; i++) {
+      const ManifoldPoint &contact = manifold.points[i];
+      ContactConstraintPoint &point = constraint.points[i];
+      glm::vec3 middle = 0.5f * (contact.point_a + contact.point_b);
+      centre += middle / (float)manifold.count;
+      point.r_a = middle - positionA;
+      point.r_b = middle - positionB;
+      point.normal_mass = effective_mass(inertiaA, inertiaB, point.r_a, point.r_b, constraint.normal, massSum);
+      point.bias = std::min(contact.depth, 0.0f) / dt;
+      point.push_bias = baumgarte / dt * std::max(contact.depth - slop, 0.0f);
+      point.normal_impulse = warm_starting ? contact.normal_impulse : 0.0f;
+      point.push_impulse = 0.0f;
+    }
+
+    constraint.centre_a = centre - positionA;
+    constraint.centre_b = centre - positionB;
+    for (int t = 0; t < 2; t++) {
+      constraint.tangent_mass[t] = effective_mass(inertiaA, inertiaB, constraint.centre_a, constraint.centre_b,
+                                                  constraint.tangents[t], massSum);
+    }
+    float k = glm::dot(constraint.normal, (inertiaA + inertiaB) * constraint.normal);
+    constraint.twist_mass = k > 0.0f ? 1.0f / k : 0.0f;
+    constraint.twist_radius = 0.0f;
+    for (int i = 0; i < manifold.count; i++) {
+      constraint.twist_radius += glm::length(constraint.points[i].r_a - constraint.centre_a) / manifold.count;
+    }
+    if (warm_starting) {
+      constraint.tangent_impulse[0] = manifold.tangent_impulse[0];
+      constraint.tangent_impulse[1] = manifold.tangent_impulse[1];
+      constraint.twist_impulse = manifold.twist_impulse;
+    }
+    else {
+      constraint.tangent_impulse[0] = 0.0f;
+      constraint.tangent_impulse[1] = 0.0f;
+      constraint.twist_impulse = 0.0f;
+    }
+  }
+
+  // Warm starts, iterates and stores the impulses back in the manifolds
+  void solve(RigidBodyStorage &bodies) {
+    if (colored()) {
+      solve_colored(bodies, 0, (int)constraints.size());
+      return;
+    }
+    colors.clear();
+    batches.clear();
+    remainder.clear();
+    overflow_begin = 0;
+    int width = batch_width();
+    if (width == 0) {
+      if (warm_starting) {
+        warm_start(bodies);
+      }
+      for (int i = 0; i < iterations; i++) {
+        solve_velocities(bodies);
+      }
+      store_impulses(0, (int)constraints.size());
+      return;
+    }
+    body_masks.assign(bodies.size(), 0u);
+    build_batches(bodies, width, 0, (int)constraints.size(), body_masks, batches, remainder);
+    overflow_begin = (int)remainder.size();
+    if (warm_starting) {
+      warm_start(bodies);
+    }
+    for (int i = 0; i < iterations; i++) {
+      for (ContactBatch &batch : batches) {
+        solve_batch(bodies, batch, width);
+      }
+      for (int index : remainder) {
+        solve_constraint(bodies, constraints[index]);
+      }
+    }
+    unpack_batches(width);
+    store_impulses(0, (int)constraints.size());
+  }
+
+  // Solves ranges of constraints that share no moving body (islands, or
+  // several small ones together) side by side on the pool, each as solve()
+  // does on one thread but in the order the constraints were added, which
+  // deterministic mode then has to make the same on any thread count. Range
+  // i is bounds[i] to bounds[i + 1], and they're started in order. colors,
+  // batches and remainder are left empty.
+  void solve_ranges(RigidBodyStorage &bodies, const std::vector<int> &bounds) {
+    colors.clear();
+    batches.clear();
+    remainder.clear();
+    overflow_begin = 0;
+    int threads = pool ? pool->size() : 1;
+    if ((int)scratch.size() < threads) {
+      scratch.resize(threads);
+    }
+    run((int)bounds.size() - 1, [&](int range, int thread) {
+      solve_range(bodies, bounds[range], bounds[range + 1], scratch[thread]);
+    });
+  }
+
+  // Colours constraints begin to end and solves them colour by colour
+  // across the pool, batched on simd_path. Runs on the calling thread.
+  void solve_colored(RigidBodyStorage &bodies, int begin, int end) {
+    colors.clear();
+    batches.clear();
+    remainder.clear();
+    overflow_begin = 0;
+    if (deterministic) {
+      sort_constraints(begin, end);
+    }
+    int width = batch_width();
+    build_colors(bodies, width, begin, end);
+    if (warm_starting) {
+      for_each_color([&](int batchBegin, int batchEnd, int singleBegin, int singleEnd) {
+        for (int b = batchBegin; b < batchEnd; b++) {
+          for (int lane = 0; lane < width; lane++) {
+            warm_start_constraint(bodies, constraints[batches[b].constraint[lane]]);
+          }
+        }
+        for (int i = singleBegin; i < singleEnd; i++) {
+          warm_start_constraint(bodies, constraints[remainder[i]]);
+        }
+      });
+    }
+    for (int i = 0; i < iterations; i++) {
+      for_each_color([&](int batchBegin, int batchEnd, int singleBegin, int singleEnd) {
+        for (int b = batchBegin; b < batchEnd; b++) {
+          solve_batch(bodies, batches[b], width);
+        }
+        for (int i = singleBegin; i < singleEnd; i++) {
+          solve_constraint(bodies, constraints[remainder[i]]);
+        }
+      });
+    }
+    unpack_batches(width);
+    store_impulses(begin, end);
+  }
+
+  // Whether solve() colours the constraints, rather than solving them in
+  // order or in first fit batches
+  bool colored() const {
+    return deterministic || (pool && pool->size() > 1);
+  }
+
+  // Lanes per batch on simd_path, 0 for none
+  int batch_width() const {
+#if SIMD_SUPPORT_X86
+    switch (simd_path) {
+      case SUPPORT_AVX2:
+        return 8;
+      case SUPPORT_SSE:
+        return 4;
+      default:
+        break;
+    }
+#endif
+    return 0;
+  }
+
+  // Greedy first fit: up to CONTACT_BATCH_OPEN batches are filled at once,
+  // every moving body keeping a bit per open batch it's in, and each
+  // constraint goes to the first batch neither of its bodies is in. A full
+  // batch is packed and its bit freed for a new one. Whatever is left in
+  // batches that never filled, or found every batch taken, goes in the
+  // remainder. masks has to be all clear and is left that way.
+  void build_batches(const RigidBodyStorage &bodies, int width, int begin, int end,
+                     std::vector<unsigned int> &masks, std::vector<ContactBatch> &full, std::vector<int> &rest) const {
+    int open[CONTACT_BATCH_OPEN][CONTACT_BATCH_LANES];
+    int filled[CONTACT_BATCH_OPEN] = {0};
+    for (int index = begin; index < end; index++) {
+      int a = constraints[index].body_a;
+      int b = constraints[index].body_b;
+      bool movesA = !bodies.is_static(a);
+      bool movesB = !bodies.is_static(b);
+      unsigned int taken = (movesA ? masks[a] : 0u) | (movesB ? masks[b] : 0u);
+      int slot = 0;
+      while (slot < CONTACT_BATCH_OPEN && (taken >> slot & 1u)) {
+        slot++;
+      }
+      if (slot == CONTACT_BATCH_OPEN) {
+        rest.push_back(index);
+        continue;
+      }
+      open[slot][filled[slot]++] = index;
+      unsigned int bit = 1u << slot;
+      if (movesA) {
+        masks[a] |= bit;
+      }
+      if (movesB) {
+        masks[b] |= bit;
+      }
+      if (filled[slot] == width) {
+        full.push_back(ContactBatch());
+        pack_batch(bodies, open[slot], width, full.back());
+        for (int lane = 0; lane < width; lane++) {
+          masks[constraints[open[slot][lane]].body_a] &= ~bit;
+          masks[constraints[open[slot][lane]].body_b] &= ~bit;
+        }
+        filled[slot] = 0;
+      }
+    }
+    for (int slot = 0; slot < CONTACT_BATCH_OPEN; slot++) {
+      rest.insert(rest.end(), open[slot], open[slot] + filled[slot]);
+    }
+    std::sort(rest.begin(), rest.end());
+    // the bits of batches left open
+    for (int index : rest) {
+      masks[constraints[index].body_a] = 0u;
+      masks[constraints[index].body_b] = 0u;
+    }
+  }
+
+  // Greedy colouring in constraint order: every moving body keeps a bit per
+  // colour one of its constraints has, and each constraint takes the
+  // lowest colour neither of its bodies has. Static bodies don't count,
+  // nothing a constraint does changes them. Each colour is then cut into
+  // full batches of width, and the rest of it goes in the remainder.
+  void build_colors(const RigidBodyStorage &bodies, int width, int begin, int end) {
+    body_masks.assign(bodies.size(), 0u);
+    constraint_colors.resize(end - begin);
+    int sizes[CONTACT_COLORS] = {0};
+    int overflow = 0;
+    for (int index = begin; index < end; index++) {
+      int a = constraints[index].body_a;
+      int b = constraints[index].body_b;
+      bool movesA = !bodies.is_static(a);
+      bool movesB = !bodies.is_static(b);
+      unsigned int taken = (movesA ? body_masks[a] : 0u) | (movesB ? body_masks[b] : 0u);
+      int color = 0;
+      while (color < CONTACT_COLORS && (taken >> color & 1u)) {
+        color++;
+      }
+      if (color == CONTACT_COLORS) {
+        constraint_colors[index - begin] = -1;
+        overflow++;
+        continue;
+      }
+      constraint_colors[index - begin] = color;
+      sizes[color]++;
+      if (movesA) {
+        body_masks[a] |= 1u << color;
+      }
+      if (movesB) {
+        body_masks[b] |= 1u << color;
+      }
+    }
+
+    // every colour's constraints together, in constraint order
+    int starts[CONTACT_COLORS];
+    int offset = 0;
+    for (int color = 0; color < CONTACT_COLORS; color++) {
+      starts[color] = offset;
+      offset += sizes[color];
+    }
+    ordered.resize(offset);
+    remainder.reserve(end - begin);
+    for (int index = begin; index < end; index++) {
+      if (constraint_colors[index - begin] >= 0) {
+        ordered[starts[constraint_colors[index - begin]]++] = index;
+      }
+    }
+
+    batch_sources.clear();
+    offset = 0;
+    for (int color = 0; color < CONTACT_COLORS; color++) {
+      if (sizes[color] == 0) {
+        continue;
+      }
+      int full = width > 0 ? sizes[color] / width * width : 0;
+      ContactColor range;
+      range.batch_begin = (int)batch_sources.size();
+      for (int lane = 0; lane < full; lane += width) {
+        batch_sources.push_back(offset + lane);
+      }
+      range.batch_end = (int)batch_sources.size();
+      range.single_begin = (int)remainder.size();
+      remainder.insert(remainder.end(), ordered.begin() + offset + full, ordered.begin() + offset + sizes[color]);
+      range.single_end = (int)remainder.size();
+      colors.push_back(range);
+      offset += sizes[color];
+    }
+    overflow_begin = (int)remainder.size();
+    for (int index = begin; index < end && overflow > 0; index++) {
+      if (constraint_colors[index - begin] < 0) {
+        remainder.push_back(index);
+      }
+    }
+
+    batches.resize(batch_sources.size());
+    int chunks = ((int)batches.size() + CONTACT_CHUNK_BATCHES - 1) / CONTACT_CHUNK_BATCHES;
+    run(chunks, [&](int chunk, int) {
+      int end = std::min((chunk + 1) * CONTACT_CHUNK_BATCHES, (int)batches.size());
+      for (int b = chunk * CONTACT_CHUNK_BATCHES; b < end; b++) {
+        pack_batch(bodies, &ordered[batch_sources[b]], width, batches[b]);
+      }
+    });
+  }
+
+  // Calls task(batchBegin, batchEnd, singleBegin, singleEnd) on chunks of
+  // every colour, the chunks of a colour spread over the pool, then on the
+  // overflow on the calling thread
+  template <class Task>
+  void for_each_color(const Task &task) {
+    for (const ContactColor &color : colors) {
+      int batchChunks = (color.batch_end - color.batch_begin + CONTACT_CHUNK_BATCHES - 1) / CONTACT_CHUNK_BATCHES;
+      int singles = color.single_end - color.single_begin;
+      int singleChunks = (singles + CONTACT_CHUNK_CONSTRAINTS - 1) / CONTACT_CHUNK_CONSTRAINTS;
+      run(batchChunks + singleChunks, [&](int chunk, int) {
+        if (chunk < batchChunks) {
+          int begin = color.batch_begin + chunk * CONTACT_CHUNK_BATCHES;
+          task(begin, std::min(begin + CONTACT_CHUNK_BATCHES, color.batch_end), 0, 0);
+        }
+        else {
+          int begin = color.single_begin + (chunk - batchChunks) * CONTACT_CHUNK_CONSTRAINTS;
+          task(0, 0, begin, std::min(begin + CONTACT_CHUNK_CONSTRAINTS, color.single_end));
+        }
+      });
+    }
+    task(0, 0, overflow_begin, (int)remainder.size());
+  }
+
+  // Gathers the batch's body velocities from the storage, solves it on
+  // simd_path and scatters them back
+  void solve_batch(RigidBodyStorage &bodies, ContactBatch &batch, int width) const {
+    ContactBatchVelocities velocities;
+    for (int lane = 0; lane < width; lane++) {
+      gather(bodies.linear_velocities[batch.body_a[lane]], velocities.linear_a, lane);
+      gather(bodies.angular_velocities[batch.body_a[lane]], velocities.angular_a, lane);
+      gather(bodies.push_velocities[batch.body_a[lane]], velocities.push_a, lane);
+      gather(bodies.turn_velocities[batch.body_a[lane]], velocities.turn_a, lane);
+      gather(bodies.linear_velocities[batch.body_b[lane]], velocities.linear_b, lane);
+      gather(bodies.angular_velocities[batch.body_b[lane]], velocities.angular_b, lane);
+      gather(bodies.push_velocities[batch.body_b[lane]], velocities.push_b, lane);
+      gather(bodies.turn_velocities[batch.body_b[lane]], velocities.turn_b, lane);
+    }
+#if SIMD_SUPPORT_X86
+    if (width == 8) {
+      avx2SolveContactBatch(batch, velocities, normal_passes);
+    }
+    else {
+      sseSolveContactBatch(batch, velocities, normal_passes);
+    }
+#endif
+    // static bodies aren't written back, see SolverBody::store
+    for (int lane = 0; lane < width; lane++) {
+      if (batch.inverse_mass_a[lane] != 0.0f) {
+        scatter(velocities.linear_a, lane, bodies.linear_velocities[batch.body_a[lane]]);
+        scatter(velocities.angular_a, lane, bodies.angular_velocities[batch.body_a[lane]]);
+        scatter(velocities.push_a, lane, bodies.push_velocities[batch.body_a[lane]]);
+        scatter(velocities.turn_a, lane, bodies.turn_velocities[batch.body_a[lane]]);
+      }
+      if (batch.inverse_mass_b[lane] != 0.0f) {
+        scatter(velocities.linear_b, lane, bodies.linear_velocities[batch.body_b[lane]]);
+        scatter(velocities.angular_b, lane, bodies.angular_velocities[batch.body_b[lane]]);
+        scatter(velocities.push_b, lane, bodies.push_velocities[batch.body_b[lane]]);
+        scatter(velocities.turn_b, lane, bodies.turn_velocities[batch.body_b[lane]]);
+      }
+    }
+  }
+
+  // Copies the batches' impulses back to their constraints
+  void unpack_batches(int width) {
+    int chunks = ((int)batches.size() + CONTACT_CHUNK_BATCHES - 1) / CONTACT_CHUNK_BATCHES;
+    run(chunks, [&](int chunk, int) {
+      int end = std::min((chunk + 1) * CONTACT_CHUNK_BATCHES, (int)batches.size());
+      for (int b = chunk * CONTACT_CHUNK_BATCHES; b < end; b++) {
+        unpack_batch(batches[b], width);
+      }
+    });
+  }
+
+  void unpack_batch(const ContactBatch &batch, int width) {
+    for (int lane = 0; lane < width; lane++) {
+      ContactConstraint &constraint = constraints[batch.constraint[lane]];
+      constraint.tangent_impulse[0] = batch.tangent_impulse[0][lane];
+      constraint.tangent_impulse[1] = batch.tangent_impulse[1][lane];
+      constraint.twist_impulse = batch.twist_impulse[lane];
+      for (int i = 0; i < constraint.count; i++) {
+        constraint.points[i].normal_impulse = batch.normal_impulse[i][lane];
+        constraint.points[i].push_impulse = batch.push_impulse[i][lane];
+      }
+    }
+  }
+
+  // Applies the impulses the constraints were packed with
+  void warm_start(RigidBodyStorage &bodies) {
+    for (const ContactConstraint &constraint : constraints) {
+      warm_start_constraint(bodies, constraint);
+    }
+  }
+
+  void warm_start_constraint(RigidBodyStorage &bodies, const ContactConstraint &constraint) const {
+    SolverBody bodyA(bodies, constraint.body_a);
+    SolverBody bodyB(bodies, constraint.body_b);
+    for (int i = 0; i < constraint.count; i++) {
+      const ContactConstraintPoint &point = constraint.points[i];
+      apply(bodyA, bodyB, point.r_a, point.r_b, constraint.normal * point.normal_impulse);
+    }
+    glm::vec3 friction = constraint.tangents[0] * constraint.tangent_impulse[0]
+                         + constraint.tangents[1] * constraint.tangent_impulse[1];
+    apply(bodyA, bodyB, constraint.centre_a, constraint.centre_b, friction);
+    twist(bodyA, bodyB, constraint.normal * constraint.twist_impulse);
+    bodyA.store(bodies, constraint.body_a);
+    bodyB.store(bodies, constraint.body_b);
+  }
+
+  // One pass over every constraint
+  void solve_velocities(RigidBodyStorage &bodies) {
+    for (ContactConstraint &constraint : constraints) {
+      solve_constraint(bodies, constraint);
+    }
+  }
+
+  // One constraint's impulses. The bodies' velocities are loaded once,
+  // updated in registers and written back at the end.
+  void solve_constraint(RigidBodyStorage &bodies, ContactConstraint &constraint) const {
+    SolverBody bodyA(bodies, constraint.body_a);
+    SolverBody bodyB(bodies, constraint.body_b);
+    // friction first, its limit comes from the normal impulses and the
+    // normal ones matter more, so they get the last word
+    float normalSum = 0.0f;
+    for (int i = 0; i < constraint.count; i++) {
+      normalSum += constraint.points[i].normal_impulse;
+    }
+    float limit = constraint.friction * normalSum;
+    for (int t = 0; t < 2; t++) {
+      glm::vec3 tangent = constraint.tangents[t];
+      float speed = glm::dot(relative_velocity(bodyA, bodyB, constraint.centre_a, constraint.centre_b), tangent);
+      float total = glm::clamp(constraint.tangent_impulse[t] - constraint.tangent_mass[t] * speed, -limit, limit);
+      float impulse = total - constraint.tangent_impulse[t];
+      constraint.tangent_impulse[t] = total;
+      apply(bodyA, bodyB, constraint.centre_a, constraint.centre_b, tangent * impulse);
+    }
+    float twistLimit = limit * constraint.twist_radius;
+    float spin = glm::dot(bodyB.angular - bodyA.angular, constraint.normal);
+    float twistTotal = glm::clamp(constraint.twist_impulse - constraint.twist_mass * spin, -twistLimit, twistLimit);
+    twist(bodyA, bodyB, constraint.normal * (twistTotal - constraint.twist_impulse));
+    constraint.twist_impulse = twistTotal;
+
+    for (int pass = 0; pass < normal_passes; pass++) {
+      for (int i = 0; i < constraint.count; i++) {
+        ContactConstraintPoint &point = constraint.points[i];
+        float speed = glm::dot(relative_velocity(bodyA, bodyB, point.r_a, point.r_b), constraint.normal);
+        float total = std::max(point.normal_impulse + point.normal_mass * (point.bias - speed), 0.0f);
+        float impulse = total - point.normal_impulse;
+        point.normal_impulse = total;
+        apply(bodyA, bodyB, point.r_a, point.r_b, constraint.normal * impulse);
+      }
+    }
+    for (int i = 0; i < constraint.count; i++) {
+      ContactConstraintPoint &point = constraint.points[i];
+      if (point.push_bias == 0.0f && point.push_impulse == 0.0f) {
+        continue;
+      }
+      float speed = glm::dot(relative_push_velocity(bodyA, bodyB, point), constraint.normal);
+      float total = std::max(point.push_impulse + point.normal_mass * (point.push_bias - speed), 0.0f);
+      float impulse = total - point.push_impulse;
+      point.push_impulse = total;
+      push(bodyA, bodyB, point, constraint.normal * impulse);
+    }
+    bodyA.store(bodies, constraint.body_a);
+    bodyB.store(bodies, constraint.body_b);
+  }
+
+  void store_impulses(int begin, int end) {
+    for (int index = begin; index < end; index++) {
+      const ContactConstraint &constraint = constraints[index];
+      PersistentManifold &manifold = *constraint.manifold;
+      for (int i = 0; i < constraint.count; i++) {
+        manifold.points[i].normal_impulse = constraint.points[i].normal_impulse;
+      }
+      manifold.tangent_impulse[0] = constraint.tangent_impulse[0];
+      manifold.tangent_impulse[1] = constraint.tangent_impulse[1];
+      manifold.twist_impulse = constraint.twist_impulse;
+    }
+  }
+
+private:
+  // bit i set while the body is in open batch i, or once it has a
+  // constraint of colour i
+  std::vector<unsigned int> body_masks;
+  // per constraint being coloured, -1 for the overflow
+  std::vector<int> constraint_colors;
+  // constraint indices colour by colour
+  std::vector<int> ordered;
+  // where in ordered each batch's lanes start
+  std::vector<int> batch_sources;
+
+  // What solve_ranges() batches a range with, one per thread
+  struct RangeScratch {
+    std::vector<unsigned int> body_masks;
+    std::vector<ContactBatch> batches;
+    std::vector<int> remainder;
+  };
+  std::vector<RangeScratch> scratch;
+
+  // solve() on one thread for constraints begin to end, in the order they
+  // were added even in deterministic mode. Writes nothing but those
+  // constraints, their moving bodies and the scratch.
+  void solve_range(RigidBodyStorage &bodies, int begin, int end, RangeScratch &range) {
+    int width = batch_width();
+    range.batches.clear();
+    range.remainder.clear();
+    if (width == 0) {
+      for (int index = begin; index < end; index++) {
+        range.remainder.push_back(index);
+      }
+    }
+    else {
+      if ((int)range.body_masks.size() < bodies.size()) {
+        range.body_masks.resize(bodies.size(), 0u);
+      }
+      build_batches(bodies, width, begin, end, range.body_masks, range.batches, range.remainder);
+    }
+    if (warm_starting) {
+      for (int index = begin; index < end; index++) {
+        warm_start_constraint(bodies, constraints[index]);
+      }
+    }
+    for (int i = 0; i < iterations; i++) {
+      for (ContactBatch &batch : range.batches) {
+        solve_batch(bodies, batch, width);
+      }
+      for (int index : range.remainder) {
+        solve_constraint(bodies, constraints[index]);
+      }
+    }
+    for (const ContactBatch &batch : range.batches) {
+      unpack_batch(batch, width);
+    }
+    store_impulses(begin, end);
+  }
+
+  // By body pair, the order deterministic mode solves in
+  void sort_constraints(int begin, int end) {
+    std::sort(constraints.begin() + begin, constraints.begin() + end,
+              [](const ContactConstraint &a, const ContactConstraint &b) {
+                return a.body_a != b.body_a ? a.body_a < b.body_a : a.body_b < b.body_b;
+              });
+  }
+
+  // task(index, thread) for every index below count, on the pool if there
+  // is one
+  template <class Task>
+  void run(int count, const Task &task) {
+    if (pool) {
+      pool->run(count, task);
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      task(i, 0);
+    }
+  }
+
+  // Lays the constraints out as the lanes of batch
+  void pack_batch(const RigidBodyStorage &bodies, const int lanes[], int width, ContactBatch &batch) const {
+    batch.max_count = 0;
+    for (int lane = 0; lane < width; lane++) {
+      const ContactConstraint &constraint = constraints[lanes[lane]];
+      batch.constraint[lane] = lanes[lane];
+      batch.body_a[lane] = constraint.body_a;
+      batch.body_b[lane] = constraint.body_b;
+      batch.max_count = std::max(batch.max_count, constraint.count);
+      batch.inverse_mass_a[lane] = bodies.inverse_masses[constraint.body_a];
+      batch.inverse_mass_b[lane] = bodies.inverse_masses[constraint.body_b];
+      const glm::mat3 &inertiaA = bodies.inverse_inertias[constraint.body_a];
+      const glm::mat3 &inertiaB = bodies.inverse_inertias[constraint.body_b];
+      const int rows[6] = {0, 0, 0, 1, 1, 2};
+      const int columns[6] = {0, 1, 2, 1, 2, 2};
+      for (int i = 0; i < 6; i++) {
+        batch.inertia_a[i][lane] = inertiaA[columns[i]][rows[i]];
+        batch.inertia_b[i][lane] = inertiaB[columns[i]][rows[i]];
+      }
+      gather(constraint.normal, batch.normal, lane);
+      gather(constraint.tangents[0], batch.tangents[0], lane);
+      gather(constraint.tangents[1], batch.tangents[1], lane);
+      gather(constraint.centre_a, batch.centre_a, lane);
+      gather(constraint.centre_b, batch.centre_b, lane);
+      for (int t = 0; t < 2; t++) {
+        batch.tangent_mass[t][lane] = constraint.tangent_mass[t];
+        batch.tangent_impulse[t][lane] = constraint.tangent_impulse[t];
+      }
+      batch.twist_mass[lane] = constraint.twist_mass;
+      batch.friction[lane] = constraint.friction;
+      batch.twist_radius[lane] = constraint.twist_radius;
+      batch.twist_impulse[lane] = constraint.twist_impulse;
+      for (int i = 0; i < CONTACT_MAX_POINTS; i++) {
+        // missing points have no mass, so they never make an impulse
+        ContactConstraintPoint point = {};
+        if (i < constraint.count) {
+          point = constraint.points[i];
+        }
+        gather(point.r_a, batch.r_a[i], lane);
+        gather(point.r_b, batch.r_b[i], lane);
+        batch.normal_mass[i][lane] = point.normal_mass;
+        batch.bias[i][lane] = point.bias;
+        batch.push_bias[i][lane] = point.push_bias;
+        batch.normal_impulse[i][lane] = point.normal_impulse;
+        batch.push_impulse[i][lane] = point.push_impulse;
+      }
+    }
+  }
+
+  static void gather(glm::vec3 v, float lanes[3][CONTACT_BATCH_LANES], int lane) {
+    lanes[0][lane] = v.x;
+    lanes[1][lane] = v.y;
+    lanes[2][lane] = v.z;
+  }
+
+  static void scatter(const float lanes[3][CONTACT_BATCH_LANES], int lane, glm::vec3 &v) {
+    v = glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+  }
+
+  // One body's velocities and mass, copied out of the storage for the
+  // length of a constraint
+  struct SolverBody {
+    glm::vec3 linear;
+    glm::vec3 angular;
+    glm::vec3 push;
+    glm::vec3 turn;
+    float inverse_mass;
+    glm::mat3 inverse_inertia;
+
+    SolverBody(const RigidBodyStorage &bodies, int index)
+        : linear(bodies.linear_velocities[index]), angular(bodies.angular_velocities[index]),
+          push(bodies.push_velocities[index]), turn(bodies.turn_velocities[index]),
+          inverse_mass(bodies.inverse_masses[index]), inverse_inertia(bodies.inverse_inertias[index]) {}
+
+    // Impulses can't move a static body, and one static body (the ground)
+    // is shared by constraints solved on different threads, so it is only
+    // ever read
+    void store(RigidBodyStorage &bodies, int index) const {
+      if (inverse_mass == 0.0f) {
+        return;
+      }
+      bodies.linear_velocities[index] = linear;
+      bodies.angular_velocities[index] = angular;
+      bodies.push_velocities[index] = push;
+      bodies.turn_velocities[index] = turn;
+    }
+  };
+
+  static float effective_mass(const glm::mat3 &inertiaA, const glm::mat3 &inertiaB, glm::vec3 rA, glm::vec3 rB,
+                              glm::vec3 direction, float massSum) {
+    glm::vec3 armA = glm::cross(rA, direction);
+    glm::vec3 armB = glm::cross(rB, direction);
+    float k = massSum + glm::dot(armA, inertiaA * armA) + glm::dot(armB, inertiaB * armB);
+    return k > 0.0f ? 1.0f / k : 0.0f;
+  }
+
+  // B's velocity at the point relative to A's
+  static glm::vec3 relative_velocity(const SolverBody &bodyA, const SolverBody &bodyB, glm::vec3 rA, glm::vec3 rB) {
+    return bodyB.linear + glm::cross(bodyB.angular, rB) - bodyA.linear - glm::cross(bodyA.angular, rA);
+  }
+
+  static glm::vec3 relative_push_velocity(const SolverBody &bodyA, const SolverBody &bodyB,
+                                          const ContactConstraintPoint &point) {
+    return bodyB.push + glm::cross(bodyB.turn, point.r_b) - bodyA.push - glm::cross(bodyA.turn, point.r_a);
+  }
+
+  // impulse pushes B along it and A against it
+  static void apply(SolverBody &bodyA, SolverBody &bodyB, glm::vec3 rA, glm::vec3 rB, glm::vec3 impulse) {
+    bodyA.linear -= impulse * bodyA.inverse_mass;
+    bodyA.angular -= bodyA.inverse_inertia * glm::cross(rA, impulse);
+    bodyB.linear += impulse * bodyB.inverse_mass;
+    bodyB.angular += bodyB.inverse_inertia * glm::cross(rB, impulse);
+  }
+
+  // an angular impulse, turning B along it and A against it
+  static void twist(SolverBody &bodyA, SolverBody &bodyB, glm::vec3 impulse) {
+    bodyA.angular -= bodyA.inverse_inertia * impulse;
+    bodyB.angular += bodyB.inverse_inertia * impulse;
+  }
+
+  static void push(SolverBody &bodyA, SolverBody &bodyB, const ContactConstraintPoint &point, glm::vec3 impulse) {
+    bodyA.push -= impulse * bodyA.inverse_mass;
+    bodyA.turn -= bodyA.inverse_inertia * glm::cross(point.r_a, impulse);
+    bodyB.push += impulse * bodyB.inverse_mass;
+    bodyB.turn += bodyB.inverse_inertia * glm::cross(point.r_b, impulse);
+  }
+};
+
+#endif
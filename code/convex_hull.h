@@ -0,0 +1,325 @@
+#ifndef CONVEX_HULL_H_
+#define CONVEX_HULL_H_
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <float.h>
+#include <math.h>
+#include <glm/glm.hpp>
+
+#include "simd_support.h"
+
+// Hulls with fewer vertices than this are cheaper to scan than to walk
+#define HILL_CLIMB_MIN_VERTICES 32
+// Below this the SIMD setup and reduction cost more than the scan saves
+#define SIMD_SUPPORT_MIN_VERTICES 16
+
+// A convex polyhedron built once from a triangle soup (every 3 vertices is a
+// triangle, like the arrays we hand to the renderer). Duplicate vertices are
+// welded together and coplanar triangles are merged into polygon faces, so a
+// cube ends up with 8 vertices, 6 faces and 12 edges instead of 36 soup
+// vertices. Collision queries run against this, the renderer keeps the soup.
+//
+// NOTE: The soup is assumed to already be convex, nothing here computes a
+// hull from a random point cloud.
+class ConvexHull {
+public:
+  struct Face {
+    // outward facing plane, dot(normal, p) == distance for points on the face
+    glm::vec3 normal;
+    float distance;
+    // counter clockwise (seen from outside) loop in face_vertices
+    int first;
+    int count;
+  };
+
+  struct Edge {
+    int vertex[2];
+    int face[2];
+  };
+
+  std::vector<glm::vec3> vertices;
+  std::vector<Face> faces;
+  std::vector<int> face_vertices;
+  std::vector<Edge> edges;
+  // vertex i's neighbours are adjacency[adjacency_offsets[i]] up to
+  // adjacency[adjacency_offsets[i+1]]
+  std::vector<int> adjacency_offsets;
+  std::vector<int> adjacency;
+  // the vertices again in SIMD_BLOCK_LANES wide x/y/z blocks for the
+  // vectorized support scan. Lanes past the last vertex repeat vertex 0.
+  std::vector<float> vertex_blocks;
+  // average of the welded vertices, in model space
+  glm::vec3 centroid = glm::vec3(0.0f, 0.0f, 0.0f);
+  // support_index walks the adjacency graph instead of scanning every vertex
+  // once the hull has at least this many vertices
+  int hill_climb_min_vertices = HILL_CLIMB_MIN_VERTICES;
+  // how linear_support_index scans, the best path this CPU has once the hull
+  // has at least SIMD_SUPPORT_MIN_VERTICES vertices
+  SupportPath support_path = SUPPORT_SCALAR;
+
+  ConvexHull(const glm::vec3 soup[], int soup_size, float weld_tolerance = 1e-4f) {
+    build(soup, soup_size, weld_tolerance);
+  }
+
+  // soup given as x, y, z floats, the way it is uploaded to the GPU
+  ConvexHull(const float soup_floats[], int float_count, float weld_tolerance = 1e-4f) {
+    std::vector<glm::vec3> soup;
+    for (int i = 0; i + 2 < float_count; i += 3) {
+      soup.push_back(glm::vec3(soup_floats[i], soup_floats[i+1], soup_floats[i+2]));
+    }
+    build(&soup[0], (int)soup.size(), weld_tolerance);
+  }
+
+  // hint is the vertex the previous query on this hull ended on (or NULL).
+  // Queries from one GJK iteration/frame to the next are very close, so
+  // starting the walk there usually only costs a step or two.
+  int support_index(glm::vec3 direction, int *hint = NULL) const {
+    int index;
+    if ((int)vertices.size() < hill_climb_min_vertices) {
+      index = linear_support_index(direction);
+    }
+    else {
+      index = hill_climb_support_index(direction, hint ? *hint : 0);
+    }
+    if (hint) {
+      *hint = index;
+    }
+    return index;
+  }
+
+  glm::vec3 support(glm::vec3 direction, int *hint = NULL) const {
+    return vertices[support_index(direction, hint)];
+  }
+
+  int block_count() const {
+    return (int)vertex_blocks.size() / SIMD_BLOCK_FLOATS;
+  }
+
+  int linear_support_index(glm::vec3 direction) const {
+    return linear_support_index(direction, support_path);
+  }
+
+  // path picks the scalar loop or one of the SIMD scans over vertex_blocks,
+  // they all return the same vertex
+  int linear_support_index(glm::vec3 direction, SupportPath path) const {
+    if (path == SUPPORT_SCALAR) {
+      return scalar_support_index(direction);
+    }
+    return simd_support_index(direction, path);
+  }
+
+  int scalar_support_index(glm::vec3 direction) const {
+    float furthestDistance = -FLT_MAX;
+    int furthestIndex = 0;
+
+    for (int i = 0; i < (int)vertices.size(); i++) {
+      float distance = glm::dot(vertices[i], direction);
+      if (distance > furthestDistance) {
+        furthestDistance = distance;
+        furthestIndex = i;
+      }
+    }
+    return furthestIndex;
+  }
+
+  // On a convex polyhedron a vertex that none of its edge neighbours beat is
+  // the global maximum, so keep moving to the best neighbour until that is
+  // the case. Strictly greater keeps it from cycling around a face that is
+  // perpendicular to the direction.
+  int hill_climb_support_index(glm::vec3 direction, int start) const {
+    if (start < 0 || start >= (int)vertices.size()) {
+      start = 0;
+    }
+    int current = start;
+    float currentDistance = glm::dot(vertices[current], direction);
+
+    bool improved = true;
+    while (improved) {
+      improved = false;
+      int bestNeighbour = current;
+      for (int i = adjacency_offsets[current]; i < adjacency_offsets[current + 1]; i++) {
+        float distance = glm::dot(vertices[adjacency[i]], direction);
+        if (distance > currentDistance) {
+          currentDistance = distance;
+          bestNeighbour = adjacency[i];
+          improved = true;
+        }
+      }
+      current = bestNeighbour;
+    }
+    return current;
+  }
+
+private:
+  SIMD_NOINLINE int simd_support_index(glm::vec3 direction, SupportPath path) const {
+#if SIMD_SUPPORT_X86
+    if (path == SUPPORT_AVX2) {
+      return avx2BlockSupportIndex(&vertex_blocks[0], block_count(), direction);
+    }
+    if (path == SUPPORT_SSE) {
+      return sseBlockSupportIndex(&vertex_blocks[0], block_count(), direction);
+    }
+#endif
+    return scalar_support_index(direction);
+  }
+
+  void build(const glm::vec3 soup[], int soup_size, float weld_tolerance) {
+    std::vector<int> soup_to_hull(soup_size);
+    for (int i = 0; i < soup_size; i++) {
+      soup_to_hull[i] = weld(soup[i], weld_tolerance);
+    }
+
+    for (const glm::vec3 &v : vertices) {
+      centroid += v;
+    }
+    centroid /= (float)vertices.size();
+
+    // Sort the triangles into faces by their plane, keeping track of the
+    // directed edges each face is made of
+    std::vector<std::vector<std::pair<int, int>>> face_edges;
+    for (int i = 0; i + 2 < soup_size; i += 3) {
+      int a = soup_to_hull[i];
+      int b = soup_to_hull[i + 1];
+      int c = soup_to_hull[i + 2];
+      glm::vec3 n = glm::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+      float length = glm::length(n);
+      if (a == b || b == c || c == a || length < weld_tolerance * weld_tolerance) {
+        // degenerate triangle
+        continue;
+      }
+      n /= length;
+      // the soup winding isn't trusted, make the triangle counter clockwise
+      // when seen from outside
+      if (glm::dot(n, vertices[a] - centroid) < 0.0f) {
+        n = -n;
+        std::swap(b, c);
+      }
+
+      int face = find_face(n, glm::dot(n, vertices[a]), weld_tolerance);
+      if (face == -1) {
+        Face new_face;
+        new_face.normal = n;
+        new_face.distance = glm::dot(n, vertices[a]);
+        new_face.first = 0;
+        new_face.count = 0;
+        faces.push_back(new_face);
+        face_edges.push_back(std::vector<std::pair<int, int>>());
+        face = (int)faces.size() - 1;
+      }
+      add_face_edge(face_edges[face], a, b);
+      add_face_edge(face_edges[face], b, c);
+      add_face_edge(face_edges[face], c, a);
+    }
+
+    // Whatever edges are left per face form its boundary, chain them into a
+    // loop and pair them up with the neighbouring faces
+    std::map<std::pair<int, int>, int> edge_lookup;
+    for (int f = 0; f < (int)faces.size(); f++) {
+      std::vector<std::pair<int, int>> &boundary = face_edges[f];
+      faces[f].first = (int)face_vertices.size();
+      faces[f].count = (int)boundary.size();
+
+      int current = boundary[0].first;
+      for (size_t i = 0; i < boundary.size(); i++) {
+        face_vertices.push_back(current);
+        for (const std::pair<int, int> &e : boundary) {
+          if (e.first == current) {
+            current = e.second;
+            break;
+          }
+        }
+      }
+
+      for (const std::pair<int, int> &e : boundary) {
+        std::pair<int, int> key(glm::min(e.first, e.second), glm::max(e.first, e.second));
+        std::map<std::pair<int, int>, int>::iterator found = edge_lookup.find(key);
+        if (found == edge_lookup.end()) {
+          Edge edge;
+          edge.vertex[0] = key.first;
+          edge.vertex[1] = key.second;
+          edge.face[0] = f;
+          edge.face[1] = -1;
+          edge_lookup[key] = (int)edges.size();
+          edges.push_back(edge);
+        }
+        else {
+          edges[found->second].face[1] = f;
+        }
+      }
+    }
+
+    build_adjacency();
+    build_vertex_blocks();
+    if ((int)vertices.size() >= SIMD_SUPPORT_MIN_VERTICES) {
+      support_path = activeSupportPath();
+    }
+  }
+
+  int weld(glm::vec3 v, float tolerance) {
+    for (int i = 0; i < (int)vertices.size(); i++) {
+      glm::vec3 d = vertices[i] - v;
+      if (glm::dot(d, d) <= tolerance * tolerance) {
+        return i;
+      }
+    }
+    vertices.push_back(v);
+    return (int)vertices.size() - 1;
+  }
+
+  int find_face(glm::vec3 normal, float distance, float tolerance) {
+    for (int i = 0; i < (int)faces.size(); i++) {
+      if (glm::dot(faces[i].normal, normal) > 1.0f - tolerance
+          && fabsf(faces[i].distance - distance) < tolerance) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // An edge shared by two triangles of the same face is inside the face, so
+  // the twin cancels it out instead of being added
+  void add_face_edge(std::vector<std::pair<int, int>> &face_edges, int from, int to) {
+    for (size_t i = 0; i < face_edges.size(); i++) {
+      if (face_edges[i].first == to && face_edges[i].second == from) {
+        face_edges.erase(face_edges.begin() + i);
+        return;
+      }
+    }
+    face_edges.push_back(std::make_pair(from, to));
+  }
+
+  void build_adjacency() {
+    adjacency_offsets.assign(vertices.size() + 1, 0);
+    for (const Edge &edge : edges) {
+      adjacency_offsets[edge.vertex[0] + 1]++;
+      adjacency_offsets[edge.vertex[1] + 1]++;
+    }
+    for (size_t i = 1; i < adjacency_offsets.size(); i++) {
+      adjacency_offsets[i] += adjacency_offsets[i - 1];
+    }
+
+    adjacency.resize(edges.size() * 2);
+    std::vector<int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (const Edge &edge : edges) {
+      adjacency[fill[edge.vertex[0]]++] = edge.vertex[1];
+      adjacency[fill[edge.vertex[1]]++] = edge.vertex[0];
+    }
+  }
+
+  void build_vertex_blocks() {
+    int blocks = ((int)vertices.size() + SIMD_BLOCK_LANES - 1) / SIMD_BLOCK_LANES;
+    vertex_blocks.resize(blocks * SIMD_BLOCK_FLOATS);
+    for (int i = 0; i < blocks * SIMD_BLOCK_LANES; i++) {
+      const glm::vec3 &v = vertices[i < (int)vertices.size() ? i : 0];
+      float *block = &vertex_blocks[(i / SIMD_BLOCK_LANES) * SIMD_BLOCK_FLOATS];
+      int lane = i % SIMD_BLOCK_LANES;
+      block[lane] = v.x;
+      block[SIMD_BLOCK_LANES + lane] = v.y;
+      block[2 * SIMD_BLOCK_LANES + lane] = v.z;
+    }
+  }
+};
+
+#endif
@@ -9,71 +9,58 @@ public:
   static const int VERTICES_NUM_VEC3 = 36;
   static const int VERTICES_NUM_FLOAT = VERTICES_NUM_VEC3 * 3;
 
-  Cube(glm::vec3 cubePos) {
-    pos = cubePos;
-    size = &VERTICES_NUM_VEC3;
-    // TODO: This might be able to be templated fn???
-    model_vertices = new glm::vec3[VERTICES_NUM_VEC3];
-    world_vertices = new glm::vec3[VERTICES_NUM_VEC3];
-    fill_vec3_arr(model_vertices_float, VERTICES_NUM_FLOAT);
-    gen_and_bind_vao_vbo();
-    to_world_vertices(VERTICES_NUM_VEC3);
-  }
-
-  void gen_and_bind_vao_vbo() {
-    Shape::gen_and_bind_vao_vbo();
-    glBufferData(GL_ARRAY_BUFFER, sizeof(model_vertices_float), model_vertices_float, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+  // model space triangle soup the "cube" geometry is registered from
+  static float model_vertices_float[VERTICES_NUM_FLOAT];
 
-    glBindVertexArray(0);
+  Cube(glm::vec3 cubePos) {
+    type = SHAPE_CUBE;
+    transform.position = cubePos;
+    geometry = geometry_registry().acquire("cube", model_vertices_float, VERTICES_NUM_FLOAT);
   }
+};
 
-private:
-
-  float model_vertices_float[VERTICES_NUM_FLOAT] = {
-    // positions
-    -0.5f, -0.5f, -0.5f,
-     0.5f, -0.5f, -0.5f,
-     0.5f,  0.5f, -0.5f,
-     0.5f,  0.5f, -0.5f,
-    -0.5f,  0.5f, -0.5f,
-    -0.5f, -0.5f, -0.5f,
+float Cube::model_vertices_float[Cube::VERTICES_NUM_FLOAT] = {
+  // positions
+  -0.5f, -0.5f, -0.5f,
+   0.5f, -0.5f, -0.5f,
+   0.5f,  0.5f, -0.5f,
+   0.5f,  0.5f, -0.5f,
+  -0.5f,  0.5f, -0.5f,
+  -0.5f, -0.5f, -0.5f,
 
-    -0.5f, -0.5f,  0.5f,
-     0.5f, -0.5f,  0.5f,
-     0.5f,  0.5f,  0.5f,
-     0.5f,  0.5f,  0.5f,
-    -0.5f,  0.5f,  0.5f,
-    -0.5f, -0.5f,  0.5f,
+  -0.5f, -0.5f,  0.5f,
+   0.5f, -0.5f,  0.5f,
+   0.5f,  0.5f,  0.5f,
+   0.5f,  0.5f,  0.5f,
+  -0.5f,  0.5f,  0.5f,
+  -0.5f, -0.5f,  0.5f,
 
-    -0.5f,  0.5f,  0.5f,
-    -0.5f,  0.5f, -0.5f,
-    -0.5f, -0.5f, -0.5f,
-    -0.5f, -0.5f, -0.5f,
-    -0.5f, -0.5f,  0.5f,
-    -0.5f,  0.5f,  0.5f,
+  -0.5f,  0.5f,  0.5f,
+  -0.5f,  0.5f, -0.5f,
+  -0.5f, -0.5f, -0.5f,
+  -0.5f, -0.5f, -0.5f,
+  -0.5f, -0.5f,  0.5f,
+  -0.5f,  0.5f,  0.5f,
 
-     0.5f,  0.5f,  0.5f,
-     0.5f,  0.5f, -0.5f,
-     0.5f, -0.5f, -0.5f,
-     0.5f, -0.5f, -0.5f,
-     0.5f, -0.5f,  0.5f,
-     0.5f,  0.5f,  0.5f,
+   0.5f,  0.5f,  0.5f,
+   0.5f,  0.5f, -0.5f,
+   0.5f, -0.5f, -0.5f,
+   0.5f, -0.5f, -0.5f,
+   0.5f, -0.5f,  0.5f,
+   0.5f,  0.5f,  0.5f,
 
-    -0.5f, -0.5f, -0.5f,
-     0.5f, -0.5f, -0.5f,
-     0.5f, -0.5f,  0.5f,
-     0.5f, -0.5f,  0.5f,
-    -0.5f, -0.5f,  0.5f,
-    -0.5f, -0.5f, -0.5f,
+  -0.5f, -0.5f, -0.5f,
+   0.5f, -0.5f, -0.5f,
+   0.5f, -0.5f,  0.5f,
+   0.5f, -0.5f,  0.5f,
+  -0.5f, -0.5f,  0.5f,
+  -0.5f, -0.5f, -0.5f,
 
-    -0.5f,  0.5f, -0.5f,
-     0.5f,  0.5f, -0.5f,
-     0.5f,  0.5f,  0.5f,
-     0.5f,  0.5f,  0.5f,
-    -0.5f,  0.5f,  0.5f,
-    -0.5f,  0.5f, -0.5f
-  };
+  -0.5f,  0.5f, -0.5f,
+   0.5f,  0.5f, -0.5f,
+   0.5f,  0.5f,  0.5f,
+   0.5f,  0.5f,  0.5f,
+  -0.5f,  0.5f,  0.5f,
+  -0.5f,  0.5f, -0.5f
 };
 #endif
@@ -0,0 +1,36 @@
+#ifndef CYLINDER_H_
+#define CYLINDER_H_
+
+#include <math.h>
+#include "shape.h"
+
+// Cylinder around the model space y axis, from -half_height to half_height
+class Cylinder : public Shape {
+public:
+  float half_height;
+  float radius;
+
+  Cylinder(glm::vec3 cylinderPos, float cylinderHalfHeight, float cylinderRadius)
+      : half_height(cylinderHalfHeight), radius(cylinderRadius) {
+    type = SHAPE_CYLINDER;
+    transform.position = cylinderPos;
+  }
+
+  glm::vec3 local_centroid() const override {
+    return glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+
+  // The rim point of whichever cap faces direction
+  glm::vec3 local_support(glm::vec3 direction, int *index) const override {
+    *index = -1;
+    float y = direction.y >= 0.0f ? half_height : -half_height;
+    float sigma = sqrtf(direction.x * direction.x + direction.z * direction.z);
+    if (sigma <= 0.0f) {
+      return glm::vec3(0.0f, y, 0.0f);
+    }
+    float scale = radius / sigma;
+    return glm::vec3(direction.x * scale, y, direction.z * scale);
+  }
+};
+
+#endif
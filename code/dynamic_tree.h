@@ -0,0 +1,454 @@
+#ifndef DYNAMIC_TREE_H_
+#define DYNAMIC_TREE_H_
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <glm/glm.hpp>
+
+#include "broadphase.h"
+
+#define TREE_NULL -1
+// Leaves hold the body's box grown by this on every side, so a body can
+// move this far before it has to be reinserted
+#define TREE_AABB_MARGIN 0.1f
+// and grown by this many times the last displacement in the direction the
+// body is moving
+#define TREE_DISPLACEMENT_MULTIPLIER 2.0f
+
+// One cache line per node, the nodes live in one array and link to each
+// other by index. Free nodes are chained through parent.
+struct TreeNode {
+  // fat box for a leaf, the union of the children for an internal node
+  Aabb box;
+  int parent;
+  int child1;
+  int child2;
+  // leaves are 0, free nodes -1
+  int height;
+  // the leaf's body, -1 for internal nodes
+  int body;
+  int padding[5];
+
+  bool is_leaf() const {
+    return child1 == TREE_NULL;
+  }
+};
+
+static_assert(sizeof(TreeNode) == 64, "TreeNode should fill one cache line");
+
+// Dynamic bounding volume hierarchy (Box2D's b2DynamicTree, with the
+// insertion and rotations of Erin Catto's GDC 2019 talk). Leaves are fat
+// boxes, slowly moving bodies stay inside theirs for many steps and only
+// the ones that leave it are taken out and inserted again. Insertion
+// descends towards the sibling that adds the least surface area (the SAH
+// cost), and every node on the way back up tries swapping a child with a
+// grandchild when that shrinks the tree. Pairs are kept between steps like
+// Box2D's broadphase does, see find_pairs.
+class DynamicTree : public Broadphase {
+public:
+  // leaves the last update() had to reinsert
+  int reinserted = 0;
+
+  const char *name() const override {
+    return "tree";
+  }
+
+  void update(const std::vector<Aabb> &boxes) override {
+    if ((int)boxes.size() != (int)leaves.size()) {
+      rebuild(boxes);
+    }
+    else {
+      for (int i = 0; i < (int)boxes.size(); i++) {
+        move(i, boxes[i]);
+      }
+    }
+    reinserted = (int)moved_bodies.size();
+    find_pairs(boxes);
+  }
+
+  // The leaves of bodies that aren't moving aren't even checked against
+  // their fat boxes
+  void update_moving(const std::vector<Aabb> &boxes, const std::vector<int> &moving) override {
+    if ((int)boxes.size() != (int)leaves.size()) {
+      rebuild(boxes);
+    }
+    else {
+      for (int body : moving) {
+        move(body, boxes[body]);
+      }
+    }
+    reinserted = (int)moved_bodies.size();
+    find_pairs(boxes);
+  }
+
+  // Starts over with a leaf per box
+  void rebuild(const std::vector<Aabb> &boxes) {
+    nodes.clear();
+    free_list = TREE_NULL;
+    root = TREE_NULL;
+    fat_pairs.clear();
+    leaves.assign(boxes.size(), TREE_NULL);
+    moved.assign(boxes.size(), 1);
+    moved_bodies.clear();
+    for (int i = 0; i < (int)boxes.size(); i++) {
+      int leaf = allocate_node();
+      nodes[leaf].box = fatten(boxes[i], glm::vec3(0.0f, 0.0f, 0.0f));
+      nodes[leaf].height = 0;
+      nodes[leaf].body = i;
+      leaves[i] = leaf;
+      insert_leaf(leaf);
+      moved_bodies.push_back(i);
+    }
+  }
+
+  // Moves body's leaf if its box left the fat one, returns whether it did
+  bool move(int body, const Aabb &box) {
+    int leaf = leaves[body];
+    if (nodes[leaf].box.contains(box)) {
+      return false;
+    }
+    glm::vec3 displacement = box.centre() - nodes[leaf].box.centre();
+    remove_leaf(leaf);
+    nodes[leaf].box = fatten(box, displacement);
+    insert_leaf(leaf);
+    if (!moved[body]) {
+      moved[body] = 1;
+      moved_bodies.push_back(body);
+    }
+    return true;
+  }
+
+  void pairs(std::vector<BroadphasePair> &out) const override {
+    out = current_pairs;
+  }
+
+  // Calls visit(body) for every leaf whose fat box overlaps box
+  template <class Visit>
+  void query(const Aabb &box, Visit visit) const {
+    if (root == TREE_NULL) {
+      return;
+    }
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+      const TreeNode &node = nodes[stack.back()];
+      stack.pop_back();
+      if (!node.box.overlaps(box)) {
+        continue;
+      }
+      if (node.is_leaf()) {
+        visit(node.body);
+      }
+      else {
+        stack.push_back(node.child1);
+        stack.push_back(node.child2);
+      }
+    }
+  }
+
+  // Calls visit(body, entry) for the leaves the ray from origin along the unit
+  // direction enters before maxDistance, nearer children first. visit
+  // returns how far the ray still needs to go, the entry distance of a hit
+  // it found keeps only nearer leaves coming.
+  template <class Visit>
+  void raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, Visit visit) const {
+    if (root == TREE_NULL) {
+      return;
+    }
+    glm::vec3 inverseDirection = 1.0f / direction;
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+      const TreeNode &node = nodes[stack.back()];
+      stack.pop_back();
+      float entry;
+      if (!rayAabb(node.box, origin, inverseDirection, maxDistance, &entry)) {
+        continue;
+      }
+      if (node.is_leaf()) {
+        maxDistance = visit(node.body, entry);
+        continue;
+      }
+      float entry1, entry2;
+      bool hit1 = rayAabb(nodes[node.child1].box, origin, inverseDirection, maxDistance, &entry1);
+      bool hit2 = rayAabb(nodes[node.child2].box, origin, inverseDirection, maxDistance, &entry2);
+      // pushed last is popped first
+      if (hit1 && hit2 && entry1 < entry2) {
+        stack.push_back(node.child2);
+        stack.push_back(node.child1);
+      }
+      else {
+        if (hit1) {
+          stack.push_back(node.child1);
+        }
+        if (hit2) {
+          stack.push_back(node.child2);
+        }
+      }
+    }
+  }
+
+  int height() const {
+    return (root == TREE_NULL) ? 0 : nodes[root].height;
+  }
+
+  // Sum of the internal nodes' surface areas over the root's, what the SAH
+  // tries to keep low
+  float area_ratio() const {
+    if (root == TREE_NULL) {
+      return 0.0f;
+    }
+    float area = 0.0f;
+    for (const TreeNode &node : nodes) {
+      if (node.height > 0) {
+        area += node.box.surface_area();
+      }
+    }
+    return area / nodes[root].box.surface_area();
+  }
+
+private:
+  std::vector<TreeNode> nodes;
+  int root = TREE_NULL;
+  int free_list = TREE_NULL;
+  // body -> leaf node
+  std::vector<int> leaves;
+  // bodies reinserted since pairs were last found
+  std::vector<char> moved;
+  std::vector<int> moved_bodies;
+  // pairs whose fat boxes overlap, sorted
+  std::vector<BroadphasePair> fat_pairs;
+  std::vector<BroadphasePair> kept_pairs;
+  std::vector<BroadphasePair> found_pairs;
+  std::vector<BroadphasePair> current_pairs;
+  std::vector<BroadphasePair> previous_pairs;
+  mutable std::vector<int> stack;
+
+  static Aabb fatten(const Aabb &box, glm::vec3 displacement) {
+    glm::vec3 margin = glm::vec3(TREE_AABB_MARGIN, TREE_AABB_MARGIN, TREE_AABB_MARGIN);
+    Aabb fat(box.min - margin, box.max + margin);
+    glm::vec3 ahead = displacement * TREE_DISPLACEMENT_MULTIPLIER;
+    fat.min += glm::min(ahead, glm::vec3(0.0f, 0.0f, 0.0f));
+    fat.max += glm::max(ahead, glm::vec3(0.0f, 0.0f, 0.0f));
+    return fat;
+  }
+
+  int allocate_node() {
+    int index;
+    if (free_list != TREE_NULL) {
+      index = free_list;
+      free_list = nodes[index].parent;
+    }
+    else {
+      index = (int)nodes.size();
+      nodes.push_back(TreeNode());
+    }
+    TreeNode &node = nodes[index];
+    node.parent = TREE_NULL;
+    node.child1 = TREE_NULL;
+    node.child2 = TREE_NULL;
+    node.height = 0;
+    node.body = -1;
+    return index;
+  }
+
+  void free_node(int index) {
+    nodes[index].parent = free_list;
+    nodes[index].height = -1;
+    free_list = index;
+  }
+
+  void insert_leaf(int leaf) {
+    if (root == TREE_NULL) {
+      root = leaf;
+      nodes[leaf].parent = TREE_NULL;
+      return;
+    }
+
+    // Greedy descent: stop where making the leaf a sibling of this node
+    // costs less than the cheapest child could. Every ancestor of the new
+    // node grows by the same inherited area either way.
+    Aabb box = nodes[leaf].box;
+    int index = root;
+    while (!nodes[index].is_leaf()) {
+      const TreeNode &node = nodes[index];
+      float area = node.box.surface_area();
+      float combinedArea = aabbUnion(node.box, box).surface_area();
+      float cost = 2.0f * combinedArea;
+      float inherited = 2.0f * (combinedArea - area);
+      float cost1 = descend_cost(node.child1, box) + inherited;
+      float cost2 = descend_cost(node.child2, box) + inherited;
+      if (cost < cost1 && cost < cost2) {
+        break;
+      }
+      index = (cost1 < cost2) ? node.child1 : node.child2;
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocate_node();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = aabbUnion(box, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    if (oldParent == TREE_NULL) {
+      root = newParent;
+    }
+    else if (nodes[oldParent].child1 == sibling) {
+      nodes[oldParent].child1 = newParent;
+    }
+    else {
+      nodes[oldParent].child2 = newParent;
+    }
+
+    refit(nodes[leaf].parent);
+  }
+
+  // What going down into child adds: the whole new box for a leaf (it gets a
+  // new parent), only the growth for an internal node
+  float descend_cost(int child, const Aabb &box) const {
+    float combinedArea = aabbUnion(nodes[child].box, box).surface_area();
+    if (nodes[child].is_leaf()) {
+      return combinedArea;
+    }
+    return combinedArea - nodes[child].box.surface_area();
+  }
+
+  void remove_leaf(int leaf) {
+    if (leaf == root) {
+      root = TREE_NULL;
+      return;
+    }
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+    free_node(parent);
+    nodes[sibling].parent = grandParent;
+    if (grandParent == TREE_NULL) {
+      root = sibling;
+      return;
+    }
+    if (nodes[grandParent].child1 == parent) {
+      nodes[grandParent].child1 = sibling;
+    }
+    else {
+      nodes[grandParent].child2 = sibling;
+    }
+    refit(grandParent);
+  }
+
+  // Walks up from index fixing boxes and heights, rotating on the way
+  void refit(int index) {
+    while (index != TREE_NULL) {
+      rotate(index);
+      TreeNode &node = nodes[index];
+      node.box = aabbUnion(nodes[node.child1].box, nodes[node.child2].box);
+      node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+      index = node.parent;
+    }
+  }
+
+  // Tries the four swaps of one of index's children with a grandchild
+  // under the other child and makes the one that shrinks the changed child's
+  // box the most, if any does
+  void rotate(int index) {
+    int b = nodes[index].child1;
+    int c = nodes[index].child2;
+    float bestSaving = 0.0f;
+    // the child that moves down and the grandchild it swaps with
+    int moveDown = TREE_NULL;
+    int moveUp = TREE_NULL;
+    const int children[2] = {b, c};
+    for (int k = 0; k < 2; k++) {
+      int child = children[k];
+      int other = children[1 - k];
+      if (nodes[child].is_leaf()) {
+        continue;
+      }
+      float area = nodes[child].box.surface_area();
+      int grandChildren[2] = {nodes[child].child1, nodes[child].child2};
+      for (int g = 0; g < 2; g++) {
+        // other takes grandChildren[g]'s place next to its sibling
+        Aabb swapped = aabbUnion(nodes[other].box, nodes[grandChildren[1 - g]].box);
+        float saving = area - swapped.surface_area();
+        if (saving > bestSaving) {
+          bestSaving = saving;
+          moveDown = other;
+          moveUp = grandChildren[g];
+        }
+      }
+    }
+    if (moveDown == TREE_NULL) {
+      return;
+    }
+
+    int child = nodes[moveUp].parent;
+    if (nodes[index].child1 == moveDown) {
+      nodes[index].child1 = moveUp;
+    }
+    else {
+      nodes[index].child2 = moveUp;
+    }
+    if (nodes[child].child1 == moveUp) {
+      nodes[child].child1 = moveDown;
+    }
+    else {
+      nodes[child].child2 = moveDown;
+    }
+    nodes[moveUp].parent = index;
+    nodes[moveDown].parent = child;
+    TreeNode &changed = nodes[child];
+    changed.box = aabbUnion(nodes[changed.child1].box, nodes[changed.child2].box);
+    changed.height = 1 + std::max(nodes[changed.child1].height, nodes[changed.child2].height);
+  }
+
+  // Fat boxes only change when a leaf is reinserted, so a fat pair of two
+  // leaves that stayed put still overlaps and only the reinserted leaves
+  // query the tree again. The pairs are the fat pairs whose tight boxes
+  // overlap too, added and removed the difference to last step.
+  void find_pairs(const std::vector<Aabb> &boxes) {
+    kept_pairs.clear();
+    for (const BroadphasePair &pair : fat_pairs) {
+      if (!moved[pair.a] && !moved[pair.b]) {
+        kept_pairs.push_back(pair);
+      }
+    }
+    found_pairs.clear();
+    for (int body : moved_bodies) {
+      query(nodes[leaves[body]].box, [&](int other) {
+        // a pair of two moved bodies is found from both, keep one
+        if (other != body && (!moved[other] || other > body)) {
+          found_pairs.push_back(broadphasePair(body, other));
+        }
+      });
+    }
+    std::sort(found_pairs.begin(), found_pairs.end());
+    fat_pairs.clear();
+    std::merge(kept_pairs.begin(), kept_pairs.end(), found_pairs.begin(), found_pairs.end(),
+               std::back_inserter(fat_pairs));
+    for (int body : moved_bodies) {
+      moved[body] = 0;
+    }
+    moved_bodies.clear();
+
+    previous_pairs.swap(current_pairs);
+    current_pairs.clear();
+    for (const BroadphasePair &pair : fat_pairs) {
+      if (boxes[pair.a].overlaps(boxes[pair.b])) {
+        current_pairs.push_back(pair);
+      }
+    }
+    added.clear();
+    removed.clear();
+    std::set_difference(current_pairs.begin(), current_pairs.end(), previous_pairs.begin(),
+                        previous_pairs.end(), std::back_inserter(added));
+    std::set_difference(previous_pairs.begin(), previous_pairs.end(), current_pairs.begin(),
+                        current_pairs.end(), std::back_inserter(removed));
+  }
+};
+
+#endif
@@ -0,0 +1,348 @@
+#ifndef EPA_H_
+#define EPA_H_
+
+#include <float.h>
+#include <math.h>
+#include <utility>
+#include <glm/glm.hpp>
+
+#include "gjk.h"
+
+// Pool sizes for the polytope, a query never grows past these. Running out
+// just ends the query early with the best face found so far.
+#define EPA_MAX_VERTICES 64
+#define EPA_MAX_FACES 128
+#define EPA_MAX_HORIZON_EDGES 64
+#define EPA_MAX_ITERATIONS 48
+// stop once a support point gets less than this much further than the
+// closest face
+#define EPA_TOLERANCE 1e-4f
+// how far outside a face of the starting tetrahedron the origin may be and
+// still count as touching it, and how many vertices completing the simplex
+// may swap to get the origin inside
+#define EPA_CONTAINMENT_TOLERANCE 1e-6f
+#define EPA_MAX_CONTAINMENT_STEPS 8
+
+struct EpaResult {
+  // unit normal pointing from shape A towards shape B, moving B along it by
+  // depth (or A against it) separates the shapes
+  glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+  float depth = 0.0f;
+  // deepest point of A inside B and deepest point of B inside A,
+  // point_a - point_b == normal * depth
+  glm::vec3 point_a = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 point_b = glm::vec3(0.0f, 0.0f, 0.0f);
+  int iterations = 0;
+};
+
+// Fixed size pools the polytope is built in, so an EPA query makes no heap
+// allocations. epa() puts one on the stack unless it is handed one to reuse.
+struct EpaWorkspace {
+  struct Vertex {
+    // a - b, and a, like the Simplex
+    glm::vec3 point;
+    glm::vec3 point_a;
+  };
+
+  struct Face {
+    int v[3];
+    // outward unit normal and distance of the plane from the origin
+    glm::vec3 normal;
+    float distance;
+  };
+
+  struct Edge {
+    int v[2];
+  };
+
+  Vertex vertices[EPA_MAX_VERTICES];
+  Face faces[EPA_MAX_FACES];
+  Edge horizon[EPA_MAX_HORIZON_EDGES];
+  int vertex_count;
+  int face_count;
+  int horizon_count;
+
+  void clear() {
+    vertex_count = 0;
+    face_count = 0;
+    horizon_count = 0;
+  }
+
+  int add_vertex(glm::vec3 point, glm::vec3 point_a) {
+    if (vertex_count == EPA_MAX_VERTICES) {
+      return -1;
+    }
+    vertices[vertex_count].point = point;
+    vertices[vertex_count].point_a = point_a;
+    return vertex_count++;
+  }
+
+  bool add_face(int a, int b, int c) {
+    if (face_count == EPA_MAX_FACES) {
+      return false;
+    }
+    Face &face = faces[face_count];
+    face.v[0] = a;
+    face.v[1] = b;
+    face.v[2] = c;
+    glm::vec3 pa = vertices[a].point;
+    glm::vec3 n = glm::cross(vertices[b].point - pa, vertices[c].point - pa);
+    float length = glm::length(n);
+    if (length <= 1e-12f) {
+      // sliver, keep it in the polytope but never pick it as the closest
+      face.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+      face.distance = FLT_MAX;
+    }
+    else {
+      face.normal = n / length;
+      face.distance = glm::dot(face.normal, pa);
+    }
+    face_count++;
+    return true;
+  }
+
+  void remove_face(int i) {
+    faces[i] = faces[face_count - 1];
+    face_count--;
+  }
+
+  // Edges of the faces being removed that only one of them uses are the
+  // horizon, an edge seen twice (once each way) is inside the hole
+  bool add_horizon_edge(int a, int b) {
+    for (int i = 0; i < horizon_count; i++) {
+      if (horizon[i].v[0] == b && horizon[i].v[1] == a) {
+        horizon[i] = horizon[horizon_count - 1];
+        horizon_count--;
+        return true;
+      }
+    }
+    if (horizon_count == EPA_MAX_HORIZON_EDGES) {
+      return false;
+    }
+    horizon[horizon_count].v[0] = a;
+    horizon[horizon_count].v[1] = b;
+    horizon_count++;
+    return true;
+  }
+
+  int closest_face() const {
+    int closest = 0;
+    for (int i = 1; i < face_count; i++) {
+      if (faces[i].distance < faces[closest].distance) {
+        closest = i;
+      }
+    }
+    return closest;
+  }
+};
+
+// Index of the tetrahedron vertex opposite a face the origin is outside of,
+// -1 when the origin is inside every face (or on one). normal gets that
+// face's outward normal.
+int epaOutsideFace(const Simplex &simplex, glm::vec3 &normal) {
+  for (int i = 0; i < 4; i++) {
+    const glm::vec3 &a = simplex[(i + 1) % 4];
+    const glm::vec3 &b = simplex[(i + 2) % 4];
+    const glm::vec3 &c = simplex[(i + 3) % 4];
+    glm::vec3 n = glm::cross(b - a, c - a);
+    if (glm::dot(n, simplex[i] - a) > 0.0f) {
+      n = -n;
+    }
+    float length = glm::length(n);
+    if (length <= 1e-12f) {
+      continue;
+    }
+    n /= length;
+    if (-glm::dot(n, a) > EPA_CONTAINMENT_TOLERANCE) {
+      normal = n;
+      return i;
+    }
+  }
+  return -1;
+}
+
+// GJK can stop on a point, segment or triangle when the shapes only just
+// touch. Push support points out in directions that can't lie in the current
+// simplex until it is a proper tetrahedron, then make sure it is around the
+// origin: the new points only had to leave the old simplex's span, so the
+// tetrahedron can end up beside the origin. While the origin is outside a
+// face, the vertex opposite it is swapped for the support point past that
+// face, as GJK would. Returns false when that shows the shapes apart or the
+// swaps run out.
+bool epaCompleteSimplex(const Shape &shapeA, const Shape &shapeB, Simplex &simplex) {
+  static const glm::vec3 AXES[6] = {
+    glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+  };
+
+  if (simplex.size() == 0) {
+    addSupport(simplex, shapeA, shapeB, AXES[0]);
+  }
+  if (simplex.size() == 1) {
+    for (int i = 0; i < 6 && simplex.size() == 1; i++) {
+      addSupport(simplex, shapeA, shapeB, AXES[i]);
+    }
+  }
+  if (simplex.size() == 2) {
+    glm::vec3 ab = simplex[1] - simplex[0];
+    for (int i = 0; i < 6 && simplex.size() == 2; i++) {
+      glm::vec3 direction = glm::cross(ab, AXES[i]);
+      if (glm::dot(direction, direction) > 1e-12f) {
+        addSupport(simplex, shapeA, shapeB, direction);
+      }
+    }
+  }
+  if (simplex.size() == 3) {
+    glm::vec3 n = glm::cross(simplex[1] - simplex[0], simplex[2] - simplex[0]);
+    addSupport(simplex, shapeA, shapeB, n);
+    if (simplex.size() == 3) {
+      addSupport(simplex, shapeA, shapeB, -n);
+    }
+  }
+  if (simplex.size() != 4) {
+    return false;
+  }
+
+  for (int step = 0; step <= EPA_MAX_CONTAINMENT_STEPS; step++) {
+    float volume = glm::dot(simplex[1] - simplex[0],
+                            glm::cross(simplex[2] - simplex[0], simplex[3] - simplex[0]));
+    if (fabsf(volume) <= 1e-9f) {
+      return false;
+    }
+    glm::vec3 normal;
+    int opposite = epaOutsideFace(simplex, normal);
+    if (opposite == -1) {
+      return true;
+    }
+    if (step == EPA_MAX_CONTAINMENT_STEPS) {
+      break;
+    }
+    simplex.remove(opposite);
+    // nothing of A - B past the origin along the normal means a gap, and a
+    // support point already in the simplex means the face was as far as
+    // A - B goes
+    if (!addSupport(simplex, shapeA, shapeB, normal) || simplex.size() != 4) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Expanding Polytope Algorithm: starting from GJK's tetrahedron around the
+// origin, repeatedly push the polytope face closest to the origin out to the
+// support point along its normal, until the face can't move any more. That
+// face's distance is the penetration depth and its normal the contact normal.
+//
+// simplex is the simplex gjk()/gjkDistance() ended with on an overlap.
+// Returns false when the shapes only touch and no depth can be found.
+bool epa(const Shape &shapeA, const Shape &shapeB, const Simplex &gjkSimplex,
+         EpaResult &result, EpaWorkspace *workspace = NULL) {
+  result = EpaResult();
+
+  Simplex simplex = gjkSimplex;
+  if (!epaCompleteSimplex(shapeA, shapeB, simplex)) {
+    return false;
+  }
+
+  EpaWorkspace localWorkspace;
+  EpaWorkspace &polytope = workspace ? *workspace : localWorkspace;
+  polytope.clear();
+  for (int i = 0; i < 4; i++) {
+    polytope.add_vertex(simplex.points[i], simplex.points_a[i]);
+  }
+  // wind every face so its normal points away from the opposite vertex
+  static const int FACES[4][4] = {{0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0}};
+  for (int i = 0; i < 4; i++) {
+    int a = FACES[i][0];
+    int b = FACES[i][1];
+    int c = FACES[i][2];
+    glm::vec3 n = glm::cross(simplex[b] - simplex[a], simplex[c] - simplex[a]);
+    if (glm::dot(n, simplex[FACES[i][3]] - simplex[a]) > 0.0f) {
+      std::swap(b, c);
+    }
+    polytope.add_face(a, b, c);
+  }
+
+  int closest;
+  int iterations = 0;
+  while (iterations < EPA_MAX_ITERATIONS) {
+    iterations++;
+    closest = polytope.closest_face();
+    EpaWorkspace::Face face = polytope.faces[closest];
+
+    glm::vec3 pointA = support(shapeA, face.normal);
+    glm::vec3 pointB = support(shapeB, -face.normal);
+    glm::vec3 w = pointA - pointB;
+    if (glm::dot(w, face.normal) - face.distance < EPA_TOLERANCE) {
+      break;
+    }
+
+    int newVertex = polytope.add_vertex(w, pointA);
+    if (newVertex == -1) {
+      break;
+    }
+
+    // carve out every face the new point can see and stitch the hole shut
+    // with faces fanning out from it
+    polytope.horizon_count = 0;
+    bool horizonOverflow = false;
+    for (int i = 0; i < polytope.face_count; ) {
+      EpaWorkspace::Face &f = polytope.faces[i];
+      if (glm::dot(f.normal, w - polytope.vertices[f.v[0]].point) > 0.0f) {
+        horizonOverflow |= !polytope.add_horizon_edge(f.v[0], f.v[1]);
+        horizonOverflow |= !polytope.add_horizon_edge(f.v[1], f.v[2]);
+        horizonOverflow |= !polytope.add_horizon_edge(f.v[2], f.v[0]);
+        polytope.remove_face(i);
+      }
+      else {
+        i++;
+      }
+    }
+
+    bool facesOverflow = false;
+    for (int i = 0; i < polytope.horizon_count; i++) {
+      facesOverflow |= !polytope.add_face(polytope.horizon[i].v[0], polytope.horizon[i].v[1], newVertex);
+    }
+    if (horizonOverflow || facesOverflow || polytope.face_count == 0) {
+      // the polytope is broken, fall back to the last good closest face
+      polytope.faces[0] = face;
+      polytope.face_count = 1;
+      break;
+    }
+  }
+
+  closest = polytope.closest_face();
+  const EpaWorkspace::Face &face = polytope.faces[closest];
+  if (face.distance == FLT_MAX) {
+    return false;
+  }
+
+  // barycentric coordinates of the origin projected onto the closest face
+  // carry over to the support points on A and B
+  const EpaWorkspace::Vertex &va = polytope.vertices[face.v[0]];
+  const EpaWorkspace::Vertex &vb = polytope.vertices[face.v[1]];
+  const EpaWorkspace::Vertex &vc = polytope.vertices[face.v[2]];
+  glm::vec3 p = face.normal * face.distance;
+  glm::vec3 v0 = vb.point - va.point;
+  glm::vec3 v1 = vc.point - va.point;
+  glm::vec3 v2 = p - va.point;
+  float d00 = glm::dot(v0, v0);
+  float d01 = glm::dot(v0, v1);
+  float d11 = glm::dot(v1, v1);
+  float d20 = glm::dot(v2, v0);
+  float d21 = glm::dot(v2, v1);
+  float denom = d00 * d11 - d01 * d01;
+  float v = (denom != 0.0f) ? (d11 * d20 - d01 * d21) / denom : 1.0f / 3.0f;
+  float w = (denom != 0.0f) ? (d00 * d21 - d01 * d20) / denom : 1.0f / 3.0f;
+  float u = 1.0f - v - w;
+
+  result.normal = face.normal;
+  result.depth = face.distance;
+  result.point_a = u * va.point_a + v * vb.point_a + w * vc.point_a;
+  result.point_b = result.point_a - result.normal * result.depth;
+  result.iterations = iterations;
+  return true;
+}
+
+#endif
@@ -0,0 +1,93 @@
+// Runs EPA on shapes that only touch, where GJK reports an overlap with a
+// point, segment or triangle and epaCompleteSimplex has to build the
+// tetrahedron EPA starts from. That tetrahedron has to have the origin inside
+// (or on a face), and a touch can't come out with any real depth.
+//
+//   g++ -std=c++14 -I Include code/epa_test.cpp Include/glad/glad.c -o epa_test
+//   ./epa_test
+// It exits with 1 if a check fails.
+#include <glad/glad.h>
+#include <iostream>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "cube.h"
+#include "tetrahedron.h"
+#include "epa.h"
+
+using namespace std;
+
+// a touch is at most GJK's overlap tolerance deep
+const float TOUCH_DEPTH = 1e-4f;
+
+struct TouchCase {
+  const char *name;
+  glm::vec3 offset;
+  float angle;
+};
+
+// Completes simplex and checks that the origin ended up inside it. A simplex
+// the shapes can't complete is fine, EPA then reports no depth.
+bool completesAroundOrigin(const Shape &a, const Shape &b, Simplex simplex) {
+  if (!epaCompleteSimplex(a, b, simplex)) {
+    return true;
+  }
+  glm::vec3 normal;
+  return epaOutsideFace(simplex, normal) == -1;
+}
+
+bool checkTouch(const char *name, const Shape &a, const Shape &b) {
+  Simplex simplex;
+  if (!gjk(a, b, simplex)) {
+    cout << name << ": GJK MISSED THE TOUCH" << endl;
+    return false;
+  }
+  // from GJK's simplex, and from nothing at all, which starts the completion
+  // on a support point that need not be anywhere near the origin
+  bool contained = completesAroundOrigin(a, b, simplex) && completesAroundOrigin(a, b, Simplex());
+
+  EpaResult penetration;
+  bool found = epa(a, b, simplex, penetration);
+  bool shallow = !found || fabsf(penetration.depth) <= TOUCH_DEPTH;
+  cout << name << ": " << simplex.size() << " point simplex, "
+       << (contained ? "origin inside" : "ORIGIN OUTSIDE THE TETRAHEDRON") << ", "
+       << (found ? "depth " : "no depth");
+  if (found) {
+    cout << penetration.depth;
+  }
+  cout << (shallow ? "" : ", TOO DEEP FOR A TOUCH") << endl;
+  return contained && shallow;
+}
+
+int main() {
+  int failures = 0;
+  TouchCase cases[] = {
+    {"cube face on face", glm::vec3(1.0f, 0.3f, 0.2f), 0.0f},
+    {"cube face on face, turned", glm::vec3(1.0f, -0.4f, 0.1f), 0.7f},
+    {"cube edge on edge", glm::vec3(1.0f, 1.0f, 0.25f), 0.0f},
+    {"cube corner on corner", glm::vec3(1.0f, 1.0f, 1.0f), 0.0f},
+  };
+  for (const TouchCase &touch : cases) {
+    Cube a(glm::vec3(0.0f, 0.0f, 0.0f));
+    Cube b(touch.offset);
+    // turning about x keeps b's face in the x = 0.5 plane
+    b.transform.orientation = glm::angleAxis(touch.angle, glm::vec3(1.0f, 0.0f, 0.0f));
+    failures += !checkTouch(touch.name, a, b);
+  }
+
+  // a tetrahedron standing on the cube's top face, on a corner or an edge
+  for (int turn = 0; turn < 4; turn++) {
+    Cube cube(glm::vec3(0.0f, 0.0f, 0.0f));
+    Tetrahedron tetrahedron(glm::vec3(0.0f, 0.0f, 0.0f));
+    tetrahedron.transform.orientation = glm::angleAxis(turn * 0.9f, glm::vec3(1.0f, 0.0f, 0.0f));
+    // lowest point put on the face, rounding can leave it a hair above so it
+    // is sunk by a hair more to always touch
+    glm::vec3 lowest = support(tetrahedron, glm::vec3(0.0f, -1.0f, 0.0f));
+    glm::vec3 onFace = glm::vec3(0.1f * turn, 0.5f - 1e-6f, -0.1f * turn);
+    tetrahedron.transform.position = onFace - lowest;
+    const char *names[] = {"tetrahedron on cube", "tetrahedron on cube, turned once",
+                           "tetrahedron on cube, turned twice", "tetrahedron on cube, turned three times"};
+    failures += !checkTouch(names[turn], cube, tetrahedron);
+  }
+  return failures > 0 ? 1 : 0;
+}
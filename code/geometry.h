@@ -0,0 +1,192 @@
+#ifndef GEOMETRY_H_
+#define GEOMETRY_H_
+
+#include <assert.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <map>
+#include "convex_hull.h"
+
+// Everything that is the same for every body of one kind of shape: the
+// triangle soup the renderer draws, the collision hull built from it and the
+// GPU buffers holding the soup. The registry keeps one of these per shape
+// name no matter how many bodies use it, bodies only hold a GeometryHandle.
+struct Geometry {
+  std::string name;
+  std::vector<float> soup;
+  ConvexHull hull;
+  // created the first time the geometry is drawn, so collision only code
+  // (and the benchmarks) never need a GL context
+  unsigned int vao = 0;
+  unsigned int vbo = 0;
+  // handles are copied and dropped wherever their shapes are, so the count is
+  // atomic. Acquiring a geometry and dropping its last handle still go
+  // through the registry's map, which one thread at a time may do.
+  std::atomic<int> ref_count{0};
+
+  Geometry(const std::string &geometry_name, const float soup_floats[], int float_count)
+      : name(geometry_name),
+        soup(soup_floats, soup_floats + float_count),
+        hull(soup_floats, float_count) {}
+
+  int vertex_count() const {
+    return (int)soup.size() / 3;
+  }
+
+  void bind_vertex_array() {
+    if (vao == 0) {
+      glGenVertexArrays(1, &vao);
+      glGenBuffers(1, &vbo);
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ARRAY_BUFFER, vbo);
+      glBufferData(GL_ARRAY_BUFFER, soup.size() * sizeof(float), &soup[0], GL_STATIC_DRAW);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+      glEnableVertexAttribArray(0);
+    }
+    glBindVertexArray(vao);
+  }
+
+  void delete_gpu_buffers() {
+    if (vao != 0) {
+      glDeleteVertexArrays(1, &vao);
+      glDeleteBuffers(1, &vbo);
+      vao = 0;
+      vbo = 0;
+    }
+  }
+
+  // CPU side bytes, GPU buffers hold another soup.size() floats
+  size_t memory_bytes() const {
+    return sizeof(Geometry)
+      + soup.capacity() * sizeof(float)
+      + hull.vertices.capacity() * sizeof(glm::vec3)
+      + hull.faces.capacity() * sizeof(ConvexHull::Face)
+      + hull.face_vertices.capacity() * sizeof(int)
+      + hull.edges.capacity() * sizeof(ConvexHull::Edge)
+      + hull.adjacency_offsets.capacity() * sizeof(int)
+      + hull.adjacency.capacity() * sizeof(int)
+      + hull.vertex_blocks.capacity() * sizeof(float);
+  }
+};
+
+class GeometryHandle;
+
+class GeometryRegistry {
+public:
+  // The last release of a geometry already deleted it, so anything left here
+  // still has a handle pointing at it. That is a shape outliving the
+  // registry, those geometries are leaked rather than pulled out from under
+  // the handle.
+  ~GeometryRegistry() {
+    assert(geometries.empty() && "a shape outlived the geometry registry");
+  }
+
+  // Returns the geometry registered under name, building it from the soup the
+  // first time the name is seen
+  GeometryHandle acquire(const std::string &name, const float soup_floats[], int float_count);
+
+  void release(Geometry *geometry) {
+    if (--geometry->ref_count == 0) {
+      geometry->delete_gpu_buffers();
+      geometries.erase(geometry->name);
+      delete geometry;
+    }
+  }
+
+  // Has to run while the GL context is still alive
+  void delete_gpu_buffers() {
+    for (auto &entry : geometries) {
+      entry.second->delete_gpu_buffers();
+    }
+  }
+
+  int size() const {
+    return (int)geometries.size();
+  }
+
+  size_t memory_bytes() const {
+    size_t bytes = sizeof(GeometryRegistry);
+    for (const auto &entry : geometries) {
+      bytes += entry.second->memory_bytes();
+    }
+    return bytes;
+  }
+
+private:
+  std::map<std::string, Geometry*> geometries;
+};
+
+inline GeometryRegistry &geometry_registry() {
+  static GeometryRegistry registry;
+  return registry;
+}
+
+// Reference counted pointer to registered geometry, this is all a body stores
+// about its shape
+class GeometryHandle {
+public:
+  GeometryHandle() : geometry(NULL) {}
+
+  explicit GeometryHandle(Geometry *g) : geometry(g) {
+    retain();
+  }
+
+  GeometryHandle(const GeometryHandle &other) : geometry(other.geometry) {
+    retain();
+  }
+
+  GeometryHandle &operator=(const GeometryHandle &other) {
+    if (geometry != other.geometry) {
+      release();
+      geometry = other.geometry;
+      retain();
+    }
+    return *this;
+  }
+
+  ~GeometryHandle() {
+    release();
+  }
+
+  Geometry *operator->() const {
+    return geometry;
+  }
+
+  Geometry &operator*() const {
+    return *geometry;
+  }
+
+  Geometry *get() const {
+    return geometry;
+  }
+
+private:
+  Geometry *geometry;
+
+  void retain() {
+    if (geometry) {
+      geometry->ref_count++;
+    }
+  }
+
+  void release() {
+    if (geometry) {
+      geometry_registry().release(geometry);
+      geometry = NULL;
+    }
+  }
+};
+
+inline GeometryHandle GeometryRegistry::acquire(const std::string &name, const float soup_floats[],
+                                                int float_count) {
+  std::map<std::string, Geometry*>::iterator found = geometries.find(name);
+  if (found != geometries.end()) {
+    return GeometryHandle(found->second);
+  }
+  Geometry *geometry = new Geometry(name, soup_floats, float_count);
+  geometries[name] = geometry;
+  return GeometryHandle(geometry);
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef GJK_H_
+#define GJK_H_
+
+#include <float.h>
+#include <glm/glm.hpp>
+
+#include "shape.h"
+#include "simplex.h"
+
+// Distance query convergence, see gjkDistance
+#define GJK_MAX_ITERATIONS 32
+#define GJK_RELATIVE_TOLERANCE 1e-5f
+#define GJK_OVERLAP_TOLERANCE 1e-10f
+
+// NOTE: Every function in here only reads the shapes, so they are passed by
+// const reference. Passing a Shape by value slices Cube/Tetrahedron down to
+// Shape and copies it on every support call, which used to happen several
+// times per GJK iteration.
+
+// The search direction is rotated into model space and only the winning
+// vertex is moved out rather than moving the hull into the world. index is set to
+// the hull vertex that won, or -1 when the point isn't a hull vertex (implicit
+// shapes and shapes with a margin). When given, index also comes in as the
+// vertex a walk over a big hull starts from, see Shape::local_support.
+//
+// Plain hulls too small for hill climbing or a SIMD scan (the cube and the
+// tetrahedron) go through flatHullSupport instead: for 4 to 8 vertices the
+// virtual call and the hint cost more than the scan. It picks the same vertex
+// local_support would.
+bool isFlatHull(const Shape &shape) {
+  return (shape.type == SHAPE_HULL || shape.type == SHAPE_CUBE) && shape.margin == 0.0f
+         && (int)shape.geometry->hull.vertices.size() < SIMD_SUPPORT_MIN_VERTICES;
+}
+
+glm::vec3 flatHullSupport(const Shape &shape, glm::vec3 direction, int *index) {
+  const ConvexHull &hull = shape.geometry->hull;
+  int vertex = hull.scalar_support_index(shape.transform.to_local_direction(direction));
+  if (index) {
+    *index = vertex;
+  }
+  return shape.transform.to_world(hull.vertices[vertex]);
+}
+
+glm::vec3 support(const Shape &shape, glm::vec3 direction, int *index = NULL) {
+  if (isFlatHull(shape)) {
+    return flatHullSupport(shape, direction, index);
+  }
+  int vertex = index ? *index : 0;
+  glm::vec3 point = shape.transform.to_world(
+    shape.local_support(shape.transform.to_local_direction(direction), &vertex));
+  if (shape.margin > 0.0f) {
+    // the margin sphere's support point, it doesn't care about orientation
+    float length = glm::length(direction);
+    if (length > 0.0f) {
+      point += direction * (shape.margin / length);
+    }
+    vertex = -1;
+  }
+  if (index) {
+    *index = vertex;
+  }
+  return point;
+}
+
+glm::vec3 getSupport(const Shape &shapeA, const Shape &shapeB, glm::vec3 direction) {
+  return support(shapeA, direction) - support(shapeB, -direction);
+}
+
+// supportDistance (optional) gets how far the new support point reaches
+// along direction, negative means direction separates the shapes
+bool addSupport(Simplex &simplex, const Shape &shapeA, const Shape &shapeB,
+                glm::vec3 direction, float *supportDistance = NULL) {
+  int indexA = 0, indexB = 0;
+  glm::vec3 pointA = support(shapeA, direction, &indexA);
+  glm::vec3 pointB = support(shapeB, -direction, &indexB);
+  if (supportDistance) {
+    *supportDistance = dot(direction, pointA - pointB);
+  }
+  glm::vec3 new_point = pointA - pointB;
+  // Support termination conditions from Erin Catto's 2010 presentation advice
+  if (simplex.contains(indexA, indexB, new_point)) {
+    return false;
+  }
+  simplex.push_back(new_point, pointA, indexA, indexB);
+  return (dot(direction, new_point) >= 0.0f);
+}
+
+// What a pair remembers about its last GJK query, so the next frame's query
+// can start where this one ended
+struct GjkCache {
+  // direction the last query proved the shapes to be separated along
+  glm::vec3 separating_axis = glm::vec3(0.0f, 0.0f, 0.0f);
+  bool has_separating_axis = false;
+  // the simplex the last query ended with, stored as hull vertex indices so
+  // it can be rebuilt under the shapes' new transforms. Empty when a point
+  // wasn't a hull vertex.
+  int simplex_size = 0;
+  int simplex_indices_a[Simplex::CAPACITY];
+  int simplex_indices_b[Simplex::CAPACITY];
+  // whether the last query started from the cached simplex
+  bool simplex_hit = false;
+  // iterations the last query took, 1 when the cached simplex answered it
+  int iterations = 0;
+  // the hull vertices the last support queries ended on, where the next
+  // query's walks over big hulls start
+  int support_hint_a = 0;
+  int support_hint_b = 0;
+
+  void store_simplex(const Simplex &simplex) {
+    simplex_size = simplex.size();
+    for (int i = 0; i < simplex_size; i++) {
+      if (simplex.indices_a[i] < 0 || simplex.indices_b[i] < 0) {
+        simplex_size = 0;
+        return;
+      }
+      simplex_indices_a[i] = simplex.indices_a[i];
+      simplex_indices_b[i] = simplex.indices_b[i];
+    }
+  }
+
+  void seed_simplex(const Shape &shapeA, const Shape &shapeB, Simplex &simplex) const {
+    simplex.clear();
+    for (int i = 0; i < simplex_size; i++) {
+      glm::vec3 pointA = shapeA.world_vertex(simplex_indices_a[i]);
+      glm::vec3 pointB = shapeB.world_vertex(simplex_indices_b[i]);
+      simplex.push_back(pointA - pointB, pointA, simplex_indices_a[i], simplex_indices_b[i]);
+    }
+  }
+};
+
+struct GjkDistanceResult {
+  bool overlapping = false;
+  // 0 when overlapping, the witness points and axis are only set otherwise
+  float distance = 0.0f;
+  // closest points on shape A and shape B
+  glm::vec3 point_a = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 point_b = glm::vec3(0.0f, 0.0f, 0.0f);
+  // unit axis pointing from shape A towards shape B
+  glm::vec3 separating_axis = glm::vec3(0.0f, 0.0f, 0.0f);
+  int iterations = 0;
+};
+
+// Adds support point w to the simplex and moves v to the new closest point.
+// separated says some earlier w already proved the shapes apart: w is the
+// support point along -v, so dot(v, w) > 0 puts all of A - B on the far side
+// of a plane in front of the origin. A tetrahedron "around" the origin after
+// that is a sliver (curved shapes cluster their support points) that floats
+// got wrong, the previous simplex is kept and false returned to stop there.
+bool gjkDistanceStep(Simplex &simplex, glm::vec3 &v, glm::vec3 w, glm::vec3 pointA,
+                     int indexA, int indexB, bool separated) {
+  if (!separated || simplex.size() < 3) {
+    simplex.push_back(w, pointA, indexA, indexB);
+    v = simplex.solve();
+    return true;
+  }
+  Simplex previous = simplex;
+  simplex.push_back(w, pointA, indexA, indexB);
+  glm::vec3 closest = simplex.solve();
+  if (simplex.size() == 4) {
+    simplex = previous;
+    return false;
+  }
+  v = closest;
+  return true;
+}
+
+// Distance version of GJK (van den Bergen / Ericson): keep the simplex point
+// closest to the origin, v, and add the support point of A - B along -v
+// until the support point can't get meaningfully closer than v. That happens
+// when the gap |v|^2 - dot(v, w) is within GJK_RELATIVE_TOLERANCE of |v|^2,
+// so we stop on the actual error bound rather than on an iteration count.
+// GJK_MAX_ITERATIONS is only there as a guard against float cycling.
+//
+// A non-empty simplex, or else the cache's simplex from the previous query, is
+// used as the starting point. Without either the search starts along the
+// cache's separating axis or between the centroids. Returns whether the
+// shapes overlap, v is left at the simplex's point closest to the origin.
+//
+// stopWhenApart ends the search as soon as a support point proves the
+// shapes further apart than the overlap tolerance, which is all gjk() needs
+// to know. The full search could only end up further away, so both give
+// the same answer.
+bool gjkSearch(const Shape &shapeA, const Shape &shapeB, Simplex &simplex, glm::vec3 &v, int &iterations,
+               GjkCache *cache, bool stopWhenApart) {
+  if (cache) {
+    cache->simplex_hit = (simplex.size() == 0 && cache->simplex_size > 0);
+    if (cache->simplex_hit) {
+      cache->seed_simplex(shapeA, shapeB, simplex);
+    }
+  }
+
+  if (simplex.size() == 0) {
+    glm::vec3 direction;
+    if (cache && cache->has_separating_axis) {
+      direction = cache->separating_axis;
+    }
+    else {
+      direction = shapeB.centroid() - shapeA.centroid();
+    }
+    if (direction == glm::vec3(0.0f, 0.0f, 0.0f)) {
+      direction = glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+    addSupport(simplex, shapeA, shapeB, direction);
+  }
+
+  // consecutive search directions are close, so each walk starts where the
+  // last one on the same shape ended
+  int localHints[2] = {0, 0};
+  int &hintA = cache ? cache->support_hint_a : localHints[0];
+  int &hintB = cache ? cache->support_hint_b : localHints[1];
+
+  v = simplex.solve();
+  float lastDistanceSquared = FLT_MAX;
+  bool separated = false;
+  iterations = 0;
+  while (iterations < GJK_MAX_ITERATIONS) {
+    iterations++;
+    float distanceSquared = dot(v, v);
+    if (simplex.size() == 4 || distanceSquared <= GJK_OVERLAP_TOLERANCE) {
+      return true;
+    }
+    // floats can make v wobble once it is as close as it will get
+    if (distanceSquared >= lastDistanceSquared) {
+      break;
+    }
+    lastDistanceSquared = distanceSquared;
+
+    int indexA = hintA, indexB = hintB;
+    glm::vec3 pointA = support(shapeA, -v, &indexA);
+    glm::vec3 pointB = support(shapeB, v, &indexB);
+    hintA = indexA;
+    hintB = indexB;
+    glm::vec3 w = pointA - pointB;
+    // no point of A - B is closer to the origin than dot(v, w) / |v|
+    float gap = dot(v, w);
+    if (stopWhenApart && gap > 0.0f && gap * gap > GJK_OVERLAP_TOLERANCE * distanceSquared) {
+      break;
+    }
+    if (simplex.contains(indexA, indexB, w) || distanceSquared - gap <= GJK_RELATIVE_TOLERANCE * distanceSquared) {
+      break;
+    }
+
+    separated = separated || gap > 0.0f;
+    if (!gjkDistanceStep(simplex, v, w, pointA, indexA, indexB, separated)) {
+      break;
+    }
+  }
+  return false;
+}
+
+bool gjkDistance(const Shape &shapeA, const Shape &shapeB, Simplex &simplex,
+                 GjkDistanceResult &result, GjkCache *cache = NULL) {
+  result = GjkDistanceResult();
+  glm::vec3 v;
+  result.overlapping = gjkSearch(shapeA, shapeB, simplex, v, result.iterations, cache, false);
+  if (!result.overlapping) {
+    result.point_a = simplex.weighted_point_a();
+    result.point_b = simplex.weighted_point_b();
+    result.distance = glm::length(v);
+    result.separating_axis = -v / result.distance;
+  }
+
+  if (cache) {
+    cache->iterations = result.iterations;
+    cache->has_separating_axis = !result.overlapping;
+    if (!result.overlapping) {
+      cache->separating_axis = result.separating_axis;
+    }
+    cache->store_simplex(simplex);
+  }
+
+  return result.overlapping;
+}
+
+// Whether the shapes overlap, the same search as gjkDistance() without
+// finishing the distance once the shapes are known to be apart. On an
+// overlap the simplex is what EPA starts from. cache is optional, with one
+// the search starts from the previous query's simplex or separating axis.
+bool gjk(const Shape &shapeA, const Shape &shapeB, Simplex &simplex, GjkCache *cache = NULL) {
+  glm::vec3 v;
+  int iterations;
+  bool overlapping = gjkSearch(shapeA, shapeB, simplex, v, iterations, cache, true);
+  if (cache) {
+    cache->iterations = iterations;
+    cache->has_separating_axis = !overlapping;
+    if (!overlapping) {
+      cache->separating_axis = -v / glm::length(v);
+    }
+    cache->store_simplex(simplex);
+  }
+  return overlapping;
+}
+
+#endif
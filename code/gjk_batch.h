@@ -0,0 +1,728 @@
+#ifndef GJK_BATCH_H_
+#define GJK_BATCH_H_
+
+#include <float.h>
+#include <glm/glm.hpp>
+
+#include "gjk.h"
+#include "simd_support.h"
+
+// Pairs run side by side, one per SSE lane
+#define GJK_BATCH_LANES 4
+// Only hulls that take flatHullSupport run in the lanes, see isFlatHull
+#define GJK_BATCH_MAX_VERTICES (SIMD_SUPPORT_MIN_VERTICES - 1)
+
+struct GjkPair {
+  const Shape *a;
+  const Shape *b;
+};
+
+// Everything the lanes work on, stored component by component. A lane's
+// flags are all ones or zero, the way the SSE compares leave them.
+//
+// Pairs of small plain hulls (cubes, tetrahedrons) run the whole iteration in
+// the lanes: the support scans over the model space vertices, the transforms,
+// the termination tests and the sub-simplex solve, which works out every
+// Voronoi region on every lane and keeps the one the scalar solve would
+// pick. Every other pair takes the scalar query.
+struct GjkBatchLanes {
+  // pair each lane is working on, -1 once there are no pairs left for it
+  int pair[GJK_BATCH_LANES];
+  // the pair was just loaded, its first support point comes next
+  int starting[GJK_BATCH_LANES];
+  // a support point has proven the pair apart, see gjkDistanceStep
+  int separated[GJK_BATCH_LANES];
+  int iterations[GJK_BATCH_LANES];
+  float last_distance_squared[GJK_BATCH_LANES];
+  // each hull's vertex count, and up to where the lane's vertices are padded
+  // with copies of its first one so a scan over every lane stays on it
+  int vertex_count_a[GJK_BATCH_LANES];
+  int vertex_count_b[GJK_BATCH_LANES];
+  int padded_a[GJK_BATCH_LANES];
+  int padded_b[GJK_BATCH_LANES];
+  float vertices_a[GJK_BATCH_MAX_VERTICES][3][GJK_BATCH_LANES];
+  float vertices_b[GJK_BATCH_MAX_VERTICES][3][GJK_BATCH_LANES];
+  // x, y, z, w of each shape's orientation and its position
+  float orientation_a[4][GJK_BATCH_LANES];
+  float orientation_b[4][GJK_BATCH_LANES];
+  float position_a[3][GJK_BATCH_LANES];
+  float position_b[3][GJK_BATCH_LANES];
+  // the simplex, point by point as Simplex keeps it
+  float points[Simplex::CAPACITY][3][GJK_BATCH_LANES];
+  float points_a[Simplex::CAPACITY][3][GJK_BATCH_LANES];
+  int indices_a[Simplex::CAPACITY][GJK_BATCH_LANES];
+  int indices_b[Simplex::CAPACITY][GJK_BATCH_LANES];
+  float weights[Simplex::CAPACITY][GJK_BATCH_LANES];
+  int count[GJK_BATCH_LANES];
+  // the simplex point closest to the origin
+  float v[3][GJK_BATCH_LANES];
+};
+
+glm::vec3 gjkBatchGetVector(const float lanes[3][GJK_BATCH_LANES], int lane) {
+  return glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+}
+
+void gjkBatchSetVector(float lanes[3][GJK_BATCH_LANES], int lane, glm::vec3 value) {
+  lanes[0][lane] = value.x;
+  lanes[1][lane] = value.y;
+  lanes[2][lane] = value.z;
+}
+
+// The lane's simplex as a Simplex, for the witness points
+Simplex gjkBatchSimplex(const GjkBatchLanes &lanes, int lane) {
+  Simplex simplex;
+  for (int i = 0; i < lanes.count[lane]; i++) {
+    simplex.push_back(gjkBatchGetVector(lanes.points[i], lane), gjkBatchGetVector(lanes.points_a[i], lane),
+                      lanes.indices_a[i][lane], lanes.indices_b[i][lane]);
+    simplex.weights[i] = lanes.weights[i][lane];
+  }
+  return simplex;
+}
+
+void gjkBatchLoadHull(const Shape &shape, float vertices[GJK_BATCH_MAX_VERTICES][3][GJK_BATCH_LANES],
+                      int lane, int &vertexCount, int &padded) {
+  const std::vector<glm::vec3> &hull = shape.geometry->hull.vertices;
+  vertexCount = (int)hull.size();
+  padded = vertexCount;
+  for (int k = 0; k < vertexCount; k++) {
+    gjkBatchSetVector(vertices[k], lane, hull[k]);
+  }
+}
+
+// Loads the pair into the lane, the same start gjkDistance() makes without
+// a cache. The first support direction goes in as -v, which is what the
+// next step searches along.
+void gjkBatchStartLane(GjkBatchLanes &lanes, int lane, int pair, const GjkPair &shapes) {
+  const Shape &shapeA = *shapes.a;
+  const Shape &shapeB = *shapes.b;
+  lanes.pair[lane] = pair;
+  lanes.starting[lane] = -1;
+  lanes.separated[lane] = 0;
+  lanes.iterations[lane] = 0;
+  lanes.last_distance_squared[lane] = FLT_MAX;
+  lanes.count[lane] = 0;
+  gjkBatchLoadHull(shapeA, lanes.vertices_a, lane, lanes.vertex_count_a[lane], lanes.padded_a[lane]);
+  gjkBatchLoadHull(shapeB, lanes.vertices_b, lane, lanes.vertex_count_b[lane], lanes.padded_b[lane]);
+
+  const glm::quat &qa = shapeA.transform.orientation;
+  const glm::quat &qb = shapeB.transform.orientation;
+  float orientationA[4] = {qa.x, qa.y, qa.z, qa.w};
+  float orientationB[4] = {qb.x, qb.y, qb.z, qb.w};
+  for (int i = 0; i < 4; i++) {
+    lanes.orientation_a[i][lane] = orientationA[i];
+    lanes.orientation_b[i][lane] = orientationB[i];
+  }
+  gjkBatchSetVector(lanes.position_a, lane, shapeA.transform.position);
+  gjkBatchSetVector(lanes.position_b, lane, shapeB.transform.position);
+
+  glm::vec3 direction = shapeB.centroid() - shapeA.centroid();
+  if (direction == glm::vec3(0.0f, 0.0f, 0.0f)) {
+    direction = glm::vec3(1.0f, 0.0f, 0.0f);
+  }
+  gjkBatchSetVector(lanes.v, lane, -direction);
+}
+
+// Pads every working lane's vertices up to the most any of them has, and
+// returns that count
+int gjkBatchPad(GjkBatchLanes &lanes, int vertexCount[], int padded[],
+                float vertices[GJK_BATCH_MAX_VERTICES][3][GJK_BATCH_LANES]) {
+  int most = 1;
+  for (int l = 0; l < GJK_BATCH_LANES; l++) {
+    if (lanes.pair[l] != -1 && vertexCount[l] > most) {
+      most = vertexCount[l];
+    }
+  }
+  for (int l = 0; l < GJK_BATCH_LANES; l++) {
+    if (lanes.pair[l] == -1) {
+      continue;
+    }
+    for (; padded[l] < most; padded[l]++) {
+      for (int c = 0; c < 3; c++) {
+        vertices[padded[l]][c][l] = vertices[0][c][l];
+      }
+    }
+  }
+  return most;
+}
+
+#if SIMD_SUPPORT_X86
+// A simplex on every lane, as GjkBatchLanes stores it
+struct GjkSseSimplex {
+  SseVec3 points[Simplex::CAPACITY];
+  SseVec3 points_a[Simplex::CAPACITY];
+  __m128i indices_a[Simplex::CAPACITY];
+  __m128i indices_b[Simplex::CAPACITY];
+  __m128 weights[Simplex::CAPACITY];
+  __m128i count;
+};
+
+// What the sub-simplex solve found on every lane: the closest point, the
+// weights of the points kept, and which slot each new slot takes its point
+// from, two bits per slot. Lanes the solve leaves alone keep every slot.
+struct GjkSseSolve {
+  SseVec3 closest;
+  __m128 weights[Simplex::CAPACITY];
+  __m128i slots;
+  __m128i count;
+};
+
+// slot codes, new slot 0 in the lowest two bits
+#define GJK_SSE_SLOTS(s0, s1, s2, s3) ((s0) | ((s1) << 2) | ((s2) << 4) | ((s3) << 6))
+#define GJK_SSE_KEEP_ALL GJK_SSE_SLOTS(0, 1, 2, 3)
+
+SseVec3 gjkSseLoad3(const float v[3][GJK_BATCH_LANES]) {
+  return SseVec3{_mm_loadu_ps(v[0]), _mm_loadu_ps(v[1]), _mm_loadu_ps(v[2])};
+}
+
+void gjkSseStore3(float v[3][GJK_BATCH_LANES], SseVec3 a) {
+  _mm_storeu_ps(v[0], a.x);
+  _mm_storeu_ps(v[1], a.y);
+  _mm_storeu_ps(v[2], a.z);
+}
+
+__m128i gjkSseLoadInt(const int v[GJK_BATCH_LANES]) {
+  return _mm_loadu_si128((const __m128i *)v);
+}
+
+void gjkSseStoreInt(int v[GJK_BATCH_LANES], __m128i a) {
+  _mm_storeu_si128((__m128i *)v, a);
+}
+
+bool gjkSseAny(__m128 mask) {
+  return _mm_movemask_ps(mask) != 0;
+}
+
+SseVec3 gjkSseNegate(SseVec3 a) {
+  __m128 sign = _mm_set1_ps(-0.0f);
+  return SseVec3{_mm_xor_ps(a.x, sign), _mm_xor_ps(a.y, sign), _mm_xor_ps(a.z, sign)};
+}
+
+// q * v on every lane, with the conjugate of q when inverse is set. Same
+// v + 2w(u x v) + 2u x (u x v) expansion glm uses, so the lanes round the
+// same way the scalar query does.
+SseVec3 gjkSseRotate(const float q[4][GJK_BATCH_LANES], bool inverse, SseVec3 v) {
+  __m128 sign = _mm_set1_ps(inverse ? -0.0f : 0.0f);
+  SseVec3 u = {_mm_xor_ps(_mm_loadu_ps(q[0]), sign), _mm_xor_ps(_mm_loadu_ps(q[1]), sign),
+               _mm_xor_ps(_mm_loadu_ps(q[2]), sign)};
+  __m128 w = _mm_loadu_ps(q[3]);
+  SseVec3 uv = sseCross3(u, v);
+  SseVec3 uuv = sseCross3(u, uv);
+  return sseAdd3(v, sseScale3(sseAdd3(sseScale3(uv, w), uuv), _mm_set1_ps(2.0f)));
+}
+
+// The hull vertex furthest along direction on every lane, in the lane's
+// model space. Strictly greater keeps the first of equals like
+// scalar_support_index.
+SseVec3 gjkSseSupport(const float vertices[GJK_BATCH_MAX_VERTICES][3][GJK_BATCH_LANES], int vertexCount,
+                      SseVec3 direction, __m128i &index) {
+  __m128 best = _mm_set1_ps(-FLT_MAX);
+  SseVec3 point = gjkSseLoad3(vertices[0]);
+  index = _mm_setzero_si128();
+  for (int k = 0; k < vertexCount; k++) {
+    SseVec3 vertex = gjkSseLoad3(vertices[k]);
+    __m128 distance = sseDot3(vertex, direction);
+    __m128 greater = _mm_cmpgt_ps(distance, best);
+    best = sseSelect(greater, distance, best);
+    point = sseSelect3(greater, vertex, point);
+    index = sseSelect(_mm_castps_si128(greater), _mm_set1_epi32(k), index);
+  }
+  return point;
+}
+
+GjkSseSimplex gjkSseLoadSimplex(const GjkBatchLanes &lanes) {
+  GjkSseSimplex simplex;
+  for (int i = 0; i < Simplex::CAPACITY; i++) {
+    simplex.points[i] = gjkSseLoad3(lanes.points[i]);
+    simplex.points_a[i] = gjkSseLoad3(lanes.points_a[i]);
+    simplex.indices_a[i] = gjkSseLoadInt(lanes.indices_a[i]);
+    simplex.indices_b[i] = gjkSseLoadInt(lanes.indices_b[i]);
+    simplex.weights[i] = _mm_loadu_ps(lanes.weights[i]);
+  }
+  simplex.count = gjkSseLoadInt(lanes.count);
+  return simplex;
+}
+
+void gjkSseStoreSimplex(GjkBatchLanes &lanes, const GjkSseSimplex &simplex) {
+  for (int i = 0; i < Simplex::CAPACITY; i++) {
+    gjkSseStore3(lanes.points[i], simplex.points[i]);
+    gjkSseStore3(lanes.points_a[i], simplex.points_a[i]);
+    gjkSseStoreInt(lanes.indices_a[i], simplex.indices_a[i]);
+    gjkSseStoreInt(lanes.indices_b[i], simplex.indices_b[i]);
+    _mm_storeu_ps(lanes.weights[i], simplex.weights[i]);
+  }
+  gjkSseStoreInt(lanes.count, simplex.count);
+}
+
+// Takes option on the lanes in mask
+void gjkSseChoose(__m128 mask, GjkSseSolve &solve, const GjkSseSolve &option) {
+  __m128i maskInt = _mm_castps_si128(mask);
+  solve.closest = sseSelect3(mask, option.closest, solve.closest);
+  for (int i = 0; i < Simplex::CAPACITY; i++) {
+    solve.weights[i] = sseSelect(mask, option.weights[i], solve.weights[i]);
+  }
+  solve.slots = sseSelect(maskInt, option.slots, solve.slots);
+  solve.count = sseSelect(maskInt, option.count, solve.count);
+}
+
+// Simplex::solve_vertex on slot i, for the lanes in mask
+void gjkSseVertex(GjkSseSolve &solve, __m128 mask, const SseVec3 points[], int i) {
+  __m128i maskInt = _mm_castps_si128(mask);
+  solve.closest = sseSelect3(mask, points[i], solve.closest);
+  solve.weights[0] = sseSelect(mask, _mm_set1_ps(1.0f), solve.weights[0]);
+  solve.slots = sseSelect(maskInt, _mm_set1_epi32(GJK_SSE_SLOTS(i, 1, 2, 3)), solve.slots);
+  solve.count = sseSelect(maskInt, _mm_set1_epi32(1), solve.count);
+}
+
+// Simplex::solve_edge on slots i and j
+void gjkSseEdge(GjkSseSolve &solve, __m128 mask, const SseVec3 points[], int i, int j, __m128 t) {
+  __m128i maskInt = _mm_castps_si128(mask);
+  SseVec3 closest = sseAdd3(points[i], sseScale3(sseSub3(points[j], points[i]), t));
+  solve.closest = sseSelect3(mask, closest, solve.closest);
+  solve.weights[0] = sseSelect(mask, _mm_sub_ps(_mm_set1_ps(1.0f), t), solve.weights[0]);
+  solve.weights[1] = sseSelect(mask, t, solve.weights[1]);
+  solve.slots = sseSelect(maskInt, _mm_set1_epi32(GJK_SSE_SLOTS(i, j, 2, 3)), solve.slots);
+  solve.count = sseSelect(maskInt, _mm_set1_epi32(2), solve.count);
+}
+
+// Simplex::solve_segment on slots i and j
+void gjkSseSegment(GjkSseSolve &solve, __m128 mask, const SseVec3 points[], int i, int j) {
+  __m128 zero = _mm_setzero_ps();
+  SseVec3 a = points[i];
+  SseVec3 ab = sseSub3(points[j], a);
+  __m128 lengthSquared = sseDot3(ab, ab);
+  __m128 positive = _mm_cmpgt_ps(lengthSquared, zero);
+  __m128 t = _mm_and_ps(positive, _mm_div_ps(sseDot3(gjkSseNegate(a), ab), lengthSquared));
+  __m128 first = _mm_and_ps(mask, _mm_cmple_ps(t, zero));
+  __m128 second = _mm_andnot_ps(first, _mm_and_ps(mask, _mm_cmpge_ps(t, _mm_set1_ps(1.0f))));
+  __m128 between = _mm_andnot_ps(_mm_or_ps(first, second), mask);
+  if (gjkSseAny(first)) {
+    gjkSseVertex(solve, first, points, i);
+  }
+  if (gjkSseAny(second)) {
+    gjkSseVertex(solve, second, points, j);
+  }
+  if (gjkSseAny(between)) {
+    gjkSseEdge(solve, between, points, i, j, t);
+  }
+}
+
+// Simplex::solve_closest_of(3) on slots i, j and k
+void gjkSseClosestEdge(GjkSseSolve &solve, __m128 mask, const SseVec3 points[], int i, int j, int k) {
+  int edges[3][2] = {{i, j}, {j, k}, {k, i}};
+  __m128 bestDistance = _mm_set1_ps(FLT_MAX);
+  GjkSseSolve best = solve;
+  for (int e = 0; e < 3; e++) {
+    GjkSseSolve edge = solve;
+    gjkSseSegment(edge, mask, points, edges[e][0], edges[e][1]);
+    __m128 distance = sseDot3(edge.closest, edge.closest);
+    __m128 closer = _mm_and_ps(mask, _mm_cmplt_ps(distance, bestDistance));
+    gjkSseChoose(closer, best, edge);
+    bestDistance = sseSelect(closer, distance, bestDistance);
+  }
+  solve = best;
+}
+
+// Simplex::solve_triangle on slots i, j and k. The region tests run on
+// every lane and each lane takes the first region its scalar solve would
+// stop at, only the regions some lane is in are worked out.
+void gjkSseTriangle(GjkSseSolve &solve, __m128 mask, const SseVec3 points[], int i, int j, int k) {
+  __m128 zero = _mm_setzero_ps();
+  SseVec3 a = points[i];
+  SseVec3 b = points[j];
+  SseVec3 c = points[k];
+  SseVec3 ab = sseSub3(b, a);
+  SseVec3 ac = sseSub3(c, a);
+  SseVec3 minusA = gjkSseNegate(a);
+  SseVec3 minusB = gjkSseNegate(b);
+  SseVec3 minusC = gjkSseNegate(c);
+  __m128 d1 = sseDot3(ab, minusA);
+  __m128 d2 = sseDot3(ac, minusA);
+  __m128 d3 = sseDot3(ab, minusB);
+  __m128 d4 = sseDot3(ac, minusB);
+  __m128 d5 = sseDot3(ab, minusC);
+  __m128 d6 = sseDot3(ac, minusC);
+  __m128 vc = _mm_sub_ps(_mm_mul_ps(d1, d4), _mm_mul_ps(d3, d2));
+  __m128 vb = _mm_sub_ps(_mm_mul_ps(d5, d2), _mm_mul_ps(d1, d6));
+  __m128 va = _mm_sub_ps(_mm_mul_ps(d3, d6), _mm_mul_ps(d5, d4));
+  __m128 d43 = _mm_sub_ps(d4, d3);
+  __m128 d56 = _mm_sub_ps(d5, d6);
+
+  __m128 left = mask;
+  __m128 vertexA = _mm_and_ps(left, _mm_and_ps(_mm_cmple_ps(d1, zero), _mm_cmple_ps(d2, zero)));
+  left = _mm_andnot_ps(vertexA, left);
+  __m128 vertexB = _mm_and_ps(left, _mm_and_ps(_mm_cmpge_ps(d3, zero), _mm_cmple_ps(d4, d3)));
+  left = _mm_andnot_ps(vertexB, left);
+  __m128 edgeAB = _mm_and_ps(left, _mm_and_ps(_mm_and_ps(_mm_cmple_ps(vc, zero), _mm_cmpge_ps(d1, zero)),
+                                              _mm_cmple_ps(d3, zero)));
+  left = _mm_andnot_ps(edgeAB, left);
+  __m128 vertexC = _mm_and_ps(left, _mm_and_ps(_mm_cmpge_ps(d6, zero), _mm_cmple_ps(d5, d6)));
+  left = _mm_andnot_ps(vertexC, left);
+  __m128 edgeAC = _mm_and_ps(left, _mm_and_ps(_mm_and_ps(_mm_cmple_ps(vb, zero), _mm_cmpge_ps(d2, zero)),
+                                              _mm_cmple_ps(d6, zero)));
+  left = _mm_andnot_ps(edgeAC, left);
+  __m128 edgeBC = _mm_and_ps(left, _mm_and_ps(_mm_and_ps(_mm_cmple_ps(va, zero), _mm_cmpge_ps(d43, zero)),
+                                              _mm_cmpge_ps(d56, zero)));
+  left = _mm_andnot_ps(edgeBC, left);
+  __m128 sum = _mm_add_ps(_mm_add_ps(va, vb), vc);
+  __m128 collinear = _mm_and_ps(left, _mm_cmple_ps(sum, zero));
+  __m128 inside = _mm_andnot_ps(collinear, left);
+
+  if (gjkSseAny(vertexA)) {
+    gjkSseVertex(solve, vertexA, points, i);
+  }
+  if (gjkSseAny(vertexB)) {
+    gjkSseVertex(solve, vertexB, points, j);
+  }
+  if (gjkSseAny(edgeAB)) {
+    gjkSseEdge(solve, edgeAB, points, i, j, _mm_div_ps(d1, _mm_sub_ps(d1, d3)));
+  }
+  if (gjkSseAny(vertexC)) {
+    gjkSseVertex(solve, vertexC, points, k);
+  }
+  if (gjkSseAny(edgeAC)) {
+    gjkSseEdge(solve, edgeAC, points, i, k, _mm_div_ps(d2, _mm_sub_ps(d2, d6)));
+  }
+  if (gjkSseAny(edgeBC)) {
+    gjkSseEdge(solve, edgeBC, points, j, k, _mm_div_ps(d43, _mm_add_ps(d43, d56)));
+  }
+  if (gjkSseAny(collinear)) {
+    gjkSseClosestEdge(solve, collinear, points, i, j, k);
+  }
+  if (gjkSseAny(inside)) {
+    __m128i insideInt = _mm_castps_si128(inside);
+    __m128 v = _mm_div_ps(vb, sum);
+    __m128 w = _mm_div_ps(vc, sum);
+    SseVec3 closest = sseAdd3(sseAdd3(a, sseScale3(ab, v)), sseScale3(ac, w));
+    solve.closest = sseSelect3(inside, closest, solve.closest);
+    solve.weights[0] = sseSelect(inside, _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), v), w), solve.weights[0]);
+    solve.weights[1] = sseSelect(inside, v, solve.weights[1]);
+    solve.weights[2] = sseSelect(inside, w, solve.weights[2]);
+    solve.slots = sseSelect(insideInt, _mm_set1_epi32(GJK_SSE_SLOTS(i, j, k, 3)), solve.slots);
+    solve.count = sseSelect(insideInt, _mm_set1_epi32(3), solve.count);
+  }
+}
+
+// Simplex::solve_tetrahedron on the four slots
+void gjkSseTetrahedron(GjkSseSolve &solve, __m128 mask, const SseVec3 points[]) {
+  static const int FACES[4][3] = {{1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2}};
+  __m128 zero = _mm_setzero_ps();
+  __m128 sign = _mm_set1_ps(-0.0f);
+  SseVec3 a = points[0];
+  SseVec3 b = points[1];
+  SseVec3 c = points[2];
+  SseVec3 d = points[3];
+  __m128 volume = sseDot3(sseSub3(b, a), sseCross3(sseSub3(c, a), sseSub3(d, a)));
+  __m128 flat = _mm_cmple_ps(_mm_andnot_ps(sign, volume), _mm_set1_ps(1e-9f));
+
+  __m128 candidate[4];
+  __m128 outside = zero;
+  for (int i = 0; i < 4; i++) {
+    const SseVec3 &faceA = points[FACES[i][0]];
+    SseVec3 n = sseCross3(sseSub3(points[FACES[i][1]], faceA), sseSub3(points[FACES[i][2]], faceA));
+    __m128 sides = _mm_mul_ps(sseDot3(n, gjkSseNegate(faceA)), sseDot3(n, sseSub3(points[i], faceA)));
+    candidate[i] = _mm_and_ps(mask, _mm_or_ps(flat, _mm_cmplt_ps(sides, zero)));
+    outside = _mm_or_ps(outside, candidate[i]);
+  }
+
+  // the origin inside, set_origin_weights
+  __m128 inside = _mm_andnot_ps(outside, mask);
+  if (gjkSseAny(inside)) {
+    __m128i insideInt = _mm_castps_si128(inside);
+    SseVec3 cd = sseCross3(c, d);
+    __m128 weights[4] = {sseDot3(b, cd), _mm_xor_ps(sseDot3(a, cd), sign), sseDot3(a, sseCross3(b, d)),
+                         _mm_xor_ps(sseDot3(a, sseCross3(b, c)), sign)};
+    for (int i = 0; i < 4; i++) {
+      solve.weights[i] = sseSelect(inside, _mm_div_ps(weights[i], volume), solve.weights[i]);
+    }
+    solve.closest = sseSelect3(inside, SseVec3{zero, zero, zero}, solve.closest);
+    solve.slots = sseSelect(insideInt, _mm_set1_epi32(GJK_SSE_KEEP_ALL), solve.slots);
+    solve.count = sseSelect(insideInt, _mm_set1_epi32(4), solve.count);
+  }
+  if (!gjkSseAny(outside)) {
+    return;
+  }
+
+  // the closest of the faces the origin is outside of
+  GjkSseSolve best = solve;
+  __m128 bestDistance = _mm_set1_ps(FLT_MAX);
+  for (int i = 0; i < 4; i++) {
+    if (!gjkSseAny(candidate[i])) {
+      continue;
+    }
+    GjkSseSolve face = solve;
+    gjkSseTriangle(face, candidate[i], points, FACES[i][0], FACES[i][1], FACES[i][2]);
+    __m128 distance = sseDot3(face.closest, face.closest);
+    __m128 closer = _mm_and_ps(candidate[i], _mm_cmplt_ps(distance, bestDistance));
+    gjkSseChoose(closer, best, face);
+    bestDistance = sseSelect(closer, distance, bestDistance);
+  }
+  solve = best;
+}
+
+// Simplex::solve() on the lanes in mask: the closest point, with the
+// simplex shrunk to the sub-simplex it lies on. The other lanes keep their
+// simplex.
+SseVec3 gjkSseSolveSimplex(GjkSseSimplex &simplex, __m128 mask) {
+  GjkSseSolve solve;
+  solve.closest = simplex.points[0];
+  for (int i = 0; i < Simplex::CAPACITY; i++) {
+    solve.weights[i] = simplex.weights[i];
+  }
+  solve.slots = _mm_set1_epi32(GJK_SSE_KEEP_ALL);
+  solve.count = simplex.count;
+
+  __m128 sizes[4];
+  for (int size = 1; size <= 4; size++) {
+    sizes[size - 1] = _mm_and_ps(mask, _mm_castsi128_ps(_mm_cmpeq_epi32(simplex.count, _mm_set1_epi32(size))));
+  }
+  if (gjkSseAny(sizes[0])) {
+    gjkSseVertex(solve, sizes[0], simplex.points, 0);
+  }
+  if (gjkSseAny(sizes[1])) {
+    gjkSseSegment(solve, sizes[1], simplex.points, 0, 1);
+  }
+  if (gjkSseAny(sizes[2])) {
+    gjkSseTriangle(solve, sizes[2], simplex.points, 0, 1, 2);
+  }
+  if (gjkSseAny(sizes[3])) {
+    gjkSseTetrahedron(solve, sizes[3], simplex.points);
+  }
+
+  // Simplex::keep, every new slot takes its point from the old slot the
+  // solve picked. Slots that keep their own point on every lane are left.
+  GjkSseSimplex old = simplex;
+  __m128i three = _mm_set1_epi32(3);
+  __m128i from[Simplex::CAPACITY] = {
+    _mm_and_si128(solve.slots, three), _mm_and_si128(_mm_srli_epi32(solve.slots, 2), three),
+    _mm_and_si128(_mm_srli_epi32(solve.slots, 4), three), _mm_and_si128(_mm_srli_epi32(solve.slots, 6), three)};
+  for (int k = 0; k < Simplex::CAPACITY; k++) {
+    if (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(from[k], _mm_set1_epi32(k)))) == 0xf) {
+      continue;
+    }
+    for (int i = 0; i < Simplex::CAPACITY; i++) {
+      if (i == k) {
+        continue;
+      }
+      __m128i takeInt = _mm_cmpeq_epi32(from[k], _mm_set1_epi32(i));
+      __m128 take = _mm_castsi128_ps(takeInt);
+      simplex.points[k] = sseSelect3(take, old.points[i], simplex.points[k]);
+      simplex.points_a[k] = sseSelect3(take, old.points_a[i], simplex.points_a[k]);
+      simplex.indices_a[k] = sseSelect(takeInt, old.indices_a[i], simplex.indices_a[k]);
+      simplex.indices_b[k] = sseSelect(takeInt, old.indices_b[i], simplex.indices_b[k]);
+    }
+  }
+  for (int i = 0; i < Simplex::CAPACITY; i++) {
+    simplex.weights[i] = solve.weights[i];
+  }
+  simplex.count = solve.count;
+  return solve.closest;
+}
+
+// One iteration of gjkSearch() on every working lane: the support points,
+// the termination tests, gjkDistanceStep and the loop head of the next
+// iteration. Lanes that are starting only take their first support point
+// before the head. Returns a bit per lane that is done, and above those a
+// bit per lane whose pair overlaps.
+SIMD_NOINLINE
+int sseGjkBatchStep(GjkBatchLanes &lanes, int vertexCountA, int vertexCountB, bool stopWhenApart) {
+  __m128 zero = _mm_setzero_ps();
+  __m128i working = _mm_cmpgt_epi32(gjkSseLoadInt(lanes.pair), _mm_set1_epi32(-1));
+  __m128i startingInt = _mm_and_si128(working, gjkSseLoadInt(lanes.starting));
+  __m128 starting = _mm_castsi128_ps(startingInt);
+  __m128 searching = _mm_castsi128_ps(_mm_andnot_si128(startingInt, working));
+
+  // support points along -v on A and v on B
+  SseVec3 v = gjkSseLoad3(lanes.v);
+  __m128i indexA, indexB;
+  SseVec3 localA = gjkSseSupport(lanes.vertices_a, vertexCountA,
+                                 gjkSseRotate(lanes.orientation_a, true, gjkSseNegate(v)), indexA);
+  SseVec3 localB = gjkSseSupport(lanes.vertices_b, vertexCountB, gjkSseRotate(lanes.orientation_b, true, v), indexB);
+  SseVec3 pointA = sseAdd3(gjkSseRotate(lanes.orientation_a, false, localA), gjkSseLoad3(lanes.position_a));
+  SseVec3 pointB = sseAdd3(gjkSseRotate(lanes.orientation_b, false, localB), gjkSseLoad3(lanes.position_b));
+  SseVec3 w = sseSub3(pointA, pointB);
+
+  GjkSseSimplex simplex = gjkSseLoadSimplex(lanes);
+  __m128 distanceSquared = sseDot3(v, v);
+  __m128 gap = sseDot3(v, w);
+  __m128 ahead = _mm_cmpgt_ps(gap, zero);
+  __m128 stop = _mm_cmple_ps(_mm_sub_ps(distanceSquared, gap),
+                             _mm_mul_ps(_mm_set1_ps(GJK_RELATIVE_TOLERANCE), distanceSquared));
+  if (stopWhenApart) {
+    __m128 apart = _mm_cmpgt_ps(_mm_mul_ps(gap, gap), _mm_mul_ps(_mm_set1_ps(GJK_OVERLAP_TOLERANCE), distanceSquared));
+    stop = _mm_or_ps(stop, _mm_and_ps(ahead, apart));
+  }
+  for (int i = 0; i < Simplex::CAPACITY; i++) {
+    __m128i inSimplex = _mm_cmpgt_epi32(simplex.count, _mm_set1_epi32(i));
+    __m128i same = _mm_and_si128(_mm_cmpeq_epi32(simplex.indices_a[i], indexA),
+                                 _mm_cmpeq_epi32(simplex.indices_b[i], indexB));
+    stop = _mm_or_ps(stop, _mm_castsi128_ps(_mm_and_si128(inSimplex, same)));
+  }
+  stop = _mm_and_ps(searching, stop);
+  __m128 separated = _mm_or_ps(_mm_castsi128_ps(gjkSseLoadInt(lanes.separated)), _mm_and_ps(searching, ahead));
+
+  // push w on the lanes going on, then solve them
+  __m128 adding = _mm_or_ps(starting, _mm_andnot_ps(stop, searching));
+  __m128i addingInt = _mm_castps_si128(adding);
+  __m128i wasTriangle = _mm_cmpeq_epi32(simplex.count, _mm_set1_epi32(3));
+  for (int i = 0; i < Simplex::CAPACITY; i++) {
+    __m128i slotInt = _mm_and_si128(addingInt, _mm_cmpeq_epi32(simplex.count, _mm_set1_epi32(i)));
+    __m128 slot = _mm_castsi128_ps(slotInt);
+    simplex.points[i] = sseSelect3(slot, w, simplex.points[i]);
+    simplex.points_a[i] = sseSelect3(slot, pointA, simplex.points_a[i]);
+    simplex.indices_a[i] = sseSelect(slotInt, indexA, simplex.indices_a[i]);
+    simplex.indices_b[i] = sseSelect(slotInt, indexB, simplex.indices_b[i]);
+    simplex.weights[i] = sseSelect(slot, zero, simplex.weights[i]);
+  }
+  // adding is -1 on the lanes that grow
+  simplex.count = _mm_sub_epi32(simplex.count, addingInt);
+  __m128 previousWeights[3] = {simplex.weights[0], simplex.weights[1], simplex.weights[2]};
+  SseVec3 closest = gjkSseSolveSimplex(simplex, adding);
+
+  // A separated pair whose triangle grew into a tetrahedron keeps the
+  // triangle and stops, see gjkDistanceStep. The tetrahedron kept every
+  // point where they were, only the weights and the count go back.
+  __m128i isTetrahedron = _mm_cmpeq_epi32(simplex.count, _mm_set1_epi32(4));
+  __m128 rejected = _mm_and_ps(_mm_and_ps(searching, adding),
+                               _mm_and_ps(separated, _mm_castsi128_ps(_mm_and_si128(wasTriangle, isTetrahedron))));
+  if (gjkSseAny(rejected)) {
+    for (int i = 0; i < 3; i++) {
+      simplex.weights[i] = sseSelect(rejected, previousWeights[i], simplex.weights[i]);
+    }
+    simplex.count = sseSelect(_mm_castps_si128(rejected), _mm_set1_epi32(3), simplex.count);
+  }
+  __m128 going = _mm_andnot_ps(rejected, adding);
+  v = sseSelect3(going, closest, v);
+
+  // the loop head: lanes that ran out of iterations, reached the origin or
+  // got no closer to it are done
+  __m128i iterations = gjkSseLoadInt(lanes.iterations);
+  __m128i iteratingInt = _mm_and_si128(_mm_castps_si128(going),
+                                       _mm_cmplt_epi32(iterations, _mm_set1_epi32(GJK_MAX_ITERATIONS)));
+  __m128 iterating = _mm_castsi128_ps(iteratingInt);
+  iterations = _mm_sub_epi32(iterations, iteratingInt);
+  distanceSquared = sseDot3(v, v);
+  __m128 overlap = _mm_and_ps(iterating, _mm_or_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(simplex.count, _mm_set1_epi32(4))),
+                                                   _mm_cmple_ps(distanceSquared, _mm_set1_ps(GJK_OVERLAP_TOLERANCE))));
+  __m128 lastDistanceSquared = _mm_loadu_ps(lanes.last_distance_squared);
+  __m128 closer = _mm_andnot_ps(overlap, _mm_and_ps(iterating, _mm_cmplt_ps(distanceSquared, lastDistanceSquared)));
+  __m128 done = _mm_andnot_ps(closer, _mm_castsi128_ps(working));
+
+  gjkSseStoreSimplex(lanes, simplex);
+  gjkSseStore3(lanes.v, v);
+  gjkSseStoreInt(lanes.separated, _mm_castps_si128(separated));
+  gjkSseStoreInt(lanes.iterations, iterations);
+  _mm_storeu_ps(lanes.last_distance_squared, sseSelect(closer, distanceSquared, lastDistanceSquared));
+  gjkSseStoreInt(lanes.starting, _mm_setzero_si128());
+  return _mm_movemask_ps(done) | (_mm_movemask_ps(overlap) << GJK_BATCH_LANES);
+}
+#endif
+
+// Writes the lane's answer, the same one gjkDistance() or gjk() gives
+void gjkBatchFinishLane(GjkBatchLanes &lanes, int lane, bool overlapping, GjkDistanceResult distances[],
+                        bool overlaps[]) {
+  int pair = lanes.pair[lane];
+  lanes.pair[lane] = -1;
+  if (overlaps) {
+    overlaps[pair] = overlapping;
+    return;
+  }
+  GjkDistanceResult &result = distances[pair];
+  result = GjkDistanceResult();
+  result.overlapping = overlapping;
+  result.iterations = lanes.iterations[lane];
+  if (!overlapping) {
+    Simplex simplex = gjkBatchSimplex(lanes, lane);
+    glm::vec3 v = gjkBatchGetVector(lanes.v, lane);
+    result.point_a = simplex.weighted_point_a();
+    result.point_b = simplex.weighted_point_b();
+    result.distance = glm::length(v);
+    result.separating_axis = -v / result.distance;
+  }
+}
+
+// Runs the scalar query on pair
+bool gjkBatchScalar(const GjkPair &pair, int index, GjkDistanceResult distances[], bool overlaps[]) {
+  Simplex simplex;
+  if (overlaps) {
+    overlaps[index] = gjk(*pair.a, *pair.b, simplex);
+    return overlaps[index];
+  }
+  return gjkDistance(*pair.a, *pair.b, simplex, distances[index]);
+}
+
+// Hands the lane the next pair of flat hulls, the pairs it skips over go
+// through the scalar query. Returns how many of those overlap.
+int gjkBatchRefill(GjkBatchLanes &lanes, int lane, const GjkPair pairs[], int count, int &next,
+                   GjkDistanceResult distances[], bool overlaps[]) {
+  int overlapping = 0;
+  while (next < count) {
+    int pair = next++;
+    if (isFlatHull(*pairs[pair].a) && isFlatHull(*pairs[pair].b)) {
+      gjkBatchStartLane(lanes, lane, pair, pairs[pair]);
+      return overlapping;
+    }
+    overlapping += gjkBatchScalar(pairs[pair], pair, distances, overlaps);
+  }
+  return overlapping;
+}
+
+// The loop both batch queries share, distances or overlaps gets the results
+int gjkBatchRun(const GjkPair pairs[], int count, bool stopWhenApart, GjkDistanceResult distances[],
+                bool overlaps[]) {
+  int overlapping = 0;
+#if SIMD_SUPPORT_X86
+  GjkBatchLanes lanes = GjkBatchLanes();
+  int next = 0;
+  int active = 0;
+  for (int l = 0; l < GJK_BATCH_LANES; l++) {
+    lanes.pair[l] = -1;
+    overlapping += gjkBatchRefill(lanes, l, pairs, count, next, distances, overlaps);
+    active += lanes.pair[l] != -1;
+  }
+
+  int vertexCountA = 0;
+  int vertexCountB = 0;
+  int refilled = 1;
+  while (active > 0) {
+    if (refilled) {
+      vertexCountA = gjkBatchPad(lanes, lanes.vertex_count_a, lanes.padded_a, lanes.vertices_a);
+      vertexCountB = gjkBatchPad(lanes, lanes.vertex_count_b, lanes.padded_b, lanes.vertices_b);
+    }
+    int finished = sseGjkBatchStep(lanes, vertexCountA, vertexCountB, stopWhenApart);
+    refilled = finished;
+    // lanes that are done take a new pair
+    for (int l = 0; l < GJK_BATCH_LANES; l++) {
+      if (finished & (1 << l)) {
+        bool overlap = (finished >> GJK_BATCH_LANES & (1 << l)) != 0;
+        overlapping += overlap;
+        gjkBatchFinishLane(lanes, l, overlap, distances, overlaps);
+        active--;
+        overlapping += gjkBatchRefill(lanes, l, pairs, count, next, distances, overlaps);
+        active += lanes.pair[l] != -1;
+      }
+    }
+  }
+#else
+  (void)stopWhenApart;
+  for (int i = 0; i < count; i++) {
+    overlapping += gjkBatchScalar(pairs[i], i, distances, overlaps);
+  }
+#endif
+  return overlapping;
+}
+
+// Runs gjkDistance() on every pair, GJK_BATCH_LANES pairs at a time, and
+// writes the results to results[i] for pairs[i]. A lane whose pair has
+// converged is handed the next pair straight away, so one slow pair doesn't
+// hold up the others. Returns how many pairs overlap.
+int gjkDistanceBatch(const GjkPair pairs[], int count, GjkDistanceResult results[]) {
+  return gjkBatchRun(pairs, count, false, results, NULL);
+}
+
+// gjk() on every pair the same way, overlaps[i] gets whether pairs[i]
+// overlap. Returns how many do.
+int gjkBatch(const GjkPair pairs[], int count, bool overlaps[]) {
+  return gjkBatchRun(pairs, count, true, NULL, overlaps);
+}
+
+#endif
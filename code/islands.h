@@ -0,0 +1,279 @@
+#ifndef ISLANDS_H_
+#define ISLANDS_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "broadphase.h"
+#include "rigid_body_storage.h"
+
+// Islands are counted in the histogram by bodies: 1, 2-3, 4-7, ... and
+// the last bucket takes everything bigger
+#define ISLAND_HISTOGRAM_BUCKETS 12
+
+// One group of moving bodies connected through contacts, as ranges of
+// IslandGraph::island_bodies and island_edges
+struct Island {
+  int body_begin;
+  int body_end;
+  int edge_begin;
+  int edge_end;
+
+  int body_count() const {
+    return body_end - body_begin;
+  }
+
+  int edge_count() const {
+    return edge_end - edge_begin;
+  }
+};
+
+// Moving bodies split into islands by the contact edges between them, with
+// union-find. Static bodies don't join islands: a pile on the ground and
+// another pile further along the same ground don't affect each other.
+//
+// The union-find forest is kept from step to step and only changed where
+// the edges did. A new edge unions its bodies' trees. A lost edge can split
+// its island, which union-find can't undo, so the island is marked and its
+// bodies are reset and unioned again over the edges still inside it.
+// Islands whose contacts didn't change cost nothing but the find() calls
+// of the listing.
+class IslandGraph {
+public:
+  // As of the last update(), most edges first (ties by more bodies, then by
+  // the lowest body index). Every moving body is in one, alone if nothing
+  // touches it.
+  std::vector<Island> islands;
+  // the bodies of each island in turn, lowest index first
+  std::vector<int> island_bodies;
+  // the edges (indices into update()'s edges) of each island in turn, in
+  // the order they came in
+  std::vector<int> island_edges;
+  // bodies whose island split and had to be unioned again last update()
+  int resplit_bodies = 0;
+
+  // Starts over, needed once bodies have moved around in the storage
+  void reset() {
+    parent.clear();
+    sizes.clear();
+    previous_keys.clear();
+    islands.clear();
+    body_islands.clear();
+  }
+
+  // Brings the islands up to date with the edges of this step. An edge
+  // with a static body on one side belongs to the other body's island.
+  void update(const RigidBodyStorage &bodies, const std::vector<BroadphasePair> &edges) {
+    int count = bodies.size();
+    for (int i = (int)parent.size(); i < count; i++) {
+      parent.push_back(i);
+      sizes.push_back(1);
+    }
+
+    // the edges between moving bodies, sorted so they can be diffed against
+    // last step's
+    keys.clear();
+    for (const BroadphasePair &edge : edges) {
+      if (!bodies.is_static(edge.a) && !bodies.is_static(edge.b)) {
+        keys.push_back(broadphasePairKey(edge.a, edge.b));
+      }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // lost edges mark their island to be split, before the new ones merge
+    // anything into it
+    split.assign(count, 0);
+    bool splitting = false;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < previous_keys.size()) {
+      if (j < keys.size() && keys[j] < previous_keys[i]) {
+        j++;
+      }
+      else if (j < keys.size() && keys[j] == previous_keys[i]) {
+        i++;
+        j++;
+      }
+      else {
+        split[find((int)(previous_keys[i] >> 32))] = 1;
+        splitting = true;
+        i++;
+      }
+    }
+    resplit_bodies = 0;
+    if (splitting) {
+      reset_body.resize(count);
+      for (int body = 0; body < count; body++) {
+        reset_body[body] = split[find(body)];
+      }
+      for (int body = 0; body < count; body++) {
+        if (reset_body[body]) {
+          parent[body] = body;
+          sizes[body] = 1;
+          resplit_bodies++;
+        }
+      }
+      for (unsigned long long key : keys) {
+        int a = (int)(key >> 32);
+        if (reset_body[a]) {
+          unite(a, (int)(key & 0xffffffffu));
+        }
+      }
+    }
+
+    // then the new edges
+    i = 0;
+    for (unsigned long long key : keys) {
+      while (i < previous_keys.size() && previous_keys[i] < key) {
+        i++;
+      }
+      if (i == previous_keys.size() || previous_keys[i] != key) {
+        unite((int)(key >> 32), (int)(key & 0xffffffffu));
+      }
+    }
+    previous_keys.swap(keys);
+
+    list(bodies, edges);
+  }
+
+  // Island of the body's tree root, with path halving
+  int find(int body) {
+    while (parent[body] != body) {
+      parent[body] = parent[parent[body]];
+      body = parent[body];
+    }
+    return body;
+  }
+
+  // The body's index in islands as of the last update(), -1 for a static
+  // body or one that came after
+  int island_of(int body) const {
+    return body < (int)body_islands.size() ? body_islands[body] : -1;
+  }
+
+  // Islands per size bucket, see ISLAND_HISTOGRAM_BUCKETS
+  void histogram(int buckets[ISLAND_HISTOGRAM_BUCKETS]) const {
+    for (int i = 0; i < ISLAND_HISTOGRAM_BUCKETS; i++) {
+      buckets[i] = 0;
+    }
+    for (const Island &island : islands) {
+      int bucket = 0;
+      while (bucket < ISLAND_HISTOGRAM_BUCKETS - 1 && island.body_count() >> (bucket + 1)) {
+        bucket++;
+      }
+      buckets[bucket]++;
+    }
+  }
+
+private:
+  std::vector<int> parent;
+  // bodies in the tree, only meaningful at a root
+  std::vector<int> sizes;
+  std::vector<unsigned long long> previous_keys;
+  std::vector<unsigned long long> keys;
+  // per body: root of an island that lost an edge, then whether the body
+  // was in one
+  std::vector<char> split;
+  std::vector<char> reset_body;
+  // per body: its island, -1 for static bodies
+  std::vector<int> body_islands;
+  std::vector<int> root_islands;
+  // per edge: its island while listing
+  std::vector<int> edge_islands;
+  // islands in their listing order, and where each ends up after sorting
+  std::vector<int> order;
+  std::vector<int> rank;
+  std::vector<Island> sorted;
+
+  // Union by size, so trees stay shallow without full path compression
+  void unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+      return;
+    }
+    if (sizes[a] < sizes[b]) {
+      std::swap(a, b);
+    }
+    parent[b] = a;
+    sizes[a] += sizes[b];
+  }
+
+  // Lays the islands out body by body and edge by edge, largest first
+  void list(const RigidBodyStorage &bodies, const std::vector<BroadphasePair> &edges) {
+    int count = bodies.size();
+    // body_end and edge_end count the island's bodies and edges at first
+    islands.clear();
+    root_islands.assign(count, -1);
+    body_islands.assign(count, -1);
+    for (int body = 0; body < count; body++) {
+      if (bodies.is_static(body)) {
+        continue;
+      }
+      int root = find(body);
+      if (root_islands[root] < 0) {
+        root_islands[root] = (int)islands.size();
+        islands.push_back(Island{0, 0, 0, 0});
+      }
+      body_islands[body] = root_islands[root];
+      islands[root_islands[root]].body_end++;
+    }
+    edge_islands.resize(edges.size());
+    for (size_t e = 0; e < edges.size(); e++) {
+      int island = body_islands[edges[e].a] >= 0 ? body_islands[edges[e].a] : body_islands[edges[e].b];
+      edge_islands[e] = island;
+      if (island >= 0) {
+        islands[island].edge_end++;
+      }
+    }
+
+    // islands were numbered in order of their lowest body, which breaks
+    // ties in the sort
+    order.resize(islands.size());
+    for (size_t k = 0; k < islands.size(); k++) {
+      order[k] = (int)k;
+    }
+    std::sort(order.begin(), order.end(), [this](int x, int y) {
+      const Island &a = islands[x];
+      const Island &b = islands[y];
+      if (a.edge_end != b.edge_end) {
+        return a.edge_end > b.edge_end;
+      }
+      if (a.body_end != b.body_end) {
+        return a.body_end > b.body_end;
+      }
+      return x < y;
+    });
+    rank.resize(islands.size());
+    sorted.resize(islands.size());
+    int bodyOffset = 0;
+    int edgeOffset = 0;
+    for (size_t k = 0; k < order.size(); k++) {
+      const Island &island = islands[order[k]];
+      rank[order[k]] = (int)k;
+      sorted[k] = Island{bodyOffset, bodyOffset, edgeOffset, edgeOffset};
+      bodyOffset += island.body_end;
+      edgeOffset += island.edge_end;
+    }
+    islands.swap(sorted);
+
+    island_bodies.resize(bodyOffset);
+    island_edges.resize(edgeOffset);
+    for (int body = 0; body < count; body++) {
+      if (body_islands[body] >= 0) {
+        body_islands[body] = rank[body_islands[body]];
+        Island &island = islands[body_islands[body]];
+        island_bodies[island.body_end++] = body;
+      }
+    }
+    for (size_t e = 0; e < edges.size(); e++) {
+      if (edge_islands[e] >= 0) {
+        Island &island = islands[rank[edge_islands[e]]];
+        island_edges[island.edge_end++] = (int)e;
+      }
+    }
+  }
+};
+
+#endif
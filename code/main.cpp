@@ -12,11 +12,13 @@
 
 #include "cube.h"
 #include "tetrahedron.h"
+#include "gjk.h"
+#include "epa.h"
+#include "pair_cache.h"
 
 #define MAT_VALUE_LOC(mat) &mat[0][0]
 #define IDENTITY_MATRIX glm::mat4(1.0f)
 #define KEY_PRESSED(key) glfwGetKey(window, key) == GLFW_PRESS
-#define REMOVE_ELEMENT(v, i) v.erase(v.begin() + i)
 
 #define WINDOW_HEIGHT 1080
 #define WINDOW_WIDTH 1920
@@ -30,6 +32,10 @@ unsigned int simplex_indices[SIMPLEX_INDICES_NUM] = {
   0, 2, 3,
   1, 2, 3
 };
+// GJK can report a touch with only a point, segment or triangle, which are
+// drawn from the start of the same indices. Indexed by simplex size.
+const GLenum SIMPLEX_DRAW_MODES[5] = {GL_POINTS, GL_POINTS, GL_LINES, GL_TRIANGLES, GL_TRIANGLES};
+const int SIMPLEX_DRAW_INDICES[5] = {0, 1, 2, 3, SIMPLEX_INDICES_NUM};
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
   glViewport(0, 0, width, height);
@@ -83,164 +89,6 @@ void printVec3Vector(vector<glm::vec3> v) {
   }
 }
 
-enum EvolutionStage {
-  NO_INTERSECTION,
-  FOUND_INTERSECTION,
-  STILL_EVOLVING
-};
-
-glm::vec3 support(Shape shape, glm::vec3 direction) {
-  float furthestDistance = -FLT_MAX;
-  glm::vec3 furthestVertex = glm::vec3(0.0f, 0.0f, 0.0f);
-
-  for (int i = 0; i < *(shape.size); i++) {
-    glm::vec3 v = shape.world_vertices[i];
-    float distance = dot(v, direction);
-    if (distance > furthestDistance) {
-      furthestDistance = distance;
-      furthestVertex = v;
-    }
-  }
-  return furthestVertex;
-}
-
-glm::vec3 getSupport(Shape shapeA, Shape shapeB, glm::vec3 direction) {
-  return support(shapeA, direction) - support(shapeB, -direction);
-}
-
-bool addSupport(vector<glm::vec3> &simplex, Shape shapeA, Shape shapeB,
-                glm::vec3 direction) {
-  glm::vec3 new_point = getSupport(shapeA, shapeB, direction);
-  // Support termination conditions from Erin Catto's 2010 presentation advice
-  if (find(simplex.begin(), simplex.end(), new_point) != simplex.end()) {
-    return false;
-  }
-  simplex.push_back(new_point);
-  return (dot(direction, new_point) >= 0.0f);
-}
-
-glm::vec3 averagePoint(glm::vec3 points[], int size) {
-  glm::vec3 avg = glm::vec3(0.0f, 0.0f, 0.0f);
-  for (int i = 0; i < size; i++){
-    avg += points[i];
-  }
-  avg /= size;
-
-  return avg;
-}
-
-EvolutionStage evolveSimplex(vector<glm::vec3> &simplex, Shape shapeA, Shape shapeB,
-                             glm::vec3 &direction) {
-  glm::vec3 avgPointDifference = averagePoint(shapeB.world_vertices, *shapeB.size)
-        - averagePoint(shapeA.world_vertices, *shapeA.size);
-  glm::vec3 ab = glm::vec3(0.0f, 0.0f, 0.0f);
-  glm::vec3 ac = glm::vec3(0.0f, 0.0f, 0.0f);
-  glm::vec3 a0 = glm::vec3(0.0f, 0.0f, 0.0f);
-
-  switch(simplex.size()) {
-    case 0:
-      direction = avgPointDifference;
-      break;
-
-    case 1:
-      // flip the direction
-      direction = -avgPointDifference;
-      break;
-
-    case 2:
-      // line ab is the line formed by the first 2 vertices
-      ab = simplex[1] - simplex[0];
-      // line a0 is the line from the first vertex to the origin
-      a0 = -simplex[0];
-      glm::vec3 temp = cross(ab, a0);
-      direction = cross(temp, ab);
-      break;
-
-    case 3:
-      ac = simplex[2] - simplex[0];
-      ab = simplex[1] - simplex[0];
-      direction = cross(ac, ab);
-
-      // ensure that the direction points toward origin
-      a0 = -simplex[0];
-      if (dot(direction, a0) < 0) {
-        direction = -direction;
-      }
-      break;
-    case 4:
-      // calculate the 3 edges of interest
-      glm::vec3 da = simplex[3] - simplex[0];
-      glm::vec3 db = simplex[3] - simplex[1];
-      glm::vec3 dc = simplex[3] - simplex[2];
-
-      // calculate direction to the origin
-      glm::vec3 d0 = -simplex[3];
-
-      // check triangles a-b-d, b-c-d, and c-a-d
-      glm::vec3 abd_norm = cross(da, db);
-      glm::vec3 bcd_norm = cross(db, dc);
-      glm::vec3 cad_norm = cross(dc, da);
-
-      if (dot(abd_norm, d0) > 0.0f) {
-        // origin outside of a-b-d, eliminate c
-        REMOVE_ELEMENT(simplex, 2);
-        direction = abd_norm;
-      }
-      else if (dot(bcd_norm, d0) > 0.0f) {
-        // origin is outside of b-c-d, elimante a
-        REMOVE_ELEMENT(simplex, 0);
-        direction = bcd_norm;
-      }
-      else if (dot(cad_norm, d0) > 0.0f) {
-        // origin is outside of c-a-d, eliminate b
-        REMOVE_ELEMENT(simplex, 1);
-        direction = cad_norm;
-      }
-      else {
-        cout << "found intersection!" << endl;
-        // the origin is inside of all of the triangles
-        return FOUND_INTERSECTION;
-      }
-      break;
-
-    default:
-      cout << "Can't have a simplex with " << simplex.size() << " vertices!"  << endl;
-      break;
-  }
-
-  EvolutionStage evolveResult;
-  if (addSupport(simplex, shapeA, shapeB, direction)) {
-    evolveResult = STILL_EVOLVING;
-  }
-  else {
-    evolveResult = NO_INTERSECTION;
-  }
-
-  return evolveResult;
-}
-
-bool gjk(Shape shapeA, Shape shapeB, vector<glm::vec3> &simplex) {
-  EvolutionStage evolveResult = STILL_EVOLVING;
-  glm::vec3 direction = glm::vec3(1.0f, 0.0f, 0.0f);
-
-  // NOTE: GJK is very sensitive to numerical issues, termination problems may
-  // occur (see Gino's "Ill-conditioned error bounds"). I am going with
-  // a max number of loop iterations and declaring no intersection. I ran
-  // into this problem when one of the object's is either barely in or out
-  // (colliding) with the other object. I decided with "no intersection"
-  // because the simplex is needed for EPA, if I go that route. (Also at
-  // the moment I am thinking if we have gravity/other physics, the collision
-  // will either get closer or further anyways). I might look more into this
-  // in the future.
-  int loopIterations = 0;
-  while (evolveResult == STILL_EVOLVING && loopIterations != 15) {
-    evolveResult = evolveSimplex(simplex, shapeA, shapeB, direction);
-    loopIterations++;
-  }
-
-  return ((evolveResult == FOUND_INTERSECTION) ? true : false);
-}
-
 int wmain(int argc, char *argv[]) {
   glfwInit();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -320,6 +168,10 @@ int wmain(int argc, char *argv[]) {
   glGenBuffers(1, &simplex_vbo);
   glGenBuffers(1, &simplex_ebo);
 
+  // carries the last simplex and separating axis from one frame's query to
+  // the next
+  PairCache pairCache;
+
   glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 10.0f);
   glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
   glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -375,6 +227,15 @@ int wmain(int argc, char *argv[]) {
       tetrahedron.update_pos(adjustedInputPos);
     }
 
+    // Rotate tetrahedron
+    float tetrahedronTurnSpeed = glm::radians(1.0f);
+    if (KEY_PRESSED(GLFW_KEY_Z)) {
+      tetrahedron.update_orientation(glm::angleAxis(tetrahedronTurnSpeed, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    if (KEY_PRESSED(GLFW_KEY_X)) {
+      tetrahedron.update_orientation(glm::angleAxis(-tetrahedronTurnSpeed, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
     // Update camera pos based on WASD keys
     float cameraSpeed = 2.5f * deltaTime;
     if (KEY_PRESSED(GLFW_KEY_W)) {
@@ -416,13 +277,24 @@ int wmain(int argc, char *argv[]) {
     glClearColor(to_rgb(71), to_rgb(78), to_rgb(104), 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    vector<glm::vec3> simplex;
-    bool collision = gjk(tetrahedron, cube, simplex);
+    pairCache.next_frame();
+    Simplex simplex;
+    bool collision = pairCache.gjk(tetrahedron, cube, simplex);
     if (collision) {
-      cout << "There is a collision!" << endl;
+      EpaResult penetration;
+      if (epa(tetrahedron, cube, simplex, penetration)) {
+        cout << "There is a collision! (depth " << penetration.depth << ", normal "
+             << glm::to_string(penetration.normal) << ")" << endl;
+      }
+      else {
+        cout << "There is a collision!" << endl;
+      }
     }
     else {
-      cout << "NO COLLISION" << endl;
+      Simplex distanceSimplex;
+      GjkDistanceResult distance;
+      pairCache.gjkDistance(tetrahedron, cube, distanceSimplex, distance);
+      cout << "NO COLLISION (distance " << distance.distance << ")" << endl;
     }
 
     glUseProgram(shaderProgram);
@@ -449,30 +321,24 @@ int wmain(int argc, char *argv[]) {
     glm::mat4 modelMatrix;
 
     // Draw cube
-    glBindVertexArray(cube.vao);
+    cube.geometry->bind_vertex_array();
     glUniform3f(colorLoc, 0.0, 0.0, 1.0);
-    modelMatrix = glm::translate(IDENTITY_MATRIX, cube.pos);
+    modelMatrix = cube.transform.matrix();
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, MAT_VALUE_LOC(modelMatrix));
-    glDrawArrays(GL_TRIANGLES, 0, cube.VERTICES_NUM_VEC3);
+    glDrawArrays(GL_TRIANGLES, 0, cube.geometry->vertex_count());
 
     // Draw tetrahedron
-    glBindVertexArray(tetrahedron.vao);
+    tetrahedron.geometry->bind_vertex_array();
     glUniform3f(colorLoc, 1.0, 0.0, 0.0);
-    modelMatrix = glm::translate(IDENTITY_MATRIX, tetrahedron.pos);
+    modelMatrix = tetrahedron.transform.matrix();
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, MAT_VALUE_LOC(modelMatrix));
-    glDrawArrays(GL_TRIANGLES, 0, tetrahedron.VERTICES_NUM_VEC3);
+    glDrawArrays(GL_TRIANGLES, 0, tetrahedron.geometry->vertex_count());
 
-    if (collision) {
+    if (collision && simplex.size() > 0) {
       // Draw simplex
-      vector<float> simplexVector;
-      for (int i = 0; i < simplex.size(); i++) {
-        simplexVector.push_back(simplex[i].x);
-        simplexVector.push_back(simplex[i].y);
-        simplexVector.push_back(simplex[i].z);
-      }
       glBindVertexArray(simplex_vao);
       glBindBuffer(GL_ARRAY_BUFFER, simplex_vbo);
-      glBufferData(GL_ARRAY_BUFFER, simplexVector.size() * sizeof(float), &simplexVector[0], GL_STATIC_DRAW);
+      glBufferData(GL_ARRAY_BUFFER, simplex.size() * sizeof(glm::vec3), &simplex.points[0], GL_STATIC_DRAW);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, simplex_ebo);
       glBufferData(GL_ELEMENT_ARRAY_BUFFER, SIMPLEX_INDICES_NUM * sizeof(unsigned int), &simplex_indices[0], GL_STATIC_DRAW);
       glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -481,15 +347,15 @@ int wmain(int argc, char *argv[]) {
       glUniform3f(colorLoc, 0.0, 1.0, 0.0);
       modelMatrix = glm::translate(IDENTITY_MATRIX, glm::vec3(0.0f, 0.0f, 0.0f));
       glUniformMatrix4fv(modelLoc, 1, GL_FALSE, MAT_VALUE_LOC(modelMatrix));
-      glDrawElements(GL_TRIANGLES, simplexVector.size(), GL_UNSIGNED_INT, NULL);
+      glDrawElements(SIMPLEX_DRAW_MODES[simplex.size()], SIMPLEX_DRAW_INDICES[simplex.size()], GL_UNSIGNED_INT, NULL);
     }
 
-    glBindVertexArray(cube.vao);
+    cube.geometry->bind_vertex_array();
     glUniform3f(colorLoc, 0.0, 0.0, 0.0);
     float scale_factor = 0.05f;
     glm::mat4 m_scaled = glm::scale(glm::mat4(1.0f), glm::vec3(scale_factor));
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, MAT_VALUE_LOC(m_scaled));
-    glDrawArrays(GL_TRIANGLES, 0, cube.VERTICES_NUM_VEC3);
+    glDrawArrays(GL_TRIANGLES, 0, cube.geometry->vertex_count());
 
     if (glfwGetWindowAttrib(window, GLFW_FOCUSED)) {
       glfwGetCursorPos(window, &mouseXPos, &mouseYPos);
@@ -498,6 +364,7 @@ int wmain(int argc, char *argv[]) {
     glfwPollEvents();
   }
 
+  geometry_registry().delete_gpu_buffers();
   glfwTerminate();
   return 0;
 }
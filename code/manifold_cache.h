@@ -0,0 +1,289 @@
+#ifndef MANIFOLD_CACHE_H_
+#define MANIFOLD_CACHE_H_
+
+#include <math.h>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "shape.h"
+#include "contact.h"
+#include "narrowphase.h"
+
+// Pairs that weren't queried for this many frames are dropped
+#define MANIFOLD_CACHE_MAX_AGE 8
+// A point is dropped once its shapes have pulled apart along the normal by
+// more than this, or slid apart across it by more than this
+#define CONTACT_BREAKING_THRESHOLD 0.02f
+// A new point without a matching feature id replaces a cached one closer
+// than this
+#define CONTACT_MATCH_DISTANCE 0.02f
+// The narrowphase is skipped while B has moved less than this relative to A
+// since the last time it ran (and turned by less than the angle whose
+// half-angle cosine is below)
+#define MANIFOLD_SKIP_DISTANCE 0.005f
+#define MANIFOLD_SKIP_COSINE 0.99999f
+
+// A contact point kept between frames. The points are stored in each shape's
+// model space and moved with the shapes, the world space points and depth
+// are only what the last refresh made of them. The accumulated normal
+// impulse is the solver's, carried over so the next step can warm start from
+// it.
+struct ManifoldPoint {
+  glm::vec3 local_a;
+  glm::vec3 local_b;
+  glm::vec3 point_a;
+  glm::vec3 point_b;
+  float depth;
+  unsigned int id;
+  float normal_impulse;
+};
+
+// Up to 4 points of one pair of shapes that live from frame to frame. The
+// normal is kept in A's model space so it turns with A. Friction is solved
+// for the whole manifold at once, so its impulses are kept here rather than
+// per point.
+struct PersistentManifold {
+  glm::vec3 local_normal = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 normal = glm::vec3(0.0f, 0.0f, 0.0f);
+  ManifoldPoint points[CONTACT_MAX_POINTS];
+  int count = 0;
+  float tangent_impulse[2] = {0.0f, 0.0f};
+  float twist_impulse = 0.0f;
+  // where B was in A's frame the last time the narrowphase ran
+  Transform last_relative;
+  bool has_run = false;
+
+  // Forgets the points and the impulses
+  void clear() {
+    count = 0;
+    tangent_impulse[0] = 0.0f;
+    tangent_impulse[1] = 0.0f;
+    twist_impulse = 0.0f;
+  }
+
+  // Moves the points with the shapes and drops the ones that came apart.
+  // Returns how many were dropped.
+  int refresh(const Transform &transformA, const Transform &transformB) {
+    normal = transformA.to_world_direction(local_normal);
+    int dropped = 0;
+    for (int i = 0; i < count; ) {
+      ManifoldPoint &point = points[i];
+      point.point_a = transformA.to_world(point.local_a);
+      point.point_b = transformB.to_world(point.local_b);
+      glm::vec3 d = point.point_a - point.point_b;
+      point.depth = glm::dot(d, normal);
+      glm::vec3 drift = d - normal * point.depth;
+      if (point.depth < -CONTACT_BREAKING_THRESHOLD
+          || glm::dot(drift, drift) > CONTACT_BREAKING_THRESHOLD * CONTACT_BREAKING_THRESHOLD) {
+        points[i] = points[--count];
+        dropped++;
+      }
+      else {
+        i++;
+      }
+    }
+    return dropped;
+  }
+
+  // The cached point fresh is the same as: the one with its feature id, or
+  // failing that the closest one within CONTACT_MATCH_DISTANCE. -1 if none.
+  int match(const ContactPoint &fresh) const {
+    if (fresh.id != 0) {
+      for (int i = 0; i < count; i++) {
+        if (points[i].id == fresh.id) {
+          return i;
+        }
+      }
+    }
+    int closest = -1;
+    float closestDistance = CONTACT_MATCH_DISTANCE * CONTACT_MATCH_DISTANCE;
+    for (int i = 0; i < count; i++) {
+      glm::vec3 d = points[i].point_b - fresh.point_b;
+      if (glm::dot(d, d) < closestDistance) {
+        closestDistance = glm::dot(d, d);
+        closest = i;
+      }
+    }
+    return closest;
+  }
+
+  // Folds a fresh narrowphase manifold in. A manifold of several points (the
+  // box SAT) is complete and replaces the cached points, a single point (GJK
+  // + EPA) is added to them so a resting face builds up its points over a few
+  // frames. Either way matched points keep their impulses, and more than 4
+  // are reduced to the 4 spanning the most area. Returns how many fresh
+  // points matched a cached one.
+  int merge(const ContactManifold &fresh, const Transform &transformA, const Transform &transformB) {
+    ManifoldPoint merged[2 * CONTACT_MAX_POINTS];
+    ContactPoint candidates[2 * CONTACT_MAX_POINTS];
+    bool taken[CONTACT_MAX_POINTS] = {false, false, false, false};
+    int mergedCount = 0;
+    int matched = 0;
+    for (int i = 0; i < fresh.count; i++) {
+      const ContactPoint &contact = fresh.points[i];
+      ManifoldPoint &point = merged[mergedCount];
+      point.local_a = transformA.to_local(contact.point_a);
+      point.local_b = transformB.to_local(contact.point_b);
+      point.point_a = contact.point_a;
+      point.point_b = contact.point_b;
+      point.depth = contact.depth;
+      point.id = contact.id;
+      point.normal_impulse = 0.0f;
+      int old = match(contact);
+      if (old != -1 && !taken[old]) {
+        taken[old] = true;
+        point.normal_impulse = points[old].normal_impulse;
+        matched++;
+      }
+      candidates[mergedCount++] = contact;
+    }
+    if (fresh.count == 1) {
+      for (int i = 0; i < count; i++) {
+        if (!taken[i]) {
+          merged[mergedCount] = points[i];
+          candidates[mergedCount].point_a = points[i].point_a;
+          candidates[mergedCount].point_b = points[i].point_b;
+          candidates[mergedCount].depth = points[i].depth;
+          candidates[mergedCount].id = points[i].id;
+          mergedCount++;
+        }
+      }
+    }
+
+    local_normal = transformA.to_local_direction(fresh.normal);
+    normal = fresh.normal;
+    int kept[CONTACT_MAX_POINTS];
+    count = reduceContactPoints(candidates, mergedCount, normal, kept);
+    for (int i = 0; i < count; i++) {
+      points[i] = merged[kept[i]];
+    }
+    return matched;
+  }
+
+  void to_contact_manifold(ContactManifold &manifold) const {
+    manifold.clear();
+    manifold.normal = normal;
+    for (int i = 0; i < count; i++) {
+      manifold.add_point(points[i].point_a, points[i].point_b, points[i].depth, points[i].id);
+    }
+  }
+};
+
+// Persistent manifolds per pair of shapes, keyed by the shape ids like
+// PairCache. Every query refreshes the cached points under the new
+// transforms first. If the pair has barely moved since the narrowphase last
+// ran and nothing was dropped, the refreshed points are the answer and the
+// narrowphase is skipped.
+class ManifoldCache {
+public:
+  // counters since the last reset_stats()
+  long long queries = 0;
+  long long skipped = 0;
+  // narrowphase points, and how many of them matched a cached point
+  long long fresh_points = 0;
+  long long matched_points = 0;
+  long long dropped_points = 0;
+
+  // The pair's manifold, made empty if it has none. Querying a resting pair
+  // ends its rest.
+  PersistentManifold &find(const Shape &shapeA, const Shape &shapeB) {
+    unsigned long long key = ((unsigned long long)shapeA.id << 32) | shapeB.id;
+    Entry &entry = entries[key];
+    entry.last_used = frame;
+    entry.resting = false;
+    return entry.manifold;
+  }
+
+  // Keeps the pair's manifold without it being queried, for a pair that
+  // fell asleep with its points. It is kept until the next find().
+  void rest(const Shape &shapeA, const Shape &shapeB) {
+    unsigned long long key = ((unsigned long long)shapeA.id << 32) | shapeB.id;
+    Entry &entry = entries[key];
+    entry.last_used = frame;
+    entry.resting = true;
+  }
+
+  // manifold gets the pair's persistent points, false if there are none
+  bool collide(const Shape &shapeA, const Shape &shapeB, ContactManifold &manifold) {
+    PersistentManifold &persistent = find(shapeA, shapeB);
+    queries++;
+    int dropped = persistent.refresh(shapeA.transform, shapeB.transform);
+    dropped_points += dropped;
+
+    Transform relative;
+    glm::quat inverseA = glm::conjugate(shapeA.transform.orientation);
+    relative.position = shapeA.transform.to_local(shapeB.transform.position);
+    relative.orientation = inverseA * shapeB.transform.orientation;
+    if (persistent.has_run && persistent.count > 0 && dropped == 0) {
+      glm::vec3 moved = relative.position - persistent.last_relative.position;
+      float turned = fabsf(glm::dot(relative.orientation, persistent.last_relative.orientation));
+      if (glm::dot(moved, moved) < MANIFOLD_SKIP_DISTANCE * MANIFOLD_SKIP_DISTANCE
+          && turned > MANIFOLD_SKIP_COSINE) {
+        skipped++;
+        persistent.to_contact_manifold(manifold);
+        return true;
+      }
+    }
+
+    ContactManifold fresh;
+    persistent.last_relative = relative;
+    persistent.has_run = true;
+    if (!narrowphase(shapeA, shapeB, fresh)) {
+      persistent.clear();
+      manifold.clear();
+      return false;
+    }
+    fresh_points += fresh.count;
+    matched_points += persistent.merge(fresh, shapeA.transform, shapeB.transform);
+    persistent.to_contact_manifold(manifold);
+    return manifold.count > 0;
+  }
+
+  // Call once per step, forgets pairs that stopped being queried and aren't
+  // resting
+  void next_frame() {
+    frame++;
+    for (auto it = entries.begin(); it != entries.end(); ) {
+      if (!it->second.resting && frame - it->second.last_used > MANIFOLD_CACHE_MAX_AGE) {
+        it = entries.erase(it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  // share of narrowphase points that were already in the cache
+  float hit_rate() const {
+    return fresh_points ? (float)matched_points / fresh_points : 0.0f;
+  }
+
+  float skip_rate() const {
+    return queries ? (float)skipped / queries : 0.0f;
+  }
+
+  void reset_stats() {
+    queries = 0;
+    skipped = 0;
+    fresh_points = 0;
+    matched_points = 0;
+    dropped_points = 0;
+  }
+
+  int size() const {
+    return (int)entries.size();
+  }
+
+private:
+  struct Entry {
+    PersistentManifold manifold;
+    int last_used = 0;
+    bool resting = false;
+  };
+
+  std::unordered_map<unsigned long long, Entry> entries;
+  int frame = 0;
+};
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef NARROWPHASE_H_
+#define NARROWPHASE_H_
+
+#include <float.h>
+#include <math.h>
+#include <glm/glm.hpp>
+
+#include "shape.h"
+#include "sphere.h"
+#include "capsule.h"
+#include "box.h"
+#include "cylinder.h"
+#include "cone.h"
+#include "gjk.h"
+#include "epa.h"
+#include "contact.h"
+#include "box_box.h"
+
+// Anything without a closed form test, through GJK and then EPA.
+// The manifold is the single deepest point EPA finds.
+bool collideGjkEpa(const Shape &shapeA, const Shape &shapeB, ContactManifold &manifold) {
+  manifold.clear();
+  Simplex simplex;
+  GjkDistanceResult distance;
+  EpaResult result;
+  if (!gjkDistance(shapeA, shapeB, simplex, distance) || !epa(shapeA, shapeB, simplex, result)) {
+    return false;
+  }
+  manifold.normal = result.normal;
+  manifold.add_point(result.point_a, result.point_b, result.depth);
+  return true;
+}
+
+// Two spheres, or anything that comes down to two points with a radius each
+// (capsule cores, a rounded box's closest core point)
+bool collideRoundedPoints(glm::vec3 centreA, float radiusA, glm::vec3 centreB, float radiusB,
+                          ContactManifold &manifold) {
+  manifold.clear();
+  glm::vec3 d = centreB - centreA;
+  float distanceSquared = glm::dot(d, d);
+  float radii = radiusA + radiusB;
+  if (distanceSquared >= radii * radii) {
+    return false;
+  }
+  float distance = sqrtf(distanceSquared);
+  // on top of each other, any way out is as good as another
+  glm::vec3 normal = (distance > 0.0f) ? d / distance : glm::vec3(1.0f, 0.0f, 0.0f);
+  manifold.normal = normal;
+  manifold.add_point(centreA + normal * radiusA, centreB - normal * radiusB, radii - distance);
+  return true;
+}
+
+// Works on the box's core, so rounded boxes (margin > 0) are exact too
+bool collideSphereBox(glm::vec3 centre, float radius, const OrientedBox &box, float margin,
+                      ContactManifold &manifold) {
+  glm::vec3 local = box.to_local(centre);
+  glm::vec3 closest = glm::clamp(local, -box.half_extents, box.half_extents);
+  if (closest != local) {
+    return collideRoundedPoints(centre, radius, box.to_world(closest), margin, manifold);
+  }
+
+  // the centre is inside the core, push it out through the nearest face
+  manifold.clear();
+  glm::vec3 gap = box.half_extents - glm::abs(local);
+  int axis = (gap.x <= gap.y && gap.x <= gap.z) ? 0 : (gap.y <= gap.z ? 1 : 2);
+  glm::vec3 normal = (local[axis] >= 0.0f) ? -box.axes[axis] : box.axes[axis];
+  float depth = gap[axis] + radius + margin;
+  glm::vec3 pointA = centre + normal * radius;
+  manifold.normal = normal;
+  manifold.add_point(pointA, pointA - normal * depth, depth);
+  return true;
+}
+
+glm::vec3 closestPointOnSegment(glm::vec3 point, glm::vec3 start, glm::vec3 end) {
+  glm::vec3 segment = end - start;
+  float lengthSquared = glm::dot(segment, segment);
+  if (lengthSquared <= 0.0f) {
+    return start;
+  }
+  float t = glm::clamp(glm::dot(point - start, segment) / lengthSquared, 0.0f, 1.0f);
+  return start + t * segment;
+}
+
+// Closest points between segments p1-q1 and p2-q2, Ericson's Real-Time
+// Collision Detection (5.1.9)
+void closestPointsOnSegments(glm::vec3 p1, glm::vec3 q1, glm::vec3 p2, glm::vec3 q2,
+                             glm::vec3 &closest1, glm::vec3 &closest2) {
+  glm::vec3 d1 = q1 - p1;
+  glm::vec3 d2 = q2 - p2;
+  glm::vec3 r = p1 - p2;
+  float a = glm::dot(d1, d1);
+  float e = glm::dot(d2, d2);
+  float f = glm::dot(d2, r);
+  float s = 0.0f;
+  float t = 0.0f;
+  if (a <= FLT_EPSILON && e <= FLT_EPSILON) {
+    closest1 = p1;
+    closest2 = p2;
+    return;
+  }
+  if (a <= FLT_EPSILON) {
+    t = glm::clamp(f / e, 0.0f, 1.0f);
+  }
+  else {
+    float c = glm::dot(d1, r);
+    if (e <= FLT_EPSILON) {
+      s = glm::clamp(-c / a, 0.0f, 1.0f);
+    }
+    else {
+      float b = glm::dot(d1, d2);
+      float denom = a * e - b * b;
+      // parallel segments have no single closest pair, any s will do
+      s = (denom != 0.0f) ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+      t = (b * s + f) / e;
+      if (t < 0.0f) {
+        t = 0.0f;
+        s = glm::clamp(-c / a, 0.0f, 1.0f);
+      }
+      else if (t > 1.0f) {
+        t = 1.0f;
+        s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+      }
+    }
+  }
+  closest1 = p1 + d1 * s;
+  closest2 = p2 + d2 * t;
+}
+
+// World space end points of a capsule's core
+void capsuleSegment(const Capsule &capsule, glm::vec3 &start, glm::vec3 &end) {
+  start = capsule.transform.to_world(glm::vec3(0.0f, -capsule.half_height, 0.0f));
+  end = capsule.transform.to_world(glm::vec3(0.0f, capsule.half_height, 0.0f));
+}
+
+// The kernel for a pair of shape classes, picked at compile time. Pairs
+// without a specialisation below take the general GJK + EPA path.
+template <class A, class B>
+struct Collider {
+  static bool collide(const A &shapeA, const B &shapeB, ContactManifold &manifold) {
+    return collideGjkEpa(shapeA, shapeB, manifold);
+  }
+};
+
+// B-A pairs reuse the A-B kernel and flip its manifold
+template <class A, class B>
+struct FlippedCollider {
+  static bool collide(const A &shapeA, const B &shapeB, ContactManifold &manifold) {
+    if (!Collider<B, A>::collide(shapeB, shapeA, manifold)) {
+      return false;
+    }
+    manifold.flip();
+    return true;
+  }
+};
+
+template <>
+struct Collider<Sphere, Sphere> {
+  static bool collide(const Sphere &sphereA, const Sphere &sphereB, ContactManifold &manifold) {
+    return collideRoundedPoints(sphereA.transform.position, sphereA.radius(),
+                                sphereB.transform.position, sphereB.radius(), manifold);
+  }
+};
+
+template <>
+struct Collider<Sphere, Capsule> {
+  static bool collide(const Sphere &sphere, const Capsule &capsule, ContactManifold &manifold) {
+    glm::vec3 start, end;
+    capsuleSegment(capsule, start, end);
+    glm::vec3 centre = sphere.transform.position;
+    return collideRoundedPoints(centre, sphere.radius(),
+                                closestPointOnSegment(centre, start, end), capsule.radius(), manifold);
+  }
+};
+
+template <>
+struct Collider<Capsule, Capsule> {
+  static bool collide(const Capsule &capsuleA, const Capsule &capsuleB, ContactManifold &manifold) {
+    glm::vec3 startA, endA, startB, endB;
+    capsuleSegment(capsuleA, startA, endA);
+    capsuleSegment(capsuleB, startB, endB);
+    glm::vec3 closestA, closestB;
+    closestPointsOnSegments(startA, endA, startB, endB, closestA, closestB);
+    return collideRoundedPoints(closestA, capsuleA.radius(), closestB, capsuleB.radius(), manifold);
+  }
+};
+
+template <>
+struct Collider<Sphere, Box> {
+  static bool collide(const Sphere &sphere, const Box &box, ContactManifold &manifold) {
+    return collideSphereBox(sphere.transform.position, sphere.radius(), orientedBox(box), box.margin, manifold);
+  }
+};
+
+template <>
+struct Collider<Sphere, Cube> {
+  static bool collide(const Sphere &sphere, const Cube &cube, ContactManifold &manifold) {
+    return collideSphereBox(sphere.transform.position, sphere.radius(), orientedBox(cube), 0.0f, manifold);
+  }
+};
+
+// Any mix of Boxes and Cubes, up to 4 points from the SAT. Rounded boxes go
+// through GJK + EPA.
+template <class A, class B>
+struct BoxBoxCollider {
+  static bool collide(const A &boxA, const B &boxB, ContactManifold &manifold) {
+    if (boxA.margin > 0.0f || boxB.margin > 0.0f) {
+      return collideGjkEpa(boxA, boxB, manifold);
+    }
+    return boxBoxManifold(orientedBox(boxA), orientedBox(boxB), manifold);
+  }
+};
+
+template <> struct Collider<Box, Box> : BoxBoxCollider<Box, Box> {};
+template <> struct Collider<Box, Cube> : BoxBoxCollider<Box, Cube> {};
+template <> struct Collider<Cube, Box> : BoxBoxCollider<Cube, Box> {};
+template <> struct Collider<Cube, Cube> : BoxBoxCollider<Cube, Cube> {};
+
+template <> struct Collider<Capsule, Sphere> : FlippedCollider<Capsule, Sphere> {};
+template <> struct Collider<Box, Sphere> : FlippedCollider<Box, Sphere> {};
+template <> struct Collider<Cube, Sphere> : FlippedCollider<Cube, Sphere> {};
+
+// Pairs whose classes are known where the call is made go straight to their
+// kernel, collide(sphere, box, manifold) compiles down to the sphere-box test
+template <class A, class B>
+bool collide(const A &shapeA, const B &shapeB, ContactManifold &manifold) {
+  return Collider<A, B>::collide(shapeA, shapeB, manifold);
+}
+
+// The class behind each ShapeType, every other hull is just a Shape
+template <int T> struct ShapeClass { typedef Shape type; };
+template <> struct ShapeClass<SHAPE_SPHERE> { typedef Sphere type; };
+template <> struct ShapeClass<SHAPE_CAPSULE> { typedef Capsule type; };
+template <> struct ShapeClass<SHAPE_BOX> { typedef Box type; };
+template <> struct ShapeClass<SHAPE_CUBE> { typedef Cube type; };
+template <> struct ShapeClass<SHAPE_CYLINDER> { typedef Cylinder type; };
+template <> struct ShapeClass<SHAPE_CONE> { typedef Cone type; };
+
+typedef bool (*CollideFunction)(const Shape &shapeA, const Shape &shapeB, ContactManifold &manifold);
+
+template <int typeA, int typeB>
+bool collideAs(const Shape &shapeA, const Shape &shapeB, ContactManifold &manifold) {
+  typedef typename ShapeClass<typeA>::type A;
+  typedef typename ShapeClass<typeB>::type B;
+  return Collider<A, B>::collide(static_cast<const A &>(shapeA), static_cast<const B &>(shapeB), manifold);
+}
+
+#define NARROWPHASE_ROW(A) \
+  {collideAs<A, SHAPE_HULL>, collideAs<A, SHAPE_SPHERE>, collideAs<A, SHAPE_CAPSULE>, \
+   collideAs<A, SHAPE_BOX>, collideAs<A, SHAPE_CUBE>, collideAs<A, SHAPE_CYLINDER>, collideAs<A, SHAPE_CONE>}
+
+// For pairs only known as Shapes: one table lookup on the two types, then
+// the same kernel collide() would have picked
+bool narrowphase(const Shape &shapeA, const Shape &shapeB, ContactManifold &manifold) {
+  static_assert(SHAPE_TYPE_COUNT == 7, "narrowphase table needs a row and column per ShapeType");
+  static const CollideFunction table[SHAPE_TYPE_COUNT][SHAPE_TYPE_COUNT] = {
+    NARROWPHASE_ROW(SHAPE_HULL),
+    NARROWPHASE_ROW(SHAPE_SPHERE),
+    NARROWPHASE_ROW(SHAPE_CAPSULE),
+    NARROWPHASE_ROW(SHAPE_BOX),
+    NARROWPHASE_ROW(SHAPE_CUBE),
+    NARROWPHASE_ROW(SHAPE_CYLINDER),
+    NARROWPHASE_ROW(SHAPE_CONE),
+  };
+  return table[shapeA.type][shapeB.type](shapeA, shapeB, manifold);
+}
+
+#undef NARROWPHASE_ROW
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef PAIR_CACHE_H_
+#define PAIR_CACHE_H_
+
+#include <unordered_map>
+#include "gjk.h"
+
+// Pairs that weren't queried for this many frames are dropped
+#define PAIR_CACHE_MAX_AGE 8
+
+// Frame to frame GJK state per pair of shapes, keyed by the shape ids. Bodies
+// only move a little per step, so last frame's simplex is usually still
+// (almost) the answer and the query seeded from it finishes right away.
+//
+// The key is ordered: querying (a, b) and (b, a) uses two entries, since the
+// cached vertex indices belong to a specific side.
+class PairCache {
+public:
+  // counters since the last reset_stats()
+  long long queries = 0;
+  long long hits = 0;
+  long long iterations = 0;
+
+  GjkCache &find(const Shape &shapeA, const Shape &shapeB) {
+    unsigned long long key = ((unsigned long long)shapeA.id << 32) | shapeB.id;
+    Entry &entry = entries[key];
+    entry.last_used = frame;
+    return entry.cache;
+  }
+
+  bool gjk(const Shape &shapeA, const Shape &shapeB, Simplex &simplex) {
+    GjkCache &cache = find(shapeA, shapeB);
+    bool overlapping = ::gjk(shapeA, shapeB, simplex, &cache);
+    count(cache);
+    return overlapping;
+  }
+
+  bool gjkDistance(const Shape &shapeA, const Shape &shapeB, Simplex &simplex,
+                   GjkDistanceResult &result) {
+    GjkCache &cache = find(shapeA, shapeB);
+    bool overlapping = ::gjkDistance(shapeA, shapeB, simplex, result, &cache);
+    count(cache);
+    return overlapping;
+  }
+
+  // Call once per step, forgets pairs that stopped being queried
+  void next_frame() {
+    frame++;
+    for (auto it = entries.begin(); it != entries.end(); ) {
+      if (frame - it->second.last_used > PAIR_CACHE_MAX_AGE) {
+        it = entries.erase(it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  float hit_rate() const {
+    return queries ? (float)hits / queries : 0.0f;
+  }
+
+  float average_iterations() const {
+    return queries ? (float)iterations / queries : 0.0f;
+  }
+
+  void reset_stats() {
+    queries = 0;
+    hits = 0;
+    iterations = 0;
+  }
+
+  int size() const {
+    return (int)entries.size();
+  }
+
+private:
+  struct Entry {
+    GjkCache cache;
+    int last_used = 0;
+  };
+
+  std::unordered_map<unsigned long long, Entry> entries;
+  int frame = 0;
+
+  void count(const GjkCache &cache) {
+    queries++;
+    hits += cache.simplex_hit;
+    iterations += cache.iterations;
+  }
+};
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef RIGID_BODY_STORAGE_H_
+#define RIGID_BODY_STORAGE_H_
+
+#include <math.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "shape.h"
+
+// Principal moments of inertia of shape in its model space. A sphere's are
+// exact, every other shape is treated as the box bounding it in model
+// space (exact for boxes and cubes, close enough for the rest).
+glm::vec3 shapeInertia(const Shape &shape, float mass) {
+  if (shape.type == SHAPE_SPHERE) {
+    float moment = 0.4f * mass * shape.margin * shape.margin;
+    return glm::vec3(moment, moment, moment);
+  }
+  glm::vec3 half;
+  for (int axis = 0; axis < 3; axis++) {
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, 0.0f);
+    direction[axis] = 1.0f;
+    int index = 0;
+    float high = shape.local_support(direction, &index)[axis];
+    float low = shape.local_support(-direction, &index)[axis];
+    half[axis] = 0.5f * (high - low) + shape.margin;
+  }
+  glm::vec3 squared = half * half;
+  return mass / 3.0f * glm::vec3(squared.y + squared.z, squared.x + squared.z, squared.x + squared.y);
+}
+
+// Names a body for as long as it lives. The storage keeps bodies packed, so
+// removing one moves another into its place, but a handle still finds its
+// body through the slot it was given. The generation tells a handle to a
+// removed body from one to whatever reused its slot.
+struct BodyHandle {
+  unsigned int slot = 0xffffffffu;
+  unsigned int generation = 0;
+};
+
+// Rigid bodies as one array per field, so a pass over every body streams
+// only the fields it uses. Body i is entry i of every array; the indices
+// are only good until the next remove(), handles stay good.
+//
+// Positions and orientations live here, the shapes' transforms are a copy
+// for the collision code that write_transforms() refreshes. The centre of
+// mass is the shape's model space origin. A body of mass 0 is static:
+// nothing moves it and it never gets a velocity. A moving body put to
+// sleep() keeps still, without a velocity or gravity, until it's woken.
+class RigidBodyStorage {
+public:
+  // not owned, the shapes outlive the storage
+  std::vector<Shape *> shapes;
+  std::vector<glm::vec3> positions;
+  std::vector<glm::quat> orientations;
+  std::vector<glm::vec3> linear_velocities;
+  std::vector<glm::vec3> angular_velocities;
+  // What the contact solver pushes each body by to undo penetration. Only
+  // the next integrate_positions() moves the body with it, so pushing bodies
+  // apart never leaves them with the speed to fly apart.
+  std::vector<glm::vec3> push_velocities;
+  std::vector<glm::vec3> turn_velocities;
+  std::vector<float> inverse_masses;
+  // inverse principal moments, in model space
+  std::vector<glm::vec3> local_inverse_inertias;
+  // the same in world space, as of the last update_inertia()
+  std::vector<glm::mat3> inverse_inertias;
+  std::vector<float> frictions;
+  // 1 for a moving body that isn't asleep, never for a static one
+  std::vector<unsigned char> awake;
+  // how long the body has been slow enough to sleep
+  std::vector<float> sleep_timers;
+
+  int size() const {
+    return (int)shapes.size();
+  }
+
+  // Starts the body at the shape's current transform
+  BodyHandle add(Shape *shape, float mass) {
+    int index = size();
+    shapes.push_back(shape);
+    positions.push_back(shape->transform.position);
+    orientations.push_back(shape->transform.orientation);
+    linear_velocities.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    angular_velocities.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    push_velocities.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    turn_velocities.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    inverse_masses.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+    local_inverse_inertias.push_back(mass > 0.0f ? 1.0f / shapeInertia(*shape, mass) : glm::vec3(0.0f, 0.0f, 0.0f));
+    inverse_inertias.push_back(glm::mat3(0.0f));
+    frictions.push_back(0.5f);
+    awake.push_back(mass > 0.0f ? 1 : 0);
+    sleep_timers.push_back(0.0f);
+    update_inertia(index);
+
+    BodyHandle handle;
+    if (free_slots.empty()) {
+      handle.slot = (unsigned int)slots.size();
+      slots.push_back(Slot());
+    }
+    else {
+      handle.slot = free_slots.back();
+      free_slots.pop_back();
+    }
+    handle.generation = slots[handle.slot].generation;
+    slots[handle.slot].index = index;
+    body_slots.push_back(handle.slot);
+    return handle;
+  }
+
+  // Moves the last body into the removed one's place
+  void remove(BodyHandle handle) {
+    int index = this->index(handle);
+    if (index < 0) {
+      return;
+    }
+    int last = size() - 1;
+    if (index != last) {
+      shapes[index] = shapes[last];
+      positions[index] = positions[last];
+      orientations[index] = orientations[last];
+      linear_velocities[index] = linear_velocities[last];
+      angular_velocities[index] = angular_velocities[last];
+      push_velocities[index] = push_velocities[last];
+      turn_velocities[index] = turn_velocities[last];
+      inverse_masses[index] = inverse_masses[last];
+      local_inverse_inertias[index] = local_inverse_inertias[last];
+      inverse_inertias[index] = inverse_inertias[last];
+      frictions[index] = frictions[last];
+      awake[index] = awake[last];
+      sleep_timers[index] = sleep_timers[last];
+      body_slots[index] = body_slots[last];
+      slots[body_slots[index]].index = index;
+    }
+    shapes.pop_back();
+    positions.pop_back();
+    orientations.pop_back();
+    linear_velocities.pop_back();
+    angular_velocities.pop_back();
+    push_velocities.pop_back();
+    turn_velocities.pop_back();
+    inverse_masses.pop_back();
+    local_inverse_inertias.pop_back();
+    inverse_inertias.pop_back();
+    frictions.pop_back();
+    awake.pop_back();
+    sleep_timers.pop_back();
+    body_slots.pop_back();
+    slots[handle.slot].index = -1;
+    slots[handle.slot].generation++;
+    free_slots.push_back(handle.slot);
+  }
+
+  // Where the body is in the arrays, -1 once it's removed
+  int index(BodyHandle handle) const {
+    if (handle.slot >= slots.size() || slots[handle.slot].generation != handle.generation) {
+      return -1;
+    }
+    return slots[handle.slot].index;
+  }
+
+  BodyHandle handle(int index) const {
+    BodyHandle handle;
+    handle.slot = body_slots[index];
+    handle.generation = slots[handle.slot].generation;
+    return handle;
+  }
+
+  bool is_static(int index) const {
+    return inverse_masses[index] == 0.0f;
+  }
+
+  // Stops the body where it is
+  void sleep(int index) {
+    awake[index] = 0;
+    linear_velocities[index] = glm::vec3(0.0f, 0.0f, 0.0f);
+    angular_velocities[index] = glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+
+  // Static bodies stay as they are
+  void wake(int index) {
+    if (!is_static(index)) {
+      awake[index] = 1;
+      sleep_timers[index] = 0.0f;
+    }
+  }
+
+  // Turns the inverse inertia of every body into world space for its
+  // current orientation
+  void update_inertia() {
+    int count = size();
+    for (int i = 0; i < count; i++) {
+      update_inertia(i);
+    }
+  }
+
+  // R * diagonal * R^T written out: it's symmetric, so 6 sums of 3 terms
+  // instead of two full matrix products
+  void update_inertia(int index) {
+    glm::quat q = orientations[index];
+    glm::vec3 d = local_inverse_inertias[index];
+    // rows of the rotation matrix
+    float r00 = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
+    float r01 = 2.0f * (q.x * q.y - q.w * q.z);
+    float r02 = 2.0f * (q.x * q.z + q.w * q.y);
+    float r10 = 2.0f * (q.x * q.y + q.w * q.z);
+    float r11 = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
+    float r12 = 2.0f * (q.y * q.z - q.w * q.x);
+    float r20 = 2.0f * (q.x * q.z - q.w * q.y);
+    float r21 = 2.0f * (q.y * q.z + q.w * q.x);
+    float r22 = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+    float i00 = r00 * r00 * d.x + r01 * r01 * d.y + r02 * r02 * d.z;
+    float i01 = r00 * r10 * d.x + r01 * r11 * d.y + r02 * r12 * d.z;
+    float i02 = r00 * r20 * d.x + r01 * r21 * d.y + r02 * r22 * d.z;
+    float i11 = r10 * r10 * d.x + r11 * r11 * d.y + r12 * r12 * d.z;
+    float i12 = r10 * r20 * d.x + r11 * r21 * d.y + r12 * r22 * d.z;
+    float i22 = r20 * r20 * d.x + r21 * r21 * d.y + r22 * r22 * d.z;
+    inverse_inertias[index] = glm::mat3(i00, i01, i02, i01, i11, i12, i02, i12, i22);
+  }
+
+  // Static and sleeping bodies get gravity times 0, so the loop has no
+  // branch to stop it vectorising
+  void integrate_velocities(glm::vec3 gravity, float dt) {
+    int count = size();
+    glm::vec3 *velocity = linear_velocities.data();
+    const unsigned char *moving = awake.data();
+    for (int i = 0; i < count; i++) {
+      float moves = moving[i] ? dt : 0.0f;
+      velocity[i] += gravity * moves;
+    }
+  }
+
+  // Semi-implicit Euler, the orientations turned by the angular velocities
+  // and renormalised. The push and turn velocities are used up. Static and
+  // sleeping bodies have no velocity, so they go through unchanged.
+  void integrate_positions(float dt) {
+    int count = size();
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vec3 arrays are walked as float arrays");
+    // every vec3 array has the same layout, so the linear part is one flat
+    // loop over floats
+    float *position = &positions.data()->x;
+    const float *velocity = &linear_velocities.data()->x;
+    float *push = &push_velocities.data()->x;
+    for (int i = 0; i < 3 * count; i++) {
+      position[i] += (velocity[i] + push[i]) * dt;
+      push[i] = 0.0f;
+    }
+    glm::quat *orientation = orientations.data();
+    const glm::vec3 *angular = angular_velocities.data();
+    glm::vec3 *turn = turn_velocities.data();
+    float half = 0.5f * dt;
+    for (int i = 0; i < count; i++) {
+      glm::vec3 w = (angular[i] + turn[i]) * half;
+      glm::quat q = orientation[i];
+      // q + (0, w) * q, written out
+      float x = q.x + w.x * q.w + w.y * q.z - w.z * q.y;
+      float y = q.y + w.y * q.w + w.z * q.x - w.x * q.z;
+      float z = q.z + w.z * q.w + w.x * q.y - w.y * q.x;
+      float s = q.w - w.x * q.x - w.y * q.y - w.z * q.z;
+      // a fast spin (w near 1) grows q well past unit length in one step,
+      // so it gets a full renormalisation
+      orientation[i] = glm::normalize(glm::quat(s, x, y, z));
+      turn[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+  }
+
+  // Copies the poses to the shapes for the collision code
+  void write_transforms() {
+    int count = size();
+    for (int i = 0; i < count; i++) {
+      shapes[i]->transform.position = positions[i];
+      shapes[i]->transform.orientation = orientations[i];
+    }
+  }
+
+private:
+  // index is -1 while the slot is free
+  struct Slot {
+    int index = -1;
+    unsigned int generation = 0;
+  };
+
+  std::vector<Slot> slots;
+  std::vector<unsigned int> free_slots;
+  // the slot of every body, to fix the slot up when the body moves
+  std::vector<unsigned int> body_slots;
+};
+
+#endif
@@ -1,41 +1,98 @@
 #ifndef SHAPE_H_
 #define SHAPE_H_
 #include <iostream>
+#include "geometry.h"
+#include "transform.h"
 
+// What a shape is, so the narrowphase can pick a closed form test for the
+// pair. Cube is a vertex hull but also a box, any other hull (Tetrahedron) is
+// just a hull.
+enum ShapeType {
+  SHAPE_HULL,
+  SHAPE_SPHERE,
+  SHAPE_CAPSULE,
+  SHAPE_BOX,
+  SHAPE_CUBE,
+  SHAPE_CYLINDER,
+  SHAPE_CONE,
+  SHAPE_TYPE_COUNT
+};
+
+// A shape instance is only a transform and a handle to model space geometry
+// that is shared by every instance of the same shape (for both collision and
+// rendering), moving one never touches its vertices.
+//
+// Implicit shapes (spheres, capsules, ...) have no geometry and override
+// local_support/local_centroid with closed form versions instead.
 class Shape {
 public:
-  unsigned int vao;
-  unsigned int vbo;
-  glm::vec3 pos;
-  glm::vec3* model_vertices;
-  glm::vec3* world_vertices;
-  const int* size;
+  // unique per shape, pair caches are keyed by it
+  unsigned int id;
+  ShapeType type = SHAPE_HULL;
+  GeometryHandle geometry;
+  Transform transform;
+  // radius of a sphere swept over the shape (its core), rounds off every
+  // corner and edge. A sphere is a point core with a margin.
+  float margin = 0.0f;
 
-  virtual void update_pos(glm::vec3 new_pos) {
-    pos += new_pos;
-    for (int i = 0; i < *size; i++) {
-      world_vertices[i] += new_pos;
-    }
+  Shape() : id(next_id()) {}
+
+  // A copy is another body, it gets its own id so it doesn't share the
+  // original's cached pairs and manifolds. Assigning keeps the target's id.
+  Shape(const Shape &other)
+      : id(next_id()),
+        type(other.type),
+        geometry(other.geometry),
+        transform(other.transform),
+        margin(other.margin) {}
+
+  Shape &operator=(const Shape &other) {
+    type = other.type;
+    geometry = other.geometry;
+    transform = other.transform;
+    margin = other.margin;
+    return *this;
+  }
+
+  // bodies own their shapes through Shape pointers
+  virtual ~Shape() = default;
+
+  // the hull's centroid is precomputed in model space, so this is O(1)
+  glm::vec3 centroid() const {
+    return transform.to_world(local_centroid());
   }
 
-protected:
-  virtual void gen_and_bind_vao_vbo() {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  virtual glm::vec3 local_centroid() const {
+    return geometry->hull.centroid;
+  }
+
+  // Point of the core furthest along direction, both in model space. index
+  // comes in as the hull vertex to start walking a big hull from (the
+  // caller's last query on this shape, 0 without one) and gets the hull
+  // vertex the point is, -1 for implicit shapes. The hint stays with the
+  // caller so queries on a shared shape never write to it.
+  virtual glm::vec3 local_support(glm::vec3 direction, int *index) const {
+    const ConvexHull &hull = geometry->hull;
+    *index = hull.support_index(direction, index);
+    return hull.vertices[*index];
+  }
+
+  glm::vec3 world_vertex(int index) const {
+    return transform.to_world(geometry->hull.vertices[index]);
+  }
+
+  virtual void update_pos(glm::vec3 new_pos) {
+    transform.position += new_pos;
   }
 
-  void to_world_vertices(int size) {
-    for (int i = 0; i < size; i++) {
-      world_vertices[i] = model_vertices[i] + pos;
-    }
+  virtual void update_orientation(glm::quat rotation) {
+    transform.orientation = glm::normalize(rotation * transform.orientation);
   }
 
-  void fill_vec3_arr(float model_vertices_floats[], int size) {
-    for (int i = 0; i < size; i += 3) {
-      model_vertices[i/3] = glm::vec3(model_vertices_floats[i], model_vertices_floats[i+1], model_vertices_floats[i+2]);
-    }
+private:
+  static unsigned int next_id() {
+    static unsigned int last_id = 0;
+    return ++last_id;
   }
 };
 
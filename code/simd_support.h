@@ -0,0 +1,245 @@
+#ifndef SIMD_SUPPORT_H_
+#define SIMD_SUPPORT_H_
+
+#include <float.h>
+#include <glm/glm.hpp>
+
+// glm's platform detection tells us whether this is an x86 build at all. Which
+// instruction sets the CPU actually has is checked at runtime, the build
+// doesn't pass any /arch flags.
+#if GLM_ARCH & GLM_ARCH_X86_BIT
+#define SIMD_SUPPORT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define SIMD_SUPPORT_X86 0
+#endif
+
+// MSVC compiles intrinsics for any instruction set as is, gcc and clang only
+// inside functions marked for it
+#if SIMD_SUPPORT_X86 && !defined(_MSC_VER)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+// The scans are kept out of line so inlining them doesn't bloat the scalar
+// path small hulls take through support()
+#if defined(_MSC_VER)
+#define SIMD_NOINLINE __declspec(noinline)
+#else
+#define SIMD_NOINLINE __attribute__((noinline))
+#endif
+
+// Vertices are stored in blocks of this many, x of each vertex in the block,
+// then y, then z
+#define SIMD_BLOCK_LANES 8
+#define SIMD_BLOCK_FLOATS (3 * SIMD_BLOCK_LANES)
+
+enum SupportPath {
+  SUPPORT_SCALAR,
+  SUPPORT_SSE,
+  SUPPORT_AVX2
+};
+
+const char *supportPathName(SupportPath path) {
+  switch (path) {
+    case SUPPORT_SSE:
+      return "sse";
+    case SUPPORT_AVX2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+#if SIMD_SUPPORT_X86
+void simdCpuid(int info[4], int leaf) {
+#if defined(_MSC_VER)
+  __cpuidex(info, leaf, 0);
+#else
+  __cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+// Whether the OS saves the xmm and ymm registers on a context switch
+bool simdOsSavesYmm() {
+#if defined(_MSC_VER)
+  return (_xgetbv(0) & 6) == 6;
+#else
+  unsigned int eax, edx;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (eax & 6) == 6;
+#endif
+}
+#endif
+
+// Best path this CPU runs
+SupportPath detectSupportPath() {
+#if SIMD_SUPPORT_X86
+  int info[4];
+  simdCpuid(info, 0);
+  int maxLeaf = info[0];
+
+  simdCpuid(info, 1);
+  bool sse2 = (info[3] & (1 << 26)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  bool avx2 = false;
+  if (maxLeaf >= 7 && osxsave && avx && simdOsSavesYmm()) {
+    simdCpuid(info, 7);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+
+  if (avx2) {
+    return SUPPORT_AVX2;
+  }
+  if (sse2) {
+    return SUPPORT_SSE;
+  }
+#endif
+  return SUPPORT_SCALAR;
+}
+
+// The path every support query uses, picked the first time it's asked for
+SupportPath &activeSupportPath() {
+  static SupportPath path = detectSupportPath();
+  return path;
+}
+
+#if SIMD_SUPPORT_X86
+// Four vectors at once, one per lane, for the batched kernels
+struct SseVec3 {
+  __m128 x;
+  __m128 y;
+  __m128 z;
+};
+
+SseVec3 sseAdd3(SseVec3 a, SseVec3 b) {
+  return SseVec3{_mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z)};
+}
+
+SseVec3 sseSub3(SseVec3 a, SseVec3 b) {
+  return SseVec3{_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)};
+}
+
+SseVec3 sseScale3(SseVec3 a, __m128 s) {
+  return SseVec3{_mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s)};
+}
+
+__m128 sseDot3(SseVec3 a, SseVec3 b) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+SseVec3 sseCross3(SseVec3 a, SseVec3 b) {
+  return SseVec3{_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+                 _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+                 _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))};
+}
+
+// a where mask is set, b elsewhere
+__m128 sseSelect(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__m128i sseSelect(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+SseVec3 sseSelect3(__m128 mask, SseVec3 a, SseVec3 b) {
+  return SseVec3{sseSelect(mask, a.x, b.x), sseSelect(mask, a.y, b.y), sseSelect(mask, a.z, b.z)};
+}
+
+// Keeps whichever of each pair of lanes is further along, ties go to the
+// lower index so every path returns the same vertex as the scalar scan
+void sseMergeLanes(__m128 &distance, __m128i &index, __m128 otherDistance, __m128i otherIndex) {
+  __m128i further = _mm_castps_si128(_mm_cmpgt_ps(otherDistance, distance));
+  __m128i tied = _mm_castps_si128(_mm_cmpeq_ps(otherDistance, distance));
+  __m128i take = _mm_or_si128(further, _mm_and_si128(tied, _mm_cmplt_epi32(otherIndex, index)));
+  distance = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(take), otherDistance),
+                       _mm_andnot_ps(_mm_castsi128_ps(take), distance));
+  index = _mm_or_si128(_mm_and_si128(take, otherIndex), _mm_andnot_si128(take, index));
+}
+
+// Index of the vertex in blocks furthest along direction.
+//
+// Each lane keeps its own best distance and index, SSE2 has no blend so the
+// selects are and/andnot/or
+SIMD_NOINLINE
+int sseBlockSupportIndex(const float blocks[], int blockCount, glm::vec3 direction) {
+  __m128 dx = _mm_set1_ps(direction.x);
+  __m128 dy = _mm_set1_ps(direction.y);
+  __m128 dz = _mm_set1_ps(direction.z);
+  __m128 bestDistance[2] = {_mm_set1_ps(-FLT_MAX), _mm_set1_ps(-FLT_MAX)};
+  __m128i bestIndex[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+  __m128i index[2] = {_mm_setr_epi32(0, 1, 2, 3), _mm_setr_epi32(4, 5, 6, 7)};
+  __m128i step = _mm_set1_epi32(SIMD_BLOCK_LANES);
+
+  for (int b = 0; b < blockCount; b++) {
+    const float *block = blocks + b * SIMD_BLOCK_FLOATS;
+    for (int half = 0; half < 2; half++) {
+      __m128 x = _mm_loadu_ps(block + half * 4);
+      __m128 y = _mm_loadu_ps(block + SIMD_BLOCK_LANES + half * 4);
+      __m128 z = _mm_loadu_ps(block + 2 * SIMD_BLOCK_LANES + half * 4);
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, dx), _mm_mul_ps(y, dy)), _mm_mul_ps(z, dz));
+      __m128 greater = _mm_cmpgt_ps(distance, bestDistance[half]);
+      __m128i greaterInt = _mm_castps_si128(greater);
+      bestDistance[half] = _mm_or_ps(_mm_and_ps(greater, distance), _mm_andnot_ps(greater, bestDistance[half]));
+      bestIndex[half] = _mm_or_si128(_mm_and_si128(greaterInt, index[half]),
+                                     _mm_andnot_si128(greaterInt, bestIndex[half]));
+      index[half] = _mm_add_epi32(index[half], step);
+    }
+  }
+
+  // fold the halves, then the lanes, onto lane 0
+  sseMergeLanes(bestDistance[0], bestIndex[0], bestDistance[1], bestIndex[1]);
+  sseMergeLanes(bestDistance[0], bestIndex[0],
+                _mm_shuffle_ps(bestDistance[0], bestDistance[0], _MM_SHUFFLE(1, 0, 3, 2)),
+                _mm_shuffle_epi32(bestIndex[0], _MM_SHUFFLE(1, 0, 3, 2)));
+  sseMergeLanes(bestDistance[0], bestIndex[0],
+                _mm_shuffle_ps(bestDistance[0], bestDistance[0], _MM_SHUFFLE(2, 3, 0, 1)),
+                _mm_shuffle_epi32(bestIndex[0], _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(bestIndex[0]);
+}
+
+SIMD_NOINLINE SIMD_TARGET_AVX2
+int avx2BlockSupportIndex(const float blocks[], int blockCount, glm::vec3 direction) {
+  __m256 dx = _mm256_set1_ps(direction.x);
+  __m256 dy = _mm256_set1_ps(direction.y);
+  __m256 dz = _mm256_set1_ps(direction.z);
+  __m256 bestDistance = _mm256_set1_ps(-FLT_MAX);
+  __m256i bestIndex = _mm256_setzero_si256();
+  __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i step = _mm256_set1_epi32(SIMD_BLOCK_LANES);
+
+  for (int b = 0; b < blockCount; b++) {
+    const float *block = blocks + b * SIMD_BLOCK_FLOATS;
+    __m256 x = _mm256_loadu_ps(block);
+    __m256 y = _mm256_loadu_ps(block + SIMD_BLOCK_LANES);
+    __m256 z = _mm256_loadu_ps(block + 2 * SIMD_BLOCK_LANES);
+    __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, dx), _mm256_mul_ps(y, dy)),
+                                    _mm256_mul_ps(z, dz));
+    __m256 greater = _mm256_cmp_ps(distance, bestDistance, _CMP_GT_OQ);
+    bestDistance = _mm256_blendv_ps(bestDistance, distance, greater);
+    bestIndex = _mm256_blendv_epi8(bestIndex, index, _mm256_castps_si256(greater));
+    index = _mm256_add_epi32(index, step);
+  }
+
+  // horizontal max, then the lowest index among the lanes holding it
+  __m256 best = _mm256_max_ps(bestDistance, _mm256_permute2f128_ps(bestDistance, bestDistance, 1));
+  best = _mm256_max_ps(best, _mm256_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+  best = _mm256_max_ps(best, _mm256_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+  __m256i isBest = _mm256_castps_si256(_mm256_cmp_ps(bestDistance, best, _CMP_EQ_OQ));
+  __m256i candidates = _mm256_blendv_epi8(_mm256_set1_epi32(0x7fffffff), bestIndex, isBest);
+  __m256i lowest = _mm256_min_epi32(candidates, _mm256_permute2x128_si256(candidates, candidates, 1));
+  lowest = _mm256_min_epi32(lowest, _mm256_shuffle_epi32(lowest, _MM_SHUFFLE(1, 0, 3, 2)));
+  lowest = _mm256_min_epi32(lowest, _mm256_shuffle_epi32(lowest, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(_mm256_castsi256_si128(lowest));
+}
+#endif
+
+#endif
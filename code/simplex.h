@@ -0,0 +1,299 @@
+#ifndef SIMPLEX_H_
+#define SIMPLEX_H_
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <glm/glm.hpp>
+
+// GJK simplex that lives on the stack, a query never needs more than 4
+// points. Next to each Minkowski difference point it keeps where the point
+// came from (the support point on shape A and the hull vertex index on both
+// shapes) and its barycentric weight. solve() is the distance query's
+// sub-simplex step.
+struct Simplex {
+  static const int CAPACITY = 4;
+
+  // a - b for the support points a on shape A and b on shape B
+  glm::vec3 points[CAPACITY];
+  glm::vec3 points_a[CAPACITY];
+  int indices_a[CAPACITY];
+  int indices_b[CAPACITY];
+  float weights[CAPACITY];
+  int count = 0;
+
+  int size() const {
+    return count;
+  }
+
+  const glm::vec3 &operator[](int i) const {
+    return points[i];
+  }
+
+  void clear() {
+    count = 0;
+  }
+
+  // GJK drops a point before it adds one to a full simplex
+  void push_back(glm::vec3 point, glm::vec3 point_a, int index_a, int index_b) {
+    assert(count < CAPACITY);
+    points[count] = point;
+    points_a[count] = point_a;
+    indices_a[count] = index_a;
+    indices_b[count] = index_b;
+    weights[count] = 0.0f;
+    count++;
+  }
+
+  // Keeps the order of the remaining points, evolveSimplex relies on it
+  void remove(int i) {
+    for (int j = i; j < count - 1; j++) {
+      points[j] = points[j + 1];
+      points_a[j] = points_a[j + 1];
+      indices_a[j] = indices_a[j + 1];
+      indices_b[j] = indices_b[j + 1];
+      weights[j] = weights[j + 1];
+    }
+    count--;
+  }
+
+  // Same support vertices on both shapes means the same point. Points that
+  // aren't hull vertices (index -1) are compared by position instead.
+  bool contains(int index_a, int index_b, const glm::vec3 &point) const {
+    bool byIndex = index_a >= 0 && index_b >= 0;
+    for (int i = 0; i < count; i++) {
+      if (byIndex ? (indices_a[i] == index_a && indices_b[i] == index_b) : points[i] == point) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  glm::vec3 point_b(int i) const {
+    return points_a[i] - points[i];
+  }
+
+  // Moves the listed points to the front (in that order) and drops the rest
+  void keep(int i0, int i1 = -1, int i2 = -1) {
+    int order[3] = {i0, i1, i2};
+    Simplex old = *this;
+    count = 0;
+    for (int k = 0; k < 3 && order[k] != -1; k++) {
+      int i = order[k];
+      points[count] = old.points[i];
+      points_a[count] = old.points_a[i];
+      indices_a[count] = old.indices_a[i];
+      indices_b[count] = old.indices_b[i];
+      weights[count] = old.weights[i];
+      count++;
+    }
+  }
+
+  // Sum of the points on shape A (or B) weighted by the barycentric weights,
+  // the witness points once a distance query has converged
+  glm::vec3 weighted_point_a() const {
+    glm::vec3 p = glm::vec3(0.0f, 0.0f, 0.0f);
+    for (int i = 0; i < count; i++) {
+      p += weights[i] * points_a[i];
+    }
+    return p;
+  }
+
+  glm::vec3 weighted_point_b() const {
+    glm::vec3 p = glm::vec3(0.0f, 0.0f, 0.0f);
+    for (int i = 0; i < count; i++) {
+      p += weights[i] * point_b(i);
+    }
+    return p;
+  }
+
+  // Finds the point of the simplex closest to the origin, shrinks the simplex
+  // down to the smallest sub-simplex (vertex, edge, triangle) that point lies
+  // on and sets the weights to its barycentric coordinates. A tetrahedron
+  // containing the origin is kept whole and the origin is returned.
+  glm::vec3 solve() {
+    switch (count) {
+      case 1:
+        weights[0] = 1.0f;
+        return points[0];
+      case 2:
+        return solve_segment();
+      case 3:
+        return solve_triangle();
+      case 4:
+        return solve_tetrahedron();
+      default:
+        return glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+  }
+
+  // For a tetrahedron containing the origin, sets weights to the barycentric
+  // coordinates of the origin (each weight is the volume of the tetrahedron
+  // with that point swapped for the origin, over the full volume)
+  void set_origin_weights() {
+    if (count != 4) {
+      return;
+    }
+    const glm::vec3 &a = points[0];
+    const glm::vec3 &b = points[1];
+    const glm::vec3 &c = points[2];
+    const glm::vec3 &d = points[3];
+    float volume = glm::dot(b - a, glm::cross(c - a, d - a));
+    if (volume == 0.0f) {
+      return;
+    }
+    weights[0] = glm::dot(b, glm::cross(c, d)) / volume;
+    weights[1] = -glm::dot(a, glm::cross(c, d)) / volume;
+    weights[2] = glm::dot(a, glm::cross(b, d)) / volume;
+    weights[3] = -glm::dot(a, glm::cross(b, c)) / volume;
+  }
+
+private:
+  glm::vec3 solve_vertex(int i) {
+    keep(i);
+    weights[0] = 1.0f;
+    return points[0];
+  }
+
+  glm::vec3 solve_segment() {
+    glm::vec3 a = points[0];
+    glm::vec3 ab = points[1] - a;
+    float lengthSquared = glm::dot(ab, ab);
+    float t = (lengthSquared > 0.0f) ? glm::dot(-a, ab) / lengthSquared : 0.0f;
+    if (t <= 0.0f) {
+      return solve_vertex(0);
+    }
+    if (t >= 1.0f) {
+      return solve_vertex(1);
+    }
+    weights[0] = 1.0f - t;
+    weights[1] = t;
+    return a + t * ab;
+  }
+
+  glm::vec3 solve_edge(int i, int j, float t) {
+    keep(i, j);
+    weights[0] = 1.0f - t;
+    weights[1] = t;
+    return points[0] + t * (points[1] - points[0]);
+  }
+
+  // Voronoi region test from Ericson's Real-Time Collision Detection (5.1.5),
+  // with the query point at the origin
+  glm::vec3 solve_triangle() {
+    glm::vec3 a = points[0];
+    glm::vec3 b = points[1];
+    glm::vec3 c = points[2];
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+
+    float d1 = glm::dot(ab, -a);
+    float d2 = glm::dot(ac, -a);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+      return solve_vertex(0);
+    }
+
+    float d3 = glm::dot(ab, -b);
+    float d4 = glm::dot(ac, -b);
+    if (d3 >= 0.0f && d4 <= d3) {
+      return solve_vertex(1);
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+      return solve_edge(0, 1, d1 / (d1 - d3));
+    }
+
+    float d5 = glm::dot(ab, -c);
+    float d6 = glm::dot(ac, -c);
+    if (d6 >= 0.0f && d5 <= d6) {
+      return solve_vertex(2);
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+      return solve_edge(0, 2, d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+      return solve_edge(1, 2, (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float sum = va + vb + vc;
+    if (sum <= 0.0f) {
+      // collinear points, fall back to whichever edge gets closest
+      return solve_closest_of(3);
+    }
+    float v = vb / sum;
+    float w = vc / sum;
+    weights[0] = 1.0f - v - w;
+    weights[1] = v;
+    weights[2] = w;
+    return a + ab * v + ac * w;
+  }
+
+  glm::vec3 solve_tetrahedron() {
+    // face i is the triangle opposite point i
+    static const int FACES[4][3] = {{1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2}};
+    float volume = glm::dot(points[1] - points[0],
+                            glm::cross(points[2] - points[0], points[3] - points[0]));
+    bool flat = fabsf(volume) <= 1e-9f;
+
+    bool candidate[4];
+    bool anyOutside = false;
+    for (int i = 0; i < 4; i++) {
+      const glm::vec3 &a = points[FACES[i][0]];
+      glm::vec3 n = glm::cross(points[FACES[i][1]] - a, points[FACES[i][2]] - a);
+      // the origin is outside this face when it is on the other side of the
+      // face than the opposite point
+      candidate[i] = flat || glm::dot(n, -a) * glm::dot(n, points[i] - a) < 0.0f;
+      anyOutside = anyOutside || candidate[i];
+    }
+
+    if (!anyOutside) {
+      set_origin_weights();
+      return glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    Simplex best;
+    glm::vec3 bestPoint = glm::vec3(0.0f, 0.0f, 0.0f);
+    float bestDistance = FLT_MAX;
+    for (int i = 0; i < 4; i++) {
+      if (!candidate[i]) {
+        continue;
+      }
+      Simplex face = *this;
+      face.keep(FACES[i][0], FACES[i][1], FACES[i][2]);
+      glm::vec3 p = face.solve_triangle();
+      if (glm::dot(p, p) < bestDistance) {
+        bestDistance = glm::dot(p, p);
+        bestPoint = p;
+        best = face;
+      }
+    }
+    *this = best;
+    return bestPoint;
+  }
+
+  // Tries every edge of a degenerate triangle and keeps the closest
+  glm::vec3 solve_closest_of(int n) {
+    Simplex best;
+    glm::vec3 bestPoint = glm::vec3(0.0f, 0.0f, 0.0f);
+    float bestDistance = FLT_MAX;
+    for (int i = 0; i < n; i++) {
+      Simplex edge = *this;
+      edge.keep(i, (i + 1) % n);
+      glm::vec3 p = edge.solve_segment();
+      if (glm::dot(p, p) < bestDistance) {
+        bestDistance = glm::dot(p, p);
+        bestPoint = p;
+        best = edge;
+      }
+    }
+    *this = best;
+    return bestPoint;
+  }
+};
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef SPATIAL_GRID_H_
+#define SPATIAL_GRID_H_
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <math.h>
+#include <glm/glm.hpp>
+
+#include "broadphase.h"
+#include "thread_pool.h"
+
+// Bodies a little smaller than a cell touch at most 8 cells
+#define GRID_DEFAULT_CELL_SIZE 2.0f
+// Every parallel pass splits its work into this many tasks per thread, so a
+// thread that finishes early picks up another
+#define GRID_TASKS_PER_THREAD 4
+// Bucket indices are sorted this many bits at a time
+#define GRID_RADIX_BITS 11
+#define GRID_RADIX (1 << GRID_RADIX_BITS)
+
+// Uniform grid hashed into a table, rebuilt from scratch every update.
+// Nothing is kept between steps, which suits lots of similar sized bodies
+// (debris, particles) better than keeping a tree or sorted axes up to date.
+//
+// Every body makes an entry per cell its box touches, and the entries are
+// put in order of the bucket their cell hashes to with a radix sort: a
+// counting sort pass (count, prefix sum the counts into offsets, scatter)
+// per 11 bits of the bucket index. Each pass runs on the thread pool and
+// only walks the entries in order, a counting sort over the whole table at
+// once would scatter every entry to a random cache line. Two bodies sharing
+// several cells meet in each of them, the pair is only reported by the cell
+// holding the min corner of their boxes' intersection (the cell that owns
+// it), so it comes out once without a set to dedupe it in.
+class SpatialGrid : public Broadphase {
+public:
+  float cell_size;
+
+  SpatialGrid(ThreadPool &thread_pool, float cellSize = GRID_DEFAULT_CELL_SIZE)
+      : cell_size(cellSize), pool(thread_pool) {}
+
+  const char *name() const override {
+    return "grid";
+  }
+
+  void update(const std::vector<Aabb> &boxes) override {
+    int bodyCount = (int)boxes.size();
+    int tasks = pool.size() * GRID_TASKS_PER_THREAD;
+    float inverseCellSize = 1.0f / cell_size;
+
+    // how many entries each task's bodies make, then where they start
+    task_offsets.assign(tasks + 1, 0);
+    pool.run(tasks, [&](int task, int) {
+      int begin, end;
+      split(bodyCount, tasks, task, &begin, &end);
+      int sum = 0;
+      for (int i = begin; i < end; i++) {
+        glm::ivec3 low, high;
+        cell_range(boxes[i], inverseCellSize, &low, &high);
+        glm::ivec3 cells = high - low + 1;
+        sum += cells.x * cells.y * cells.z;
+      }
+      task_offsets[task + 1] = sum;
+    });
+    for (int task = 0; task < tasks; task++) {
+      task_offsets[task + 1] += task_offsets[task];
+    }
+    int entryCount = task_offsets[tasks];
+
+    // a table at least twice the entries keeps unrelated cells apart
+    int bucketBits = 1;
+    while ((1 << bucketBits) < 2 * entryCount) {
+      bucketBits++;
+    }
+    unsigned int mask = (1u << bucketBits) - 1;
+    entries.resize(entryCount);
+    sorted.resize(entryCount);
+
+    pool.run(tasks, [&](int task, int) {
+      int begin, end;
+      split(bodyCount, tasks, task, &begin, &end);
+      int slot = task_offsets[task];
+      for (int i = begin; i < end; i++) {
+        glm::ivec3 low, high;
+        cell_range(boxes[i], inverseCellSize, &low, &high);
+        for (int x = low.x; x <= high.x; x++) {
+          for (int y = low.y; y <= high.y; y++) {
+            for (int z = low.z; z <= high.z; z++) {
+              Entry &entry = entries[slot++];
+              entry.bucket = cell_hash(x, y, z) & mask;
+              entry.body = i;
+              entry.cell = cell_key(x, y, z);
+              entry.box = boxes[i];
+            }
+          }
+        }
+      }
+    });
+
+    // bucket the entries with one counting sort per GRID_RADIX_BITS of the
+    // bucket index, lowest digit first. Each pass counts per task, prefix
+    // sums the counts digit by digit and task by task, then every task
+    // scatters its entries in order, so the sort is stable and the result
+    // the same for any number of threads.
+    histograms.resize(tasks * GRID_RADIX);
+    for (int shift = 0; shift < bucketBits; shift += GRID_RADIX_BITS) {
+      pool.run(tasks, [&](int task, int) {
+        int *histogram = &histograms[task * GRID_RADIX];
+        std::fill(histogram, histogram + GRID_RADIX, 0);
+        int begin, end;
+        split(entryCount, tasks, task, &begin, &end);
+        for (int i = begin; i < end; i++) {
+          histogram[(entries[i].bucket >> shift) & (GRID_RADIX - 1)]++;
+        }
+      });
+      int offset = 0;
+      for (int digit = 0; digit < GRID_RADIX; digit++) {
+        for (int task = 0; task < tasks; task++) {
+          int count = histograms[task * GRID_RADIX + digit];
+          histograms[task * GRID_RADIX + digit] = offset;
+          offset += count;
+        }
+      }
+      pool.run(tasks, [&](int task, int) {
+        int *cursor = &histograms[task * GRID_RADIX];
+        int begin, end;
+        split(entryCount, tasks, task, &begin, &end);
+        for (int i = begin; i < end; i++) {
+          sorted[cursor[(entries[i].bucket >> shift) & (GRID_RADIX - 1)]++] = entries[i];
+        }
+      });
+      entries.swap(sorted);
+    }
+
+    // pairs, each task takes the buckets starting in its share of the
+    // entries. Every task sorts its own and they are merged after.
+    task_pairs.resize(tasks);
+    pool.run(tasks, [&](int task, int) {
+      std::vector<BroadphasePair> &found = task_pairs[task];
+      found.clear();
+      int begin, end;
+      split(entryCount, tasks, task, &begin, &end);
+      begin = bucket_start(begin);
+      end = bucket_start(end);
+      for (int first = begin; first < end; ) {
+        int last = first + 1;
+        while (last < end && entries[last].bucket == entries[first].bucket) {
+          last++;
+        }
+        for (int i = first; i < last; i++) {
+          const Entry &entry = entries[i];
+          const Aabb &box = entry.box;
+          for (int j = i + 1; j < last; j++) {
+            // other cells that hashed to the same bucket
+            if (entries[j].cell != entry.cell) {
+              continue;
+            }
+            const Aabb &other = entries[j].box;
+            if (!box.overlaps(other)) {
+              continue;
+            }
+            glm::vec3 corner = glm::max(box.min, other.min);
+            glm::ivec3 owner = glm::ivec3(glm::floor(corner * inverseCellSize));
+            if (cell_key(owner.x, owner.y, owner.z) == entry.cell) {
+              found.push_back(broadphasePair(entry.body, entries[j].body));
+            }
+          }
+        }
+        first = last;
+      }
+      std::sort(found.begin(), found.end());
+    });
+
+    // merge neighbouring lists in parallel until one is left
+    merged_pairs.resize(tasks);
+    for (int width = 1; width < tasks; width *= 2) {
+      pool.run((tasks + 2 * width - 1) / (2 * width), [&](int merge, int) {
+        int left = 2 * width * merge;
+        int right = left + width;
+        if (right >= tasks) {
+          return;
+        }
+        std::vector<BroadphasePair> &out = merged_pairs[left];
+        out.clear();
+        std::merge(task_pairs[left].begin(), task_pairs[left].end(), task_pairs[right].begin(),
+                   task_pairs[right].end(), std::back_inserter(out));
+        task_pairs[left].swap(out);
+      });
+    }
+    previous_pairs.swap(current_pairs);
+    current_pairs.swap(task_pairs[0]);
+    added.clear();
+    removed.clear();
+    std::set_difference(current_pairs.begin(), current_pairs.end(), previous_pairs.begin(),
+                        previous_pairs.end(), std::back_inserter(added));
+    std::set_difference(previous_pairs.begin(), previous_pairs.end(), current_pairs.begin(),
+                        current_pairs.end(), std::back_inserter(removed));
+  }
+
+  void pairs(std::vector<BroadphasePair> &out) const override {
+    out = current_pairs;
+  }
+
+  int entry_count() const {
+    return (int)entries.size();
+  }
+
+private:
+  // One cell a body touches. The box rides along, the pair search walks
+  // the entries in order and looking each box up by body would be a cache
+  // miss per entry.
+  struct Entry {
+    unsigned int bucket;
+    int body;
+    unsigned long long cell;
+    Aabb box;
+  };
+
+  ThreadPool &pool;
+  // sorted by bucket after update()
+  std::vector<Entry> entries;
+  std::vector<Entry> sorted;
+  std::vector<int> histograms;
+  std::vector<int> task_offsets;
+  std::vector<std::vector<BroadphasePair>> task_pairs;
+  std::vector<std::vector<BroadphasePair>> merged_pairs;
+  std::vector<BroadphasePair> current_pairs;
+  std::vector<BroadphasePair> previous_pairs;
+
+  static void split(int count, int parts, int part, int *begin, int *end) {
+    *begin = (int)((long long)count * part / parts);
+    *end = (int)((long long)count * (part + 1) / parts);
+  }
+
+  // First entry at or after index that starts a bucket
+  int bucket_start(int index) const {
+    while (index > 0 && index < (int)entries.size() && entries[index].bucket == entries[index - 1].bucket) {
+      index++;
+    }
+    return index;
+  }
+
+  static void cell_range(const Aabb &box, float inverseCellSize, glm::ivec3 *low, glm::ivec3 *high) {
+    *low = glm::ivec3(glm::floor(box.min * inverseCellSize));
+    *high = glm::ivec3(glm::floor(box.max * inverseCellSize));
+  }
+
+  // Teschner et al.'s spatial hash
+  static unsigned int cell_hash(int x, int y, int z) {
+    return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+  }
+
+  // 21 bits per coordinate, enough for a million cells each way
+  static unsigned long long cell_key(int x, int y, int z) {
+    return ((unsigned long long)(x & 0x1fffff) << 42) | ((unsigned long long)(y & 0x1fffff) << 21)
+           | (unsigned long long)(z & 0x1fffff);
+  }
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SPHERE_H_
+#define SPHERE_H_
+
+#include "shape.h"
+
+// A point swept by a sphere of radius: the margin does all the work
+class Sphere : public Shape {
+public:
+  Sphere(glm::vec3 spherePos, float sphereRadius) {
+    type = SHAPE_SPHERE;
+    transform.position = spherePos;
+    margin = sphereRadius;
+  }
+
+  float radius() const {
+    return margin;
+  }
+
+  glm::vec3 local_centroid() const override {
+    return glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+
+  glm::vec3 local_support(glm::vec3 /*direction*/, int *index) const override {
+    *index = -1;
+    return glm::vec3(0.0f, 0.0f, 0.0f);
+  }
+};
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef SWEEP_AND_PRUNE_H_
+#define SWEEP_AND_PRUNE_H_
+
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+
+#include "broadphase.h"
+
+// Sweep and prune (Baraff's sort and sweep kept up incrementally, like
+// Bullet's axis sweep). Each axis keeps every box's min and max end point in
+// one sorted array. Bodies only move a little per step, so re-sorting the
+// arrays with an insertion sort is close to a single pass, and a min end
+// point passing a max one is exactly when two boxes may start or stop
+// overlapping. Only those swaps test the pair, and only a pair whose boxes
+// went from overlapping to not (or back) since the last update touches the
+// pair set.
+class SweepAndPrune : public Broadphase {
+public:
+  // end point swaps made by the last update()
+  long long swaps = 0;
+
+  const char *name() const override {
+    return "sap";
+  }
+
+  void update(const std::vector<Aabb> &boxes) override {
+    added.clear();
+    removed.clear();
+    if ((int)boxes.size() != body_count) {
+      rebuild(boxes);
+      return;
+    }
+    swaps = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      std::vector<Endpoint> &endpoints = axes[axis];
+      for (Endpoint &endpoint : endpoints) {
+        const Aabb &box = boxes[endpoint.body()];
+        endpoint.value = endpoint.is_max() ? box.max[axis] : box.min[axis];
+      }
+      sort(endpoints, boxes);
+      find_slots(axis);
+    }
+    previous_boxes = boxes;
+  }
+
+  // Only the moving bodies' end points are taken out and sifted back into
+  // place, the frozen ones keep their order. Any pair that starts or stops
+  // overlapping has a moving side, so it still makes the min/max swap.
+  void update_moving(const std::vector<Aabb> &boxes, const std::vector<int> &moving) override {
+    added.clear();
+    removed.clear();
+    if ((int)boxes.size() != body_count) {
+      rebuild(boxes);
+      return;
+    }
+    swaps = 0;
+    for (int body : moving) {
+      for (int axis = 0; axis < 3; axis++) {
+        std::vector<Endpoint> &endpoints = axes[axis];
+        std::vector<int> &slot = slots[axis];
+        endpoints[slot[2 * body]].value = boxes[body].min[axis];
+        sift(axis, slot[2 * body], boxes);
+        endpoints[slot[2 * body + 1]].value = boxes[body].max[axis];
+        sift(axis, slot[2 * body + 1], boxes);
+      }
+    }
+    for (int body : moving) {
+      previous_boxes[body] = boxes[body];
+    }
+  }
+
+  // Sorts every axis from scratch and sweeps the x axis for the pairs, what
+  // the first update() does. added and removed get the difference to the
+  // pairs before.
+  void rebuild(const std::vector<Aabb> &boxes) {
+    added.clear();
+    removed.clear();
+    swaps = 0;
+    body_count = (int)boxes.size();
+    for (int axis = 0; axis < 3; axis++) {
+      std::vector<Endpoint> &endpoints = axes[axis];
+      endpoints.resize(2 * body_count);
+      for (int i = 0; i < body_count; i++) {
+        endpoints[2 * i] = Endpoint(boxes[i].min[axis], i, false);
+        endpoints[2 * i + 1] = Endpoint(boxes[i].max[axis], i, true);
+      }
+      std::sort(endpoints.begin(), endpoints.end());
+      find_slots(axis);
+    }
+
+    std::unordered_set<unsigned long long> previous;
+    previous.swap(overlapping);
+    std::vector<int> active;
+    std::vector<int> active_slot(body_count, -1);
+    for (const Endpoint &endpoint : axes[0]) {
+      int body = endpoint.body();
+      if (endpoint.is_max()) {
+        int slot = active_slot[body];
+        active[slot] = active.back();
+        active_slot[active[slot]] = slot;
+        active.pop_back();
+        continue;
+      }
+      for (int other : active) {
+        if (boxes[body].overlaps(boxes[other])) {
+          unsigned long long key = broadphasePairKey(body, other);
+          overlapping.insert(key);
+          if (previous.erase(key) == 0) {
+            added.push_back(broadphasePair(body, other));
+          }
+        }
+      }
+      active_slot[body] = (int)active.size();
+      active.push_back(body);
+    }
+    for (unsigned long long key : previous) {
+      removed.push_back(pair_from_key(key));
+    }
+    previous_boxes = boxes;
+  }
+
+  void pairs(std::vector<BroadphasePair> &out) const override {
+    out.clear();
+    out.reserve(overlapping.size());
+    for (unsigned long long key : overlapping) {
+      out.push_back(pair_from_key(key));
+    }
+    std::sort(out.begin(), out.end());
+  }
+
+  int pair_count() const {
+    return (int)overlapping.size();
+  }
+
+private:
+  // value of one end of a box on one axis, the body it belongs to and
+  // whether it's the max end in the low bit
+  struct Endpoint {
+    float value;
+    unsigned int data;
+
+    Endpoint() {}
+    Endpoint(float endpointValue, int body, bool isMax)
+        : value(endpointValue), data(((unsigned int)body << 1) | (isMax ? 1 : 0)) {}
+
+    int body() const {
+      return (int)(data >> 1);
+    }
+
+    bool is_max() const {
+      return (data & 1) != 0;
+    }
+
+    // a min sorts before a max at the same value, so touching boxes overlap
+    bool operator<(const Endpoint &other) const {
+      return value < other.value || (value == other.value && !is_max() && other.is_max());
+    }
+  };
+
+  std::vector<Endpoint> axes[3];
+  // where each end point is in its axis, by its data (2 * body + is max)
+  std::vector<int> slots[3];
+  std::unordered_set<unsigned long long> overlapping;
+  // the boxes the pairs in overlapping were found with
+  std::vector<Aabb> previous_boxes;
+  int body_count = -1;
+
+  static BroadphasePair pair_from_key(unsigned long long key) {
+    BroadphasePair pair;
+    pair.a = (int)(key >> 32);
+    pair.b = (int)(key & 0xffffffffu);
+    return pair;
+  }
+
+  void sort(std::vector<Endpoint> &endpoints, const std::vector<Aabb> &boxes) {
+    int count = (int)endpoints.size();
+    for (int i = 1; i < count; i++) {
+      Endpoint moving = endpoints[i];
+      int j = i - 1;
+      while (j >= 0 && moving < endpoints[j]) {
+        // a min passing a max (or a max a min) is where this axis starts or
+        // stops separating the two boxes, the other axes may still do it
+        if (moving.is_max() != endpoints[j].is_max()) {
+          update_pair(moving.body(), endpoints[j].body(), boxes);
+        }
+        endpoints[j + 1] = endpoints[j];
+        j--;
+        swaps++;
+      }
+      endpoints[j + 1] = moving;
+    }
+  }
+
+  void find_slots(int axis) {
+    const std::vector<Endpoint> &endpoints = axes[axis];
+    slots[axis].resize(endpoints.size());
+    for (int i = 0; i < (int)endpoints.size(); i++) {
+      slots[axis][endpoints[i].data] = i;
+    }
+  }
+
+  // Moves the end point at index left or right to where it sorts, the one
+  // end point out of place on the axis. Its body's other end can still have
+  // the old value, passing it isn't a pair.
+  void sift(int axis, int index, const std::vector<Aabb> &boxes) {
+    std::vector<Endpoint> &endpoints = axes[axis];
+    std::vector<int> &slot = slots[axis];
+    Endpoint moving = endpoints[index];
+    int count = (int)endpoints.size();
+    while (index > 0 && moving < endpoints[index - 1]) {
+      cross(moving, endpoints[index - 1], boxes);
+      endpoints[index] = endpoints[index - 1];
+      slot[endpoints[index].data] = index;
+      index--;
+    }
+    while (index + 1 < count && endpoints[index + 1] < moving) {
+      cross(moving, endpoints[index + 1], boxes);
+      endpoints[index] = endpoints[index + 1];
+      slot[endpoints[index].data] = index;
+      index++;
+    }
+    endpoints[index] = moving;
+    slot[moving.data] = index;
+  }
+
+  void cross(const Endpoint &moving, const Endpoint &passed, const std::vector<Aabb> &boxes) {
+    swaps++;
+    if (moving.is_max() != passed.is_max() && moving.body() != passed.body()) {
+      update_pair(moving.body(), passed.body(), boxes);
+    }
+  }
+
+  // The same pair can swap on more than one axis, the set lookups keep it
+  // from being added or removed twice
+  void update_pair(int a, int b, const std::vector<Aabb> &boxes) {
+    bool was = previous_boxes[a].overlaps(previous_boxes[b]);
+    bool is = boxes[a].overlaps(boxes[b]);
+    if (was == is) {
+      return;
+    }
+    unsigned long long key = broadphasePairKey(a, b);
+    if (is) {
+      if (overlapping.insert(key).second) {
+        added.push_back(broadphasePair(a, b));
+      }
+    }
+    else if (overlapping.erase(key) != 0) {
+      removed.push_back(broadphasePair(a, b));
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Threads that stay alive between jobs. run() hands out task indices to
+// every thread (the calling one included) until they are used up and
+// returns once all of them are done, so consecutive run() calls are
+// separated by a barrier.
+class ThreadPool {
+public:
+  // thread_count counts the calling thread, 1 runs everything inline
+  explicit ThreadPool(int thread_count) {
+    for (int i = 1; i < thread_count; i++) {
+      workers.push_back(std::thread([this, i] { work(i); }));
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  int size() const {
+    return (int)workers.size() + 1;
+  }
+
+  // Calls task(index, thread) for every index below count, thread is which
+  // of the size() threads runs it
+  template <class Task>
+  void run(int count, const Task &task) {
+    if (workers.empty() || count <= 1) {
+      for (int i = 0; i < count; i++) {
+        task(i, 0);
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = [&task](int index, int thread) { task(index, thread); };
+      job_count = count;
+      next_index.store(0);
+      busy = (int)workers.size();
+      generation++;
+    }
+    wake.notify_all();
+    drain(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busy == 0; });
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::function<void(int, int)> job;
+  int job_count = 0;
+  std::atomic<int> next_index{0};
+  // workers that haven't finished the current job
+  int busy = 0;
+  int generation = 0;
+  bool stopping = false;
+
+  void drain(int thread) {
+    for (;;) {
+      int index = next_index.fetch_add(1);
+      if (index >= job_count) {
+        return;
+      }
+      job(index, thread);
+    }
+  }
+
+  void work(int thread) {
+    int seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) {
+          return;
+        }
+        seen = generation;
+      }
+      drain(thread);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy--;
+        if (busy == 0) {
+          done.notify_one();
+        }
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,94 @@
+// Steps worlds on several threads and checks the result, for running under a
+// race detector. Every solve mode that spreads contacts over the pool shares
+// one static ground between the tasks, which is only safe as long as the
+// solver never writes static bodies back.
+//
+// With gcc or clang on Linux:
+//   g++ -std=c++14 -O1 -g -fsanitize=thread -I Include code/thread_test.cpp Include/glad/glad.c -o thread_test -lpthread
+//   ./thread_test
+// It exits with 1 if a check fails; the sanitizer reports races on its own.
+#include <glad/glad.h>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <glm/glm.hpp>
+
+#include "cube.h"
+#include "box.h"
+#include "world.h"
+
+using namespace std;
+
+const int THREADS = 4;
+const int SIDE = 20;
+const int HEIGHT = 3;
+const int FRAMES = 60;
+const float DT = 1.0f / 60.0f;
+
+struct Scene {
+  World world;
+  Box ground;
+  vector<Cube> cubes;
+
+  Scene(int threads)
+      : world(BROADPHASE_GRID, threads),
+        ground(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(SIDE * 2.0f, 0.5f, SIDE * 2.0f)) {
+    world.add_body(&ground, 0.0f);
+    cubes.reserve(SIDE * SIDE * HEIGHT);
+    srand(31);
+    // stacks 2 apart, each one its own island on the shared ground
+    for (int s = 0; s < SIDE * SIDE; s++) {
+      glm::vec3 base = glm::vec3((s % SIDE - SIDE / 2) * 2.0f, 0.0f, (s / SIDE - SIDE / 2) * 2.0f);
+      for (int level = 0; level < HEIGHT; level++) {
+        glm::vec3 shift = glm::vec3(rand() - RAND_MAX / 2, 0, rand() - RAND_MAX / 2) / (float)RAND_MAX * 0.02f;
+        float y = 0.5f - CONTACT_SLOP + level * (1.0f - CONTACT_SLOP);
+        cubes.push_back(Cube(base + glm::vec3(0.0f, y, 0.0f) + shift));
+        world.add_body(&cubes.back(), 1.0f);
+      }
+    }
+  }
+};
+
+// The tops of the stacks have to stay where they started
+bool stacksStand(const Scene &scene) {
+  for (int s = 0; s < SIDE * SIDE; s++) {
+    // body 0 is the ground
+    glm::vec3 top = scene.world.bodies.positions[1 + s * HEIGHT + HEIGHT - 1];
+    glm::vec3 base = glm::vec3((s % SIDE - SIDE / 2) * 2.0f, 0.0f, (s / SIDE - SIDE / 2) * 2.0f);
+    float y = 0.5f - CONTACT_SLOP + (HEIGHT - 1) * (1.0f - CONTACT_SLOP);
+    glm::vec3 offset = top - (base + glm::vec3(0.0f, y, 0.0f));
+    if (glm::length(offset) > 0.05f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  int failures = 0;
+  for (int byIsland = 0; byIsland < 2; byIsland++) {
+    for (int deterministic = 0; deterministic < 2; deterministic++) {
+      Scene one(1);
+      Scene many(THREADS);
+      Scene *scenes[] = {&one, &many};
+      for (Scene *scene : scenes) {
+        scene->world.solve_islands = byIsland == 1;
+        scene->world.solver.deterministic = deterministic == 1;
+        // sleeping would end the test early, the stacks have to be solved
+        // every frame
+        scene->world.allow_sleep = false;
+        for (int frame = 0; frame < FRAMES; frame++) {
+          scene->world.step(DT);
+        }
+      }
+
+      bool stand = stacksStand(many);
+      // only deterministic mode promises the same result on any thread count
+      bool same = !deterministic || many.world.bodies.positions == one.world.bodies.positions;
+      cout << (byIsland ? "by island" : "together") << ", " << (deterministic ? "deterministic" : "fast") << ": "
+           << (stand ? "stacks stand" : "STACKS FELL") << (same ? "" : ", DIFFERS FROM 1 THREAD") << endl;
+      failures += !stand || !same;
+    }
+  }
+  return failures > 0 ? 1 : 0;
+}
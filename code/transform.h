@@ -0,0 +1,34 @@
+#ifndef TRANSFORM_H_
+#define TRANSFORM_H_
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Rigid transform (no scale) placing model space geometry in the world
+struct Transform {
+  glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+  glm::vec3 to_world(glm::vec3 local_point) const {
+    return orientation * local_point + position;
+  }
+
+  glm::vec3 to_local(glm::vec3 world_point) const {
+    return glm::conjugate(orientation) * (world_point - position);
+  }
+
+  glm::vec3 to_world_direction(glm::vec3 local_direction) const {
+    return orientation * local_direction;
+  }
+
+  glm::vec3 to_local_direction(glm::vec3 world_direction) const {
+    return glm::conjugate(orientation) * world_direction;
+  }
+
+  glm::mat4 matrix() const {
+    return glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(orientation);
+  }
+};
+
+#endif
@@ -0,0 +1,557 @@
+#ifndef WORLD_H_
+#define WORLD_H_
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "aabb.h"
+#include "broadphases.h"
+#include "manifold_cache.h"
+#include "contact_solver.h"
+#include "islands.h"
+#include "rigid_body_storage.h"
+#include "thread_pool.h"
+
+// Islands with at least this many contacts are coloured and solved across
+// the whole pool when the solver colours
+#define WORLD_COLORED_ISLAND 1024
+// Smaller islands are solved whole on one thread, several to a task until
+// the task has this many contacts, so a task isn't one cube on the ground
+#define WORLD_ISLAND_TASK 128
+// An island falls asleep once every body in it has been slower than this
+// (in m/s and rad/s) for WORLD_SLEEP_TIME seconds
+#define WORLD_SLEEP_SPEED 0.05f
+#define WORLD_SLEEP_SPIN 0.05f
+#define WORLD_SLEEP_TIME 0.5f
+
+// Where the last step's time went, and how much contact it handled
+struct WorldStats {
+  double broadphase_seconds = 0.0;
+  double narrowphase_seconds = 0.0;
+  double solver_seconds = 0.0;
+  double integrate_seconds = 0.0;
+  double island_seconds = 0.0;
+  // overlapping boxes, and the manifolds with points among them
+  int pairs = 0;
+  int manifolds = 0;
+  int points = 0;
+  // islands of moving bodies, by size as IslandGraph::histogram() counts
+  // them, and bodies whose island split and was rebuilt
+  int islands = 0;
+  int largest_island = 0;
+  int island_histogram[ISLAND_HISTOGRAM_BUCKETS] = {0};
+  int resplit_bodies = 0;
+  // at the end of the step
+  int awake_bodies = 0;
+  int sleeping_islands = 0;
+};
+
+// Rigid bodies stepped together: the broadphase finds overlapping boxes,
+// the persistent manifolds turn them into contact points, and the contact
+// solver turns those into velocities. Bodies are referred to by the handle
+// add_body() returned, bodies.index() finds them in the storage's arrays.
+//
+// Contacts group the moving bodies into islands that can't affect each
+// other within a step. On more than one thread each island is solved on
+// its own as a pool task, largest first so a big one doesn't start last and
+// hold up the step, and islands too big for one thread are coloured across
+// the pool instead. On one thread there is nothing to spread, and the
+// contacts are solved together in the broadphase's order as before, unless
+// deterministic mode needs the same tasks as on any other thread count.
+//
+// An island whose bodies have all been nearly still for a while is put to
+// sleep as a whole. Sleeping bodies keep their boxes and aren't integrated,
+// the broadphase doesn't move them, and only the pairs with an awake body
+// are listed. The pairs with points the island fell asleep with rest: their
+// manifolds stay in the cache untouched, and they still hold the island
+// together. A contact with an awake body merges the sleeping island
+// into the awake one, which wakes all of it, and so does wake_body() or
+// removing a body from it.
+class World {
+public:
+  RigidBodyStorage bodies;
+  glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+  ContactSolver solver;
+  ManifoldCache manifolds;
+  IslandGraph islands;
+  WorldStats stats;
+  // false solves every contact together on any number of threads, as
+  // ContactSolver::solve() does
+  bool solve_islands = true;
+  // false keeps every body awake
+  bool allow_sleep = true;
+
+  World(BroadphaseType broadphaseType = BROADPHASE_SAP, int threadCount = 1)
+      : pool(threadCount), broadphase(createBroadphase(broadphaseType, pool)) {
+    solver.pool = &pool;
+  }
+
+  ~World() {
+    delete broadphase;
+  }
+
+  World(const World &) = delete;
+  World &operator=(const World &) = delete;
+
+  // shape isn't owned, it has to outlive the world. mass 0 is static.
+  BodyHandle add_body(Shape *shape, float mass) {
+    boxes_stale = true;
+    return bodies.add(shape, mass);
+  }
+
+  // The last body takes its place in the arrays. Whatever was resting on
+  // the body wakes up.
+  void remove_body(BodyHandle handle) {
+    int index = bodies.index(handle);
+    if (index < 0) {
+      return;
+    }
+    wake_island(index);
+    drop_resting(index);
+    bodies.remove(handle);
+    islands.reset();
+    boxes_stale = true;
+    resting_stale = true;
+  }
+
+  // Wakes the body's island, the body alone if it hasn't been stepped yet
+  void wake_body(BodyHandle handle) {
+    int index = bodies.index(handle);
+    if (index >= 0) {
+      wake_island(index);
+    }
+  }
+
+  bool is_sleeping(BodyHandle handle) const {
+    int index = bodies.index(handle);
+    return index >= 0 && !bodies.is_static(index) && !bodies.awake[index];
+  }
+
+  // Collides at the current poses, adds gravity, solves the contacts and
+  // moves the bodies
+  void step(float dt) {
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point start = Clock::now();
+    int count = bodies.size();
+    // static and sleeping bodies haven't moved since their box was made,
+    // the broadphase only moves the awake ones
+    boxes.resize(count);
+    moving.clear();
+    for (int i = 0; i < count; i++) {
+      if (boxes_stale || bodies.awake[i]) {
+        boxes[i] = shapeAabb(*bodies.shapes[i]);
+      }
+      if (bodies.awake[i]) {
+        moving.push_back(i);
+      }
+    }
+    if (boxes_stale) {
+      broadphase->update(boxes);
+      find_overlaps();
+    }
+    else {
+      broadphase->update_moving(boxes, moving);
+      update_overlaps();
+    }
+    boxes_stale = false;
+    list_awake_pairs();
+    Clock::time_point broadphaseDone = Clock::now();
+
+    manifolds.next_frame();
+    contacts.clear();
+    edges.clear();
+    edge_contacts.clear();
+    stats.points = 0;
+    if (resting_stale) {
+      find_resting();
+    }
+    else {
+      drop_resting(-1);
+    }
+    // the resting pairs go in between in the same order, the island graph
+    // sorts the edges
+    size_t next = 0;
+    for (const BroadphasePair &pair : pairs) {
+      for (; next < resting.size() && resting[next] < pair; next++) {
+        edges.push_back(resting[next]);
+        edge_contacts.push_back(-1);
+      }
+      int contact = collide(pair);
+      if (contact >= 0) {
+        edges.push_back(pair);
+        edge_contacts.push_back(contact);
+      }
+    }
+    for (; next < resting.size(); next++) {
+      edges.push_back(resting[next]);
+      edge_contacts.push_back(-1);
+    }
+    Clock::time_point narrowphaseDone = Clock::now();
+
+    islands.update(bodies, edges);
+    wake_touched_islands();
+    Clock::time_point islandsDone = Clock::now();
+
+    for (int i = 0; i < count; i++) {
+      if (bodies.awake[i]) {
+        bodies.update_inertia(i);
+      }
+    }
+    bodies.integrate_velocities(gravity, dt);
+    Clock::time_point solveStart = Clock::now();
+    solver.clear();
+    if (solve_islands && (pool.size() > 1 || solver.deterministic)) {
+      add_by_island(dt);
+      solve_by_island();
+    }
+    else {
+      for (const Contact &contact : contacts) {
+        solver.add(bodies, contact.a, contact.b, *contact.manifold, dt);
+      }
+      solver.solve(bodies);
+    }
+    Clock::time_point solveDone = Clock::now();
+    bodies.integrate_positions(dt);
+    bodies.write_transforms();
+    update_sleep(dt);
+    Clock::time_point end = Clock::now();
+
+    stats.broadphase_seconds = std::chrono::duration<double>(broadphaseDone - start).count();
+    stats.narrowphase_seconds = std::chrono::duration<double>(narrowphaseDone - broadphaseDone).count();
+    stats.island_seconds = std::chrono::duration<double>(islandsDone - narrowphaseDone).count();
+    stats.solver_seconds = std::chrono::duration<double>(solveDone - solveStart).count();
+    stats.integrate_seconds = std::chrono::duration<double>((solveStart - islandsDone) + (end - solveDone)).count();
+    stats.pairs = overlap_count;
+    stats.manifolds = (int)solver.constraints.size();
+    stats.islands = (int)islands.islands.size();
+    stats.largest_island = 0;
+    for (const Island &island : islands.islands) {
+      stats.largest_island = std::max(stats.largest_island, island.body_count());
+    }
+    islands.histogram(stats.island_histogram);
+    stats.resplit_bodies = islands.resplit_bodies;
+  }
+
+private:
+  // a pair with contact points, the cache keeps the manifold where it is
+  // until next_frame()
+  struct Contact {
+    int a;
+    int b;
+    PersistentManifold *manifold;
+  };
+
+  ThreadPool pool;
+  Broadphase *broadphase;
+  std::vector<Aabb> boxes;
+  // every box has to be made again, bodies came or went
+  bool boxes_stale = true;
+  // the awake bodies, ascending
+  std::vector<int> moving;
+  // every body's overlapping bodies, kept up from the broadphase's added and
+  // removed
+  std::vector<std::vector<int>> overlaps;
+  int overlap_count = 0;
+  // the overlapping pairs with an awake body, in the broadphase's order
+  std::vector<BroadphasePair> pairs;
+  // Pairs with points between bodies with nothing awake, from when their
+  // island fell asleep, sorted. Their manifolds rest in the cache untouched until
+  // one side wakes.
+  std::vector<BroadphasePair> resting;
+  // remove_body() moved bodies, resting is found again from every pair
+  bool resting_stale = false;
+  std::vector<Contact> contacts;
+  // the island graph's edges: the contacts, and the resting pairs, which
+  // weren't collided. Their contact is -1.
+  std::vector<BroadphasePair> edges;
+  std::vector<int> edge_contacts;
+
+  void find_overlaps() {
+    broadphase->pairs(pairs);
+    overlaps.resize(bodies.size());
+    for (std::vector<int> &others : overlaps) {
+      others.clear();
+    }
+    for (const BroadphasePair &pair : pairs) {
+      overlaps[pair.a].push_back(pair.b);
+      overlaps[pair.b].push_back(pair.a);
+    }
+    overlap_count = (int)pairs.size();
+  }
+
+  void update_overlaps() {
+    for (const BroadphasePair &pair : broadphase->added) {
+      overlaps[pair.a].push_back(pair.b);
+      overlaps[pair.b].push_back(pair.a);
+    }
+    for (const BroadphasePair &pair : broadphase->removed) {
+      remove_overlap(pair.a, pair.b);
+      remove_overlap(pair.b, pair.a);
+    }
+    overlap_count += (int)broadphase->added.size() - (int)broadphase->removed.size();
+  }
+
+  void remove_overlap(int body, int other) {
+    std::vector<int> &others = overlaps[body];
+    std::vector<int>::iterator it = std::find(others.begin(), others.end(), other);
+    *it = others.back();
+    others.pop_back();
+  }
+
+  // Only the awake bodies' pairs, a pair of two awake ones once, sorted
+  // back into the order pairs() has
+  void list_awake_pairs() {
+    pairs.clear();
+    for (int body : moving) {
+      for (int other : overlaps[body]) {
+        if (!bodies.awake[other] || body < other) {
+          pairs.push_back(broadphasePair(body, other));
+        }
+      }
+    }
+    std::sort(pairs.begin(), pairs.end());
+  }
+
+  // The pairs of bodies with nothing awake and points, from every
+  // overlapping pair
+  void find_resting() {
+    resting.clear();
+    int count = bodies.size();
+    for (int a = 0; a < count; a++) {
+      for (int b : overlaps[a]) {
+        if (b < a || bodies.awake[a] || bodies.awake[b] || (bodies.is_static(a) && bodies.is_static(b))) {
+          continue;
+        }
+        const PersistentManifold &manifold = manifolds.find(*bodies.shapes[a], *bodies.shapes[b]);
+        if (manifold.count > 0) {
+          rest(broadphasePair(a, b));
+        }
+      }
+    }
+    std::sort(resting.begin(), resting.end());
+    resting_stale = false;
+  }
+
+  void rest(const BroadphasePair &pair) {
+    manifolds.rest(*bodies.shapes[pair.a], *bodies.shapes[pair.b]);
+    resting.push_back(pair);
+  }
+
+  // Ends the rest of the pairs that woke up, and of removed's pairs. Their
+  // manifolds go back to being kept by the queries.
+  void drop_resting(int removed) {
+    size_t kept = 0;
+    for (const BroadphasePair &pair : resting) {
+      if (bodies.awake[pair.a] || bodies.awake[pair.b] || pair.a == removed || pair.b == removed) {
+        manifolds.find(*bodies.shapes[pair.a], *bodies.shapes[pair.b]);
+      }
+      else {
+        resting[kept++] = pair;
+      }
+    }
+    resting.resize(kept);
+  }
+
+  // Runs the narrowphase on the pair. The index of its contact, -1 for
+  // none.
+  int collide(const BroadphasePair &pair) {
+    Shape &shapeA = *bodies.shapes[pair.a];
+    Shape &shapeB = *bodies.shapes[pair.b];
+    ContactManifold manifold;
+    if (!manifolds.collide(shapeA, shapeB, manifold)) {
+      return -1;
+    }
+    contacts.push_back(Contact{pair.a, pair.b, &manifolds.find(shapeA, shapeB)});
+    stats.points += manifold.count;
+    return (int)contacts.size() - 1;
+  }
+
+  bool island_awake(const Island &island) const {
+    return bodies.awake[islands.island_bodies[island.body_begin]] != 0;
+  }
+
+  void wake_island(int body) {
+    int island = islands.island_of(body);
+    if (island < 0) {
+      bodies.wake(body);
+      return;
+    }
+    const Island &bodyIsland = islands.islands[island];
+    for (int i = bodyIsland.body_begin; i < bodyIsland.body_end; i++) {
+      bodies.wake(islands.island_bodies[i]);
+    }
+  }
+
+  // An awake body touching a sleeping one merged their islands: the whole
+  // island wakes, and the manifolds that were only kept alive are collided
+  // to be solved with the rest
+  void wake_touched_islands() {
+    for (const Island &island : islands.islands) {
+      bool awake = false;
+      bool asleep = false;
+      for (int i = island.body_begin; i < island.body_end; i++) {
+        if (bodies.awake[islands.island_bodies[i]]) {
+          awake = true;
+        }
+        else {
+          asleep = true;
+        }
+      }
+      if (awake && asleep) {
+        for (int i = island.body_begin; i < island.body_end; i++) {
+          bodies.wake(islands.island_bodies[i]);
+        }
+      }
+    }
+    for (size_t e = 0; e < edges.size(); e++) {
+      if (edge_contacts[e] < 0 && (bodies.awake[edges[e].a] || bodies.awake[edges[e].b])) {
+        edge_contacts[e] = collide(edges[e]);
+      }
+    }
+  }
+
+  // Counts down every awake island's bodies while they're slow, and puts
+  // the island to sleep once all of them have been for WORLD_SLEEP_TIME
+  void update_sleep(float dt) {
+    size_t wasResting = resting.size();
+    stats.awake_bodies = 0;
+    stats.sleeping_islands = 0;
+    for (const Island &island : islands.islands) {
+      if (!island_awake(island)) {
+        stats.sleeping_islands++;
+        continue;
+      }
+      float still = WORLD_SLEEP_TIME;
+      for (int i = island.body_begin; i < island.body_end; i++) {
+        int body = islands.island_bodies[i];
+        glm::vec3 linear = bodies.linear_velocities[body];
+        glm::vec3 angular = bodies.angular_velocities[body];
+        bool slow = glm::dot(linear, linear) < WORLD_SLEEP_SPEED * WORLD_SLEEP_SPEED
+                    && glm::dot(angular, angular) < WORLD_SLEEP_SPIN * WORLD_SLEEP_SPIN;
+        bodies.sleep_timers[body] = slow ? bodies.sleep_timers[body] + dt : 0.0f;
+        still = std::min(still, bodies.sleep_timers[body]);
+      }
+      if (allow_sleep && still >= WORLD_SLEEP_TIME) {
+        for (int i = island.body_begin; i < island.body_end; i++) {
+          bodies.sleep(islands.island_bodies[i]);
+        }
+        // its contacts stop being collided, the ones with points keep it
+        // together
+        for (int i = island.edge_begin; i < island.edge_end; i++) {
+          int e = islands.island_edges[i];
+          if (edge_contacts[e] >= 0) {
+            rest(edges[e]);
+          }
+        }
+        stats.sleeping_islands++;
+      }
+      else {
+        stats.awake_bodies += island.body_count();
+      }
+    }
+    if (resting.size() > wasResting) {
+      std::sort(resting.begin() + wasResting, resting.end());
+      std::inplace_merge(resting.begin(), resting.begin() + wasResting, resting.end());
+    }
+  }
+
+  // the awake islands with contacts, largest first
+  std::vector<int> solving;
+  // where each coloured island's constraints start, and the last one's end
+  std::vector<int> colored_bounds;
+  // where each task's islands start in solving, and the last one's end
+  std::vector<int> task_islands;
+  // where each task's constraints start, and the last one's end
+  std::vector<int> task_bounds;
+
+  // Cuts the awake islands into tasks and adds their contacts to the
+  // solver task by task. Islands are sorted largest first, so the coloured
+  // ones come first and the tasks are already in the order that balances
+  // best. The cut depends on the island sizes only, and colouring only on
+  // deterministic, so deterministic results stay the same on any pool.
+  //
+  // The islands of a task are interleaved, one contact of each in turn:
+  // batches filled first fit then take a lane from each island and every
+  // island is still solved in its own order. Adding a stack's contacts in
+  // a row would batch every other one and solve the stack odd/even, which
+  // settles far slower.
+  void add_by_island(float dt) {
+    const std::vector<Island> &list = islands.islands;
+    solving.clear();
+    for (int i = 0; i < (int)list.size() && list[i].edge_count() > 0; i++) {
+      if (island_awake(list[i])) {
+        solving.push_back(i);
+      }
+    }
+    int count = (int)solving.size();
+    int first = 0;
+    colored_bounds.clear();
+    colored_bounds.push_back(0);
+    while (first < count && list[solving[first]].edge_count() >= WORLD_COLORED_ISLAND && solver.colored()) {
+      const Island &island = list[solving[first]];
+      sort_edges(island.edge_begin, island.edge_end);
+      for (int i = island.edge_begin; i < island.edge_end; i++) {
+        add_edge(islands.island_edges[i], dt);
+      }
+      colored_bounds.push_back((int)solver.constraints.size());
+      first++;
+    }
+    task_islands.clear();
+    task_islands.push_back(first);
+    int edgeCount = 0;
+    for (int i = first; i < count; i++) {
+      edgeCount += list[solving[i]].edge_count();
+      if (edgeCount >= WORLD_ISLAND_TASK || i == count - 1) {
+        task_islands.push_back(i + 1);
+        edgeCount = 0;
+      }
+    }
+
+    task_bounds.clear();
+    task_bounds.push_back((int)solver.constraints.size());
+    for (size_t task = 0; task + 1 < task_islands.size(); task++) {
+      int begin = task_islands[task];
+      int end = task_islands[task + 1];
+      for (int i = begin; i < end; i++) {
+        sort_edges(list[solving[i]].edge_begin, list[solving[i]].edge_end);
+      }
+      for (int k = 0; k < list[solving[begin]].edge_count(); k++) {
+        for (int i = begin; i < end && k < list[solving[i]].edge_count(); i++) {
+          add_edge(islands.island_edges[list[solving[i]].edge_begin + k], dt);
+        }
+      }
+      task_bounds.push_back((int)solver.constraints.size());
+    }
+  }
+
+  // An edge whose bodies woke without a contact between them has nothing
+  // to solve
+  void add_edge(int edge, float dt) {
+    int contact = edge_contacts[edge];
+    if (contact >= 0) {
+      solver.add(bodies, contacts[contact].a, contacts[contact].b, *contacts[contact].manifold, dt);
+    }
+  }
+
+  // By body pair in deterministic mode, as the solver would sort them,
+  // before the interleaving hides which island a contact came from
+  void sort_edges(int begin, int end) {
+    if (!solver.deterministic) {
+      return;
+    }
+    std::sort(islands.island_edges.begin() + begin, islands.island_edges.begin() + end, [this](int x, int y) {
+      return edges[x].a != edges[y].a ? edges[x].a < edges[y].a : edges[x].b < edges[y].b;
+    });
+  }
+
+  void solve_by_island() {
+    for (size_t i = 0; i + 1 < colored_bounds.size(); i++) {
+      solver.solve_colored(bodies, colored_bounds[i], colored_bounds[i + 1]);
+    }
+    solver.solve_ranges(bodies, task_bounds);
+  }
+};
+
+#endif